@@ -0,0 +1,219 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Count the bytes requested by the maps. The allocator headers are not included.
+static size_t num_byte;
+
+static void* count_malloc(size_t size)
+{
+    size_t* block = malloc(sizeof(size_t) * 2 + size);
+    if (!block)
+        return NULL;
+    block[0] = size;
+    num_byte += size;
+    return block + 2;
+}
+
+static void count_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    size_t* block = (size_t*)ptr - 2;
+    num_byte -= block[0];
+    free(block);
+}
+
+#define YAC_ORDERED_MAP_MALLOC count_malloc
+#define YAC_ORDERED_MAP_FREE count_free
+#define YAC_ORDERED_MAP_IMPLEMENTATION
+#include "../yac_ordered_map.h"
+
+#define NUM_KEY (1 << 20)
+#define NUM_ROUND 4
+
+static double elapsed_ns(clock_t begin, clock_t end)
+{
+    return (double)(end - begin) * 1e9 / CLOCKS_PER_SEC;
+}
+
+// Scatter the keys so that the insertions do not walk the tree in order, and the
+// lookups with another multiplier so that they do not follow the allocation order.
+static intptr_t scatter(intptr_t i, uint32_t mul)
+{
+    return (intptr_t)(((uint32_t)i * mul) & (NUM_KEY - 1)) + 1;
+}
+
+void bench_get(const char* name, unsigned flags)
+{
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    clock_t begin = clock();
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->put(map, (void*)scatter(i, 2654435761u), (void*)i);
+    clock_t end = clock();
+    double put_ns = elapsed_ns(begin, end) / NUM_KEY;
+    double pair_byte = (double)num_byte / NUM_KEY;
+
+    intptr_t sum = 0;
+    int round;
+    begin = clock();
+    for (round = 0 ; round < NUM_ROUND ; ++round) {
+        for (i = 0 ; i < NUM_KEY ; ++i)
+            sum += (intptr_t)map->get(map, (void*)scatter(i + round, 2246822519u));
+    }
+    end = clock();
+    double get_ns = elapsed_ns(begin, end) / ((double)NUM_KEY * NUM_ROUND);
+
+    begin = clock();
+    map->first(map);
+    for (YacOrderedMapPair* pair = map->next(map); pair != NULL; pair = map->next(map))
+        sum += (intptr_t)pair->value;
+    end = clock();
+    double iter_ns = elapsed_ns(begin, end) / NUM_KEY;
+
+    begin = clock();
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->remove(map, (void*)scatter(i, 2246822519u));
+    end = clock();
+    double remove_ns = elapsed_ns(begin, end) / NUM_KEY;
+
+    printf("%-20s put %6.1f ns  get %6.1f ns  next %5.1f ns  remove %6.1f ns  %5.1f B/pair  (checksum %lld)\n",
+           name, put_ns, get_ns, iter_ns, remove_ns, pair_byte, (long long)sum);
+    YacOrderedMapDeinit(map);
+}
+
+// Query windows of 64 consecutive keys, which the range iterator reaches with one
+// descent instead of a walk from the minimum.
+void bench_range(const char* name, unsigned flags)
+{
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->put(map, (void*)scatter(i, 2654435761u), (void*)i);
+
+    intptr_t sum = 0;
+    clock_t begin = clock();
+    for (i = 0 ; i < NUM_KEY / 64 ; ++i) {
+        intptr_t lo = scatter(i, 2246822519u);
+        YacOrderedMapRange(map, (void*)lo, (void*)(lo + 64));
+        for (YacOrderedMapPair* pair = map->next(map); pair != NULL; pair = map->next(map))
+            sum += (intptr_t)pair->value;
+    }
+    clock_t end = clock();
+    double range_ns = elapsed_ns(begin, end) / (NUM_KEY / 64);
+
+    printf("%-20s range of 64 keys %7.1f ns  (checksum %lld)\n", name, range_ns, (long long)sum);
+    YacOrderedMapDeinit(map);
+}
+
+// Read the percentiles of the keys, which the order statistics reach with one
+// descent instead of a walk from the minimum.
+void bench_select(const char* name, unsigned flags)
+{
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    clock_t begin = clock();
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->put(map, (void*)scatter(i, 2654435761u), (void*)i);
+    clock_t end = clock();
+    double put_ns = elapsed_ns(begin, end) / NUM_KEY;
+
+    intptr_t sum = 0;
+    begin = clock();
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        sum += (intptr_t)YacOrderedMapSelect(map, (unsigned)(scatter(i, 2246822519u) - 1))->key;
+    end = clock();
+    double select_ns = elapsed_ns(begin, end) / NUM_KEY;
+
+    printf("%-20s put %6.1f ns  select %6.1f ns  (checksum %lld)\n", name, put_ns, select_ns, (long long)sum);
+    YacOrderedMapDeinit(map);
+}
+
+// Load the sorted pairs pair by pair and in bulk.
+void bench_build(const char* name, unsigned flags)
+{
+    YacOrderedMapPair* pairs = malloc(sizeof(YacOrderedMapPair) * NUM_KEY);
+    intptr_t i;
+    for (i = 0 ; i < NUM_KEY ; ++i) {
+        pairs[i].key = (void*)(i + 1);
+        pairs[i].value = (void*)i;
+    }
+
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+    clock_t begin = clock();
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->put(map, pairs[i].key, pairs[i].value);
+    clock_t end = clock();
+    double put_ms = elapsed_ns(begin, end) / 1e6;
+    YacOrderedMapDeinit(map);
+
+    map = YacOrderedMapInitWithFlags(flags);
+    begin = clock();
+    YacOrderedMapBuild(map, pairs, NUM_KEY);
+    end = clock();
+    double build_ms = elapsed_ns(begin, end) / 1e6;
+
+    printf("%-20s sorted put %7.1f ms  build %6.1f ms\n", name, put_ms, build_ms);
+    YacOrderedMapDeinit(map);
+    free(pairs);
+}
+
+// Merge a small batch of keys into the large map pair by pair and in bulk, and
+// split a large map in half.
+void bench_union(const char* name, unsigned flags)
+{
+    enum { NUM_BATCH = 1024 };
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+    intptr_t i;
+    for (i = 0 ; i < NUM_KEY ; ++i)
+        map->put(map, (void*)(i * 2), (void*)i);
+
+    clock_t begin = clock();
+    for (i = 0 ; i < NUM_BATCH ; ++i)
+        map->put(map, (void*)scatter(i, 2246822519u), (void*)i);
+    clock_t end = clock();
+    double put_us = elapsed_ns(begin, end) / 1e3;
+
+    YacOrderedMap* batch = YacOrderedMapInitWithFlags(flags);
+    for (i = 0 ; i < NUM_BATCH ; ++i)
+        batch->put(batch, (void*)(scatter(i, 2654435761u) | 1), (void*)i);
+    begin = clock();
+    YacOrderedMapUnion(map, batch);
+    end = clock();
+    double union_us = elapsed_ns(begin, end) / 1e3;
+
+    begin = clock();
+    YacOrderedMapSplit(map, (void*)(intptr_t)NUM_KEY, batch);
+    end = clock();
+    double split_us = elapsed_ns(begin, end) / 1e3;
+
+    printf("%-20s %d puts %8.1f us  union %8.1f us  split %8.1f us\n",
+        name, NUM_BATCH, put_us, union_us, split_us);
+    YacOrderedMapDeinit(batch);
+    YacOrderedMapDeinit(map);
+}
+
+int main(void)
+{
+    printf("%d integer keys, %d lookup rounds\n", NUM_KEY, NUM_ROUND);
+
+    bench_get("red black tree", 0);
+    bench_get("red black, pool", YAC_ORDERED_MAP_NODE_POOL);
+    bench_get("b-tree", YAC_ORDERED_MAP_BTREE);
+    bench_range("red black tree", 0);
+    bench_range("b-tree", YAC_ORDERED_MAP_BTREE);
+    bench_select("red black tree", YAC_ORDERED_MAP_ORDER_STATISTIC);
+    bench_select("b-tree", YAC_ORDERED_MAP_ORDER_STATISTIC | YAC_ORDERED_MAP_BTREE);
+    bench_build("red black tree", 0);
+    bench_build("b-tree", YAC_ORDERED_MAP_BTREE);
+    bench_union("red black tree", 0);
+    bench_union("red black, pool", YAC_ORDERED_MAP_NODE_POOL);
+    bench_union("b-tree", YAC_ORDERED_MAP_BTREE);
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Count the bytes requested by the maps. The allocator headers are not included.
+static size_t num_byte;
+
+static void* count_malloc(size_t size)
+{
+    size_t* block = malloc(sizeof(size_t) * 2 + size);
+    if (!block)
+        return NULL;
+    block[0] = size;
+    num_byte += size;
+    return block + 2;
+}
+
+static void count_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    size_t* block = (size_t*)ptr - 2;
+    num_byte -= block[0];
+    free(block);
+}
+
+#define YAC_ORDERED_MAP_MALLOC count_malloc
+#define YAC_ORDERED_MAP_FREE count_free
+#define YAC_UNORDERED_MAP_IMPLEMENTATION
+#include "../yac_unordered_map.h"
+
+#define NUM_KEY (1 << 20)
+#define NUM_ROUND 8
+
+static double elapsed_ns(clock_t begin, clock_t end)
+{
+    return (double)(end - begin) * 1e9 / CLOCKS_PER_SEC;
+}
+
+void bench_get(const char* name, unsigned flags)
+{
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    clock_t begin = clock();
+    for (i = 1 ; i <= NUM_KEY ; ++i)
+        map->put(map, (void*)i, (void*)i);
+    clock_t end = clock();
+    double put_ns = elapsed_ns(begin, end) / NUM_KEY;
+    double pair_byte = (double)num_byte / NUM_KEY;
+
+    // Visit the keys in a scattered order so that the slots are not walked sequentially.
+    intptr_t sum = 0;
+    int round;
+    begin = clock();
+    for (round = 0 ; round < NUM_ROUND ; ++round) {
+        for (i = 0 ; i < NUM_KEY ; ++i) {
+            intptr_t key = (intptr_t)(((uint32_t)i * 2654435761u) & (NUM_KEY - 1)) + 1;
+            sum += (intptr_t)map->get(map, (void*)key);
+        }
+    }
+    end = clock();
+    double get_ns = elapsed_ns(begin, end) / ((double)NUM_KEY * NUM_ROUND);
+
+    printf("%-24s put %6.1f ns  get %6.1f ns  %5.1f B/pair  (checksum %lld)\n",
+           name, put_ns, get_ns, pair_byte, (long long)sum);
+    YacUnorderedMapDeinit(map);
+}
+
+void bench_get_many(const char* name, unsigned flags)
+{
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    for (i = 1 ; i <= NUM_KEY ; ++i)
+        map->put(map, (void*)i, (void*)i);
+
+    // The same scattered keys as bench_get, resolved 128 per call.
+    static void* keys[128];
+    static void* values[128];
+    intptr_t sum = 0;
+    int round;
+    clock_t begin = clock();
+    for (round = 0 ; round < NUM_ROUND ; ++round) {
+        for (i = 0 ; i < NUM_KEY ; i += 128) {
+            int j;
+            for (j = 0 ; j < 128 ; ++j)
+                keys[j] = (void*)((intptr_t)(((uint32_t)(i + j) * 2654435761u) & (NUM_KEY - 1)) + 1);
+            YacUnorderedMapGetMany(map, keys, 128, values);
+            for (j = 0 ; j < 128 ; ++j)
+                sum += (intptr_t)values[j];
+        }
+    }
+    clock_t end = clock();
+    double get_ns = elapsed_ns(begin, end) / ((double)NUM_KEY * NUM_ROUND);
+
+    printf("%-24s get many %6.1f ns  (checksum %lld)\n", name, get_ns, (long long)sum);
+    YacUnorderedMapDeinit(map);
+}
+
+#define NUM_SCRATCH_KEY (1 << 14)
+#define NUM_REQUEST 256
+
+void bench_clear(const char* name, unsigned flags)
+{
+    // Fill a scratch map per request, and either rebuild or clear it between requests.
+    intptr_t i;
+    int round;
+    clock_t begin = clock();
+    for (round = 0 ; round < NUM_REQUEST ; ++round) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags);
+        for (i = 1 ; i <= NUM_SCRATCH_KEY ; ++i)
+            map->put(map, (void*)i, (void*)i);
+        YacUnorderedMapDeinit(map);
+    }
+    clock_t end = clock();
+    double init_ns = elapsed_ns(begin, end) / ((double)NUM_SCRATCH_KEY * NUM_REQUEST);
+
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags);
+    begin = clock();
+    for (round = 0 ; round < NUM_REQUEST ; ++round) {
+        for (i = 1 ; i <= NUM_SCRATCH_KEY ; ++i)
+            map->put(map, (void*)i, (void*)i);
+        YacUnorderedMapClear(map);
+    }
+    end = clock();
+    double clear_ns = elapsed_ns(begin, end) / ((double)NUM_SCRATCH_KEY * NUM_REQUEST);
+    YacUnorderedMapDeinit(map);
+
+    printf("%-24s put per request: init/deinit %6.1f ns  clear %6.1f ns\n", name, init_ns, clear_ns);
+}
+
+static size_t encode_int(void* item, void* buf, void* arg)
+{
+    int num = (int)(intptr_t)item;
+    if (buf)
+        memcpy(buf, &num, sizeof(num));
+    (void)arg;
+    return sizeof(num);
+}
+
+void bench_snapshot(const char* name, unsigned flags)
+{
+    const char* path = "yac_unordered_map_bench.snapshot";
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags);
+
+    intptr_t i;
+    for (i = 1 ; i <= NUM_KEY ; ++i)
+        map->put(map, (void*)i, (void*)i);
+
+    clock_t begin = clock();
+    YacUnorderedMapSave(map, path, encode_int, encode_int, NULL);
+    clock_t end = clock();
+    double save_ms = elapsed_ns(begin, end) / 1e6;
+    YacUnorderedMapDeinit(map);
+
+    begin = clock();
+    YacUnorderedMapView* view = YacUnorderedMapViewInit(path);
+    end = clock();
+    double open_ms = elapsed_ns(begin, end) / 1e6;
+    if (!view) {
+        printf("%-24s cannot open the snapshot\n", name);
+        return;
+    }
+
+    intptr_t sum = 0;
+    int round;
+    begin = clock();
+    for (round = 0 ; round < NUM_ROUND ; ++round) {
+        for (i = 0 ; i < NUM_KEY ; ++i) {
+            int key = (int)(((uint32_t)i * 2654435761u) & (NUM_KEY - 1)) + 1;
+            const int* value = YacUnorderedMapViewGet(view, &key, sizeof(key), NULL);
+            sum += *value;
+        }
+    }
+    end = clock();
+    double get_ns = elapsed_ns(begin, end) / ((double)NUM_KEY * NUM_ROUND);
+
+    printf("%-24s save %6.1f ms  open %6.3f ms  get %6.1f ns  (checksum %lld)\n",
+           name, save_ms, open_ms, get_ns, (long long)sum);
+    YacUnorderedMapViewDeinit(view);
+    remove(path);
+}
+
+#define int_hash(key) ((unsigned)(key))
+#define int_eq(lhs, rhs) ((lhs) == (rhs))
+YAC_UNORDERED_MAP_DEFINE(IntMap, int, int, int_hash, int_eq)
+
+void bench_get_typed(const char* name)
+{
+    IntMap* map = IntMapInit();
+
+    int i;
+    clock_t begin = clock();
+    for (i = 1 ; i <= NUM_KEY ; ++i)
+        IntMapPut(map, i, i);
+    clock_t end = clock();
+    double put_ns = elapsed_ns(begin, end) / NUM_KEY;
+    double pair_byte = (double)num_byte / NUM_KEY;
+
+    intptr_t sum = 0;
+    int round;
+    begin = clock();
+    for (round = 0 ; round < NUM_ROUND ; ++round) {
+        for (i = 0 ; i < NUM_KEY ; ++i) {
+            int key = (int)(((uint32_t)i * 2654435761u) & (NUM_KEY - 1)) + 1;
+            sum += *IntMapGet(map, key);
+        }
+    }
+    end = clock();
+    double get_ns = elapsed_ns(begin, end) / ((double)NUM_KEY * NUM_ROUND);
+
+    printf("%-24s put %6.1f ns  get %6.1f ns  %5.1f B/pair  (checksum %lld)\n",
+           name, put_ns, get_ns, pair_byte, (long long)sum);
+    IntMapDeinit(map);
+}
+
+#define HASH_BYTES (1 << 28)
+
+static unsigned hash_djb2(void* key, size_t size)
+{
+    (void)size;
+    return YacUnorderedMapHashDjb2((char*)key);
+}
+
+static unsigned hash_wy64(void* key, size_t size)
+{
+    return (unsigned)YacUnorderedMapHashWy64(key, size, 0);
+}
+
+void bench_hash(const char* name, unsigned (*func)(void*, size_t))
+{
+    static const size_t arr_size[] = {4, 8, 16, 32, 64, 256, 1024};
+    static char buf[1024 + 64];
+
+    printf("%-24s", name);
+    size_t i;
+    for (i = 0 ; i < sizeof(arr_size) / sizeof(arr_size[0]) ; ++i) {
+        size_t size = arr_size[i];
+        memset(buf, 'k', sizeof(buf));
+        buf[size] = 0;
+
+        // Hash the same number of bytes for every key length, and vary the key
+        // to keep the calls dependent on each other.
+        size_t num_call = HASH_BYTES / size, j;
+        unsigned sum = 0;
+        clock_t begin = clock();
+        for (j = 0 ; j < num_call ; ++j) {
+            buf[0] = (char)('a' + (sum & 15));
+            sum += func(buf, size);
+        }
+        clock_t end = clock();
+        double ns = elapsed_ns(begin, end) / num_call;
+        printf(" %4zuB %6.1f ns %5.2f GB/s |", size, ns, (double)size / ns);
+        if (sum == 1)
+            printf("!");
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    printf("%d integer keys, %d lookup rounds\n", NUM_KEY, NUM_ROUND);
+
+    bench_get("chained, prime", 0);
+    bench_get("chained, power of two", YAC_UNORDERED_MAP_POWER_OF_TWO);
+    bench_get("flat", YAC_UNORDERED_MAP_FLAT);
+    bench_get("compact", YAC_UNORDERED_MAP_COMPACT);
+    bench_get_typed("flat, typed int");
+    bench_get_many("chained, prime", 0);
+    bench_get_many("flat", YAC_UNORDERED_MAP_FLAT);
+    bench_snapshot("snapshot view", 0);
+    bench_clear("chained, prime", 0);
+    bench_clear("chained, node pool", YAC_UNORDERED_MAP_NODE_POOL);
+    bench_clear("flat", YAC_UNORDERED_MAP_FLAT);
+
+    printf("hash throughput per key length\n");
+    bench_hash("djb2", hash_djb2);
+    bench_hash("murmur32", YacUnorderedMapHashMurMur32);
+    bench_hash("wy64", hash_wy64);
+    bench_hash("crc32c", YacUnorderedMapHashCrc32c);
+
+    return 0;
+}
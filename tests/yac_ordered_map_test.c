@@ -1,6 +1,27 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
+// Count the live allocations of the maps.
+static int num_alloc;
+
+static void* count_malloc(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr)
+        ++num_alloc;
+    return ptr;
+}
+
+static void count_free(void* ptr)
+{
+    if (ptr)
+        --num_alloc;
+    free(ptr);
+}
+
+#define YAC_ORDERED_MAP_MALLOC count_malloc
+#define YAC_ORDERED_MAP_FREE count_free
 #define YAC_ORDERED_MAP_IMPLEMENTATION
 #include "../yac_ordered_map.h"
 
@@ -267,6 +288,652 @@ void test_compare_and_clean(void)
     YacOrderedMapDeinit(map);
 }
 
+static int num_clean_value;
+
+void count_clean_value(void* value)
+{
+    (void)value;
+    ++num_clean_value;
+}
+
+void test_node_pool(void)
+{
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_NODE_POOL);
+    assert(map != NULL);
+
+    intptr_t i;
+    for (i = 1 ; i <= 10000 ; ++i)
+        assert(map->put(map, (void*)i, (void*)(i * 10)) == true);
+
+    // Remove the odd keys and put them back through the recycled nodes.
+    for (i = 1 ; i <= 10000 ; i += 2)
+        assert(map->remove(map, (void*)i) == true);
+    assert(map->size(map) == 5000);
+    for (i = 1 ; i <= 10000 ; i += 2)
+        assert(map->put(map, (void*)i, (void*)(i * 20)) == true);
+    assert(map->size(map) == 10000);
+
+    for (i = 1 ; i <= 10000 ; ++i)
+        assert(map->get(map, (void*)i) == (void*)(i * ((i & 1)? 20 : 10)));
+
+    i = 0;
+    map->first(map);
+    for (YacOrderedMapPair *pair = map->next(map); pair != NULL; pair = map->next(map))
+        assert((intptr_t)pair->key == ++i);
+    assert(i == 10000);
+
+    YacOrderedMapDeinit(map);
+
+    // The cleanup functions still see every pair on destruction.
+    num_clean_value = 0;
+    map = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_NODE_POOL);
+    map->set_clean_value(map, count_clean_value);
+    for (i = 1 ; i <= 3000 ; ++i)
+        map->put(map, (void*)i, (void*)i);
+    map->remove(map, (void*)1);
+    YacOrderedMapDeinit(map);
+    assert(num_clean_value == 3000);
+}
+
+void test_btree(void)
+{
+    enum { NUM = 50000 };
+    static bool present[NUM];
+    YacOrderedMap* map = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_BTREE);
+    assert(map != NULL);
+    assert(map->minimum(map) == NULL);
+    assert(map->remove(map, (void*)1) == false);
+
+    // Mix the insertions and removals in a scrambled order, and check the
+    // tree against the presence of every key.
+    memset(present, 0, sizeof(present));
+    unsigned size = 0;
+    unsigned seed = 12345;
+    intptr_t i;
+    for (i = 0 ; i < NUM * 4 ; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        intptr_t key = (intptr_t)((seed >> 8) % NUM);
+        if (seed & 0x80000000u) {
+            assert(map->remove(map, (void*)key) == present[key]);
+            size -= present[key];
+            present[key] = false;
+        } else {
+            assert(map->put(map, (void*)key, (void*)(key * 10)) == true);
+            size += !present[key];
+            present[key] = true;
+        }
+    }
+    assert(map->size(map) == size);
+
+    intptr_t min = -1, max = -1;
+    for (i = 0 ; i < NUM ; ++i) {
+        assert(map->find(map, (void*)i) == present[i]);
+        assert(map->get(map, (void*)i) == ((present[i])? (void*)(i * 10) : NULL));
+        if (present[i]) {
+            if (min < 0)
+                min = i;
+            max = i;
+        }
+    }
+    assert((intptr_t)map->minimum(map)->key == min);
+    assert((intptr_t)map->maximum(map)->key == max);
+
+    // The neighbors of every present key are the nearest present keys.
+    intptr_t prev = -1;
+    for (i = 0 ; i < NUM ; ++i) {
+        if (!present[i]) {
+            assert(map->predecessor(map, (void*)i) == NULL);
+            assert(map->successor(map, (void*)i) == NULL);
+            continue;
+        }
+        YacOrderedMapPair* pair = map->predecessor(map, (void*)i);
+        assert((prev < 0)? pair == NULL : (intptr_t)pair->key == prev);
+        if (prev >= 0)
+            assert((intptr_t)map->successor(map, (void*)prev)->key == i);
+        prev = i;
+    }
+    assert(map->successor(map, (void*)max) == NULL);
+
+    // Iterate both ways.
+    unsigned count = 0;
+    prev = -1;
+    map->first(map);
+    for (YacOrderedMapPair *pair = map->next(map); pair != NULL; pair = map->next(map)) {
+        assert((intptr_t)pair->key > prev);
+        assert(pair->value == (void*)((intptr_t)pair->key * 10));
+        prev = (intptr_t)pair->key;
+        ++count;
+    }
+    assert(count == size);
+    assert(map->next(map) == NULL);
+
+    count = 0;
+    prev = NUM;
+    map->first(map);
+    for (YacOrderedMapPair *pair = map->reverse_next(map); pair != NULL; pair = map->reverse_next(map)) {
+        assert((intptr_t)pair->key < prev);
+        prev = (intptr_t)pair->key;
+        ++count;
+    }
+    assert(count == size);
+
+    // Drain the tree, then grow it again from empty.
+    for (i = 0 ; i < NUM ; ++i)
+        assert(map->remove(map, (void*)i) == present[i]);
+    assert(map->size(map) == 0);
+    assert(map->maximum(map) == NULL);
+    map->first(map);
+    assert(map->next(map) == NULL);
+    for (i = NUM - 1 ; i >= 0 ; --i)
+        assert(map->put(map, (void*)i, (void*)i) == true);
+    assert(map->size(map) == NUM);
+    assert((intptr_t)map->minimum(map)->key == 0);
+    YacOrderedMapDeinit(map);
+
+    // Every pair is cleaned once whether it is replaced, removed, or left to
+    // the destruction, even as the pairs move between the nodes.
+    num_clean_value = 0;
+    map = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_BTREE | YAC_ORDERED_MAP_NODE_POOL);
+    map->set_clean_value(map, count_clean_value);
+    for (i = 0 ; i < 5000 ; ++i)
+        map->put(map, (void*)i, (void*)i);
+    for (i = 0 ; i < 1000 ; ++i)
+        map->put(map, (void*)i, (void*)i);
+    for (i = 0 ; i < 5000 ; i += 3)
+        map->remove(map, (void*)i);
+    assert(num_clean_value == 1000 + 1667);
+    YacOrderedMapDeinit(map);
+    assert(num_clean_value == 6000);
+
+    // KEY = char*, VALUE = char*
+    map = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_BTREE);
+    map->set_compare(map, (YacOrderedMapCompare)strcmp);
+    char* names[] = {"delta", "alpha", "echo", "charlie", "bravo"};
+    for (i = 0 ; i < 5 ; ++i)
+        map->put(map, names[i], names[i]);
+    assert(strcmp((char*)map->minimum(map)->key, "alpha") == 0);
+    assert(strcmp((char*)map->successor(map, "charlie")->key, "delta") == 0);
+    assert(strcmp((char*)map->predecessor(map, "charlie")->key, "bravo") == 0);
+    assert(map->get(map, "foxtrot") == NULL);
+    YacOrderedMapDeinit(map);
+}
+
+void test_bound_and_range(void)
+{
+    unsigned flags[] = {0, YAC_ORDERED_MAP_NODE_POOL, YAC_ORDERED_MAP_BTREE};
+    int f;
+    for (f = 0 ; f < 3 ; ++f) {
+        YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+        assert(YacOrderedMapLowerBound(map, (void*)1) == NULL);
+        assert(YacOrderedMapFloor(map, (void*)1) == NULL);
+        YacOrderedMapRange(map, (void*)0, (void*)10);
+        assert(map->next(map) == NULL);
+
+        // Store the even keys from 2 to 2000, so that every odd key is absent.
+        intptr_t i;
+        for (i = 1000 ; i >= 1 ; --i)
+            map->put(map, (void*)(i * 2), (void*)i);
+
+        for (i = 0 ; i <= 2002 ; ++i) {
+            intptr_t ceil = (i < 2)? 2 : (i + (i & 1));
+            intptr_t upper = (i < 2)? 2 : (i + 2 - (i & 1));
+            intptr_t floor = i - (i & 1);
+
+            YacOrderedMapPair* pair = YacOrderedMapLowerBound(map, (void*)i);
+            assert((ceil > 2000)? pair == NULL : (intptr_t)pair->key == ceil);
+            assert(YacOrderedMapCeiling(map, (void*)i) == pair);
+
+            pair = YacOrderedMapUpperBound(map, (void*)i);
+            assert((upper > 2000)? pair == NULL : (intptr_t)pair->key == upper);
+
+            pair = YacOrderedMapFloor(map, (void*)i);
+            if (floor < 2)
+                assert(pair == NULL);
+            else if (floor > 2000)
+                assert((intptr_t)pair->key == 2000);
+            else
+                assert((intptr_t)pair->key == floor);
+        }
+
+        // Walk the ranges with absent and present ends, empty ones, and ones
+        // beyond the stored keys.
+        intptr_t ranges[][3] = {
+            {101, 201, 50}, {100, 200, 50}, {0, 3000, 1000}, {7, 8, 0},
+            {8, 8, 0}, {9, 5, 0}, {1999, 2500, 1}, {2001, 2500, 0}, {-5, 3, 1},
+        };
+        int k;
+        for (k = 0 ; k < 9 ; ++k) {
+            intptr_t lo = ranges[k][0], hi = ranges[k][1];
+            intptr_t count = 0, prev = lo - 1;
+            YacOrderedMapRange(map, (void*)lo, (void*)hi);
+            for (YacOrderedMapPair* pair = map->next(map); pair != NULL; pair = map->next(map)) {
+                intptr_t key = (intptr_t)pair->key;
+                assert(key >= lo && key < hi && key > prev && (key & 1) == 0);
+                prev = key;
+                ++count;
+            }
+            assert(count == ranges[k][2]);
+            assert(map->next(map) == NULL);
+        }
+
+        // The plain iterator is unbounded again.
+        intptr_t count = 0;
+        map->first(map);
+        while (map->next(map))
+            ++count;
+        assert(count == 1000);
+
+        YacOrderedMapDeinit(map);
+    }
+}
+
+void test_rank_and_select(void)
+{
+    enum { NUM = 20000 };
+    static bool present[NUM];
+    unsigned flags[] = {
+        YAC_ORDERED_MAP_ORDER_STATISTIC,
+        YAC_ORDERED_MAP_ORDER_STATISTIC | YAC_ORDERED_MAP_NODE_POOL,
+        YAC_ORDERED_MAP_ORDER_STATISTIC | YAC_ORDERED_MAP_BTREE,
+    };
+    int f;
+    for (f = 0 ; f < 3 ; ++f) {
+        YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+        unsigned rank;
+        assert(YacOrderedMapSelect(map, 0) == NULL);
+        assert(YacOrderedMapRank(map, (void*)5, &rank) == true && rank == 0);
+
+        // Mix the insertions and removals so that the counts go through every
+        // rotation, split, merge, and borrow.
+        memset(present, 0, sizeof(present));
+        unsigned seed = 777;
+        intptr_t i;
+        for (i = 0 ; i < NUM * 3 ; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            intptr_t key = (intptr_t)((seed >> 8) % NUM);
+            if (seed & 0x80000000u) {
+                map->remove(map, (void*)key);
+                present[key] = false;
+            } else {
+                map->put(map, (void*)key, (void*)key);
+                present[key] = true;
+            }
+        }
+
+        // The rank of every key counts the present keys before it, and the
+        // selection inverts it for the present ones.
+        unsigned before = 0;
+        for (i = 0 ; i < NUM ; ++i) {
+            assert(YacOrderedMapRank(map, (void*)i, &rank) == true);
+            assert(rank == before);
+            if (present[i]) {
+                YacOrderedMapPair* pair = YacOrderedMapSelect(map, before);
+                assert((intptr_t)pair->key == i);
+                ++before;
+            }
+        }
+        assert(before == map->size(map));
+        assert(YacOrderedMapSelect(map, before) == NULL);
+        assert(YacOrderedMapRank(map, (void*)NUM, &rank) == true && rank == before);
+
+        // Drain the map in a scrambled order while the selection keeps pace.
+        for (i = 0 ; i < NUM ; ++i) {
+            intptr_t key = (i * 7919) % NUM;
+            if (!present[key])
+                continue;
+            assert(map->remove(map, (void*)key) == true);
+            --before;
+            if (before > 0)
+                assert(YacOrderedMapSelect(map, before - 1) == map->maximum(map));
+        }
+        assert(map->size(map) == 0);
+        YacOrderedMapDeinit(map);
+    }
+
+    // The queries need the counts.
+    YacOrderedMap* map = YacOrderedMapInit();
+    unsigned rank;
+    map->put(map, (void*)1, (void*)1);
+    assert(YacOrderedMapSelect(map, 0) == NULL);
+    assert(YacOrderedMapRank(map, (void*)1, &rank) == false);
+    YacOrderedMapDeinit(map);
+}
+
+// Return the black height of the subtree after checking the colors, the links,
+// and the pair counts.
+static int check_red_black(TreeNode* null, TreeNode* node, bool count)
+{
+    if (node == null)
+        return 1;
+
+    if (node->color_ == YAC_COLOR_RED)
+        assert(node->left_->color_ == YAC_COLOR_BLACK && node->right_->color_ == YAC_COLOR_BLACK);
+    assert(node->left_ == null || node->left_->parent_ == node);
+    assert(node->right_ == null || node->right_->parent_ == node);
+    if (count)
+        assert(node->count_ == node->left_->count_ + node->right_->count_ + 1);
+
+    int left = check_red_black(null, node->left_, count);
+    assert(left == check_red_black(null, node->right_, count));
+    return left + (node->color_ == YAC_COLOR_BLACK);
+}
+
+// Return the height of the subtree after checking the occupancy and, when
+// designated, the totals of the internal nodes.
+static int check_btree(BTreeNode* node, bool root, bool total)
+{
+    assert(node->num_ <= YAC_ORDERED_MAP_BTREE_MAX);
+    assert(node->num_ >= ((root)? 1 : YAC_ORDERED_MAP_BTREE_DEGREE - 1));
+    if (node->leaf_) {
+        assert(node->total_ == node->num_);
+        return 1;
+    }
+
+    unsigned i, sum = node->num_;
+    int height = check_btree(node->child_[0], false, total);
+    for (i = 0 ; i <= node->num_ ; ++i) {
+        assert(check_btree(node->child_[i], false, total) == height);
+        sum += node->child_[i]->total_;
+    }
+    assert(!total || node->total_ == sum);
+    return height + 1;
+}
+
+void test_build(void)
+{
+    enum { NUM = 100000 };
+    static YacOrderedMapPair pairs[NUM];
+    intptr_t i;
+    for (i = 0 ; i < NUM ; ++i) {
+        pairs[i].key = (void*)(i * 3);
+        pairs[i].value = (void*)i;
+    }
+
+    unsigned flags[] = {
+        0,
+        YAC_ORDERED_MAP_NODE_POOL,
+        YAC_ORDERED_MAP_ORDER_STATISTIC,
+        YAC_ORDERED_MAP_BTREE | YAC_ORDERED_MAP_ORDER_STATISTIC,
+    };
+    unsigned nums[] = {0, 1, 2, 3, 7, 8, 31, 32, 1000, 1023, NUM};
+    int f, n;
+    for (f = 0 ; f < 4 ; ++f) {
+        bool btree = (flags[f] & YAC_ORDERED_MAP_BTREE) != 0;
+        bool count = (flags[f] & YAC_ORDERED_MAP_ORDER_STATISTIC) != 0;
+        for (n = 0 ; n < 11 ; ++n) {
+            unsigned num = nums[n];
+            YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+            num_clean_value = 0;
+            map->set_clean_value(map, count_clean_value);
+            assert(YacOrderedMapBuild(map, pairs, num) == true);
+            assert(map->size(map) == num);
+
+            YacOrderedMapData* data = map->data;
+            if (btree && num > 0)
+                check_btree(data->btree_root_, true, true);
+            if (!btree) {
+                assert(data->root_->color_ == YAC_COLOR_BLACK);
+                check_red_black(data->null_, data->root_, true);
+            }
+
+            i = 0;
+            map->first(map);
+            for (YacOrderedMapPair *pair = map->next(map); pair != NULL; pair = map->next(map)) {
+                assert(pair->key == pairs[i].key && pair->value == pairs[i].value);
+                ++i;
+            }
+            assert(i == num);
+            for (i = 0 ; i < (intptr_t)num ; ++i) {
+                assert(map->get(map, (void*)(i * 3)) == (void*)i);
+                assert(map->find(map, (void*)(i * 3 + 1)) == false);
+                if (count)
+                    assert(YacOrderedMapSelect(map, (unsigned)i)->key == (void*)(i * 3));
+            }
+
+            // The built tree takes the usual insertions and removals, and the
+            // nodes of the bulk allocation are recycled through the pool.
+            for (i = 0 ; i < (intptr_t)num ; i += 2)
+                assert(map->remove(map, (void*)(i * 3)) == true);
+            for (i = 0 ; i < (intptr_t)num ; ++i)
+                assert(map->put(map, (void*)(i * 3 + 1), (void*)i) == true);
+            assert(map->size(map) == num + num / 2);
+            if (btree && num > 0)
+                check_btree(data->btree_root_, true, true);
+            if (!btree)
+                check_red_black(data->null_, data->root_, count);
+
+            YacOrderedMapDeinit(map);
+            assert(num_clean_value == (int)(num * 2));
+        }
+    }
+
+    // The map must be empty and the keys strictly increasing.
+    for (f = 0 ; f < 4 ; ++f) {
+        YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+        YacOrderedMapPair twice[] = {{(void*)1, NULL}, {(void*)2, NULL}, {(void*)2, NULL}};
+        YacOrderedMapPair swapped[] = {{(void*)1, NULL}, {(void*)3, NULL}, {(void*)2, NULL}};
+        assert(YacOrderedMapBuild(map, twice, 3) == false);
+        assert(YacOrderedMapBuild(map, swapped, 3) == false);
+        assert(map->size(map) == 0);
+        map->put(map, (void*)5, NULL);
+        assert(YacOrderedMapBuild(map, pairs, 10) == false);
+        assert(map->size(map) == 1);
+        YacOrderedMapDeinit(map);
+    }
+}
+
+// Check the tree structure and that the map holds the keys from the first to
+// the last with the designated step, mapped to the values of their owner.
+static void check_keys(YacOrderedMap* map, intptr_t first, intptr_t last, intptr_t step, intptr_t owner)
+{
+    YacOrderedMapData* data = map->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        if (data->btree_root_)
+            check_btree(data->btree_root_, true, (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) != 0);
+    } else {
+        assert(data->root_->color_ == YAC_COLOR_BLACK);
+        assert(data->root_ == data->null_ || data->root_->parent_ == data->null_);
+        check_red_black(data->null_, data->root_, (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) != 0);
+    }
+
+    intptr_t key = first;
+    unsigned count = 0;
+    map->first(map);
+    for (YacOrderedMapPair *pair = map->next(map); pair != NULL; pair = map->next(map)) {
+        assert((intptr_t)pair->key == key);
+        assert((intptr_t)pair->value == key * owner);
+        key += step;
+        ++count;
+    }
+    assert(key == last + step || (count == 0 && first > last));
+    assert(map->size(map) == count);
+}
+
+void test_split_join_union(void)
+{
+    enum { NUM = 3000 };
+    unsigned flags[] = {
+        0,
+        YAC_ORDERED_MAP_NODE_POOL,
+        YAC_ORDERED_MAP_ORDER_STATISTIC,
+        YAC_ORDERED_MAP_NODE_POOL | YAC_ORDERED_MAP_ORDER_STATISTIC,
+        YAC_ORDERED_MAP_BTREE,
+        YAC_ORDERED_MAP_BTREE | YAC_ORDERED_MAP_ORDER_STATISTIC,
+    };
+    intptr_t cuts[] = {-5, 0, 1, 2, 500, 1501, 1502, 2999, 3000, 5998, 9000};
+    int f, c;
+    intptr_t i;
+    for (f = 0 ; f < 6 ; ++f) {
+        // Split at absent, present, and outlying keys, so that either side is
+        // the larger, then join the halves back in either direction.
+        for (c = 0 ; c < 11 ; ++c) {
+            YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+            YacOrderedMap* other = YacOrderedMapInitWithFlags(flags[f]);
+            for (i = 0 ; i < NUM ; ++i)
+                map->put(map, (void*)(i * 2), (void*)(i * 2));
+
+            intptr_t cut = cuts[c];
+            intptr_t mid = (cut <= 0)? 0 : (cut > NUM * 2 - 2)? NUM * 2 : (cut + 1) / 2 * 2;
+            assert(YacOrderedMapSplit(map, (void*)cut, other) == true);
+            check_keys(map, 0, mid - 2, 2, 1);
+            check_keys(other, mid, NUM * 2 - 2, 2, 1);
+
+            // The split parts take the usual operations on their own.
+            map->put(map, (void*)-1, (void*)-1);
+            assert(map->remove(map, (void*)-1) == true);
+            other->put(other, (void*)(NUM * 2), (void*)(NUM * 2));
+            assert(other->remove(other, (void*)(NUM * 2)) == true);
+
+            if (c & 1) {
+                assert(YacOrderedMapJoin(map, other) == true);
+                check_keys(map, 0, NUM * 2 - 2, 2, 1);
+                check_keys(other, 0, -2, 2, 1);
+            } else {
+                assert(YacOrderedMapJoin(other, map) == true);
+                check_keys(other, 0, NUM * 2 - 2, 2, 1);
+                check_keys(map, 0, -2, 2, 1);
+            }
+
+            // The maps outlive each other in both orders.
+            if (c & 2) {
+                YacOrderedMapDeinit(map);
+                YacOrderedMapDeinit(other);
+            } else {
+                YacOrderedMapDeinit(other);
+                YacOrderedMapDeinit(map);
+            }
+        }
+
+        // Join refuses overlapping ranges and leaves both maps unchanged.
+        YacOrderedMap* map = YacOrderedMapInitWithFlags(flags[f]);
+        YacOrderedMap* other = YacOrderedMapInitWithFlags(flags[f]);
+        for (i = 0 ; i < 100 ; ++i) {
+            map->put(map, (void*)(i * 2), (void*)(i * 2));
+            other->put(other, (void*)(i * 2 + 150), (void*)(i * 2 + 150));
+        }
+        assert(YacOrderedMapJoin(map, other) == false);
+        assert(YacOrderedMapSplit(map, (void*)10, other) == false);
+        assert(YacOrderedMapJoin(map, map) == false);
+        check_keys(map, 0, 198, 2, 1);
+        check_keys(other, 150, 348, 2, 1);
+        YacOrderedMapDeinit(other);
+
+        // Union with the interleaved and the equal keys, where the pairs of the
+        // other map replace the stored ones, in both size orders.
+        int round;
+        for (round = 0 ; round < 2 ; ++round) {
+            int num_self = (round == 0)? NUM : 10;
+            int num_other = (round == 0)? 10 : NUM;
+            YacOrderedMapDeinit(map);
+            map = YacOrderedMapInitWithFlags(flags[f]);
+            other = YacOrderedMapInitWithFlags(flags[f]);
+            num_clean_value = 0;
+            map->set_clean_value(map, count_clean_value);
+
+            // The map holds the multiples of 2 and the other one the multiples
+            // of 3, so that the multiples of 6 are in both.
+            for (i = 0 ; i < num_self ; ++i)
+                map->put(map, (void*)(i * 2), (void*)(i * 2));
+            for (i = 0 ; i < num_other ; ++i)
+                other->put(other, (void*)(i * 3), (void*)(-i * 3));
+            assert(YacOrderedMapUnion(map, other) == true);
+            assert(other->size(other) == 0);
+            YacOrderedMapDeinit(other);
+
+            int num_dup = 0;
+            for (i = 0 ; i < num_self * 2 && i < num_other * 3 ; i += 6)
+                ++num_dup;
+            assert(num_clean_value == num_dup);
+            assert(map->size(map) == (unsigned)(num_self + num_other - num_dup));
+
+            intptr_t prev = -1;
+            map->first(map);
+            for (YacOrderedMapPair *pair = map->next(map); pair != NULL; pair = map->next(map)) {
+                intptr_t key = (intptr_t)pair->key;
+                bool from_other = key % 3 == 0 && key < num_other * 3;
+                assert(key > prev);
+                assert((intptr_t)pair->value == ((from_other)? -key : key));
+                prev = key;
+            }
+            YacOrderedMapData* data = map->data;
+            if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+                check_btree(data->btree_root_, true, (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) != 0);
+            else
+                check_red_black(data->null_, data->root_, (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) != 0);
+            if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC)
+                assert(YacOrderedMapSelect(map, 0)->key == (void*)0);
+        }
+        YacOrderedMapDeinit(map);
+    }
+
+    // The maps must match in the flags. The bulk build turns the node pool on
+    // without touching them, and the nodes are copied between the pooled and
+    // the unpooled maps.
+    YacOrderedMap* map = YacOrderedMapInit();
+    YacOrderedMap* other = YacOrderedMapInitWithFlags(YAC_ORDERED_MAP_BTREE);
+    other->put(other, (void*)1, NULL);
+    assert(YacOrderedMapUnion(map, other) == false);
+    YacOrderedMapDeinit(other);
+    other = YacOrderedMapInit();
+    YacOrderedMapPair pairs[] = {{(void*)10, (void*)10}, {(void*)12, (void*)12}};
+    YacOrderedMapBuild(other, pairs, 2);
+    assert(((YacOrderedMapData*)other->data)->flags_ == 0);
+    assert(YacOrderedMapJoin(map, other) == true);
+    YacOrderedMapDeinit(other);
+    other = YacOrderedMapInit();
+    other->put(other, (void*)6, (void*)6);
+    other->put(other, (void*)8, (void*)8);
+    assert(YacOrderedMapUnion(map, other) == true);
+    check_keys(map, 6, 12, 2, 1);
+    assert(YacOrderedMapSplit(map, (void*)10, other) == true);
+    check_keys(map, 6, 8, 2, 1);
+    check_keys(other, 10, 12, 2, 1);
+    YacOrderedMapDeinit(other);
+    YacOrderedMapDeinit(map);
+}
+
+void test_split_join_cycle(void)
+{
+    enum { NUM = 20000, NUM_ROUND = 50 };
+    intptr_t cuts[] = {NUM * 2 - 2000, 2000};
+    int round, kind;
+    intptr_t i;
+
+    // Splitting off either end and joining it back many times keeps the number
+    // of the live allocations, whether the nodes are pooled, built in bulk, or
+    // allocated one by one.
+    for (kind = 0 ; kind < 3 ; ++kind) {
+        unsigned flags = (kind == 0)? YAC_ORDERED_MAP_NODE_POOL : 0;
+        YacOrderedMap* map = YacOrderedMapInitWithFlags(flags);
+        YacOrderedMap* other = YacOrderedMapInitWithFlags(flags);
+        if (kind == 1) {
+            YacOrderedMapPair* pairs = malloc(sizeof(YacOrderedMapPair) * NUM);
+            for (i = 0 ; i < NUM ; ++i) {
+                pairs[i].key = (void*)(i * 2);
+                pairs[i].value = (void*)(i * 2);
+            }
+            assert(YacOrderedMapBuild(map, pairs, NUM) == true);
+            free(pairs);
+        } else {
+            for (i = 0 ; i < NUM ; ++i)
+                map->put(map, (void*)(i * 2), (void*)(i * 2));
+        }
+
+        int num_live = num_alloc;
+        for (round = 0 ; round < NUM_ROUND ; ++round) {
+            assert(YacOrderedMapSplit(map, (void*)cuts[round & 1], other) == true);
+            assert(YacOrderedMapJoin(map, other) == true);
+            assert(num_alloc == num_live);
+        }
+        check_keys(map, 0, NUM * 2 - 2, 2, 1);
+        check_keys(other, 0, -2, 2, 1);
+
+        YacOrderedMapDeinit(other);
+        YacOrderedMapDeinit(map);
+    }
+    assert(num_alloc == 0);
+}
+
 int main(void)
 {
     test_init_and_deinit();
@@ -278,6 +945,13 @@ int main(void)
     test_iterator();
     test_default_compare();
     test_compare_and_clean();
+    test_node_pool();
+    test_btree();
+    test_bound_and_range();
+    test_rank_and_select();
+    test_build();
+    test_split_join_union();
+    test_split_join_cycle();
 
     return 0;
 }
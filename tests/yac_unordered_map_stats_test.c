@@ -0,0 +1,4 @@
+// Run the whole unordered map suite again with the statistics compiled in, which
+// also enables test_stats.
+#define YAC_UNORDERED_MAP_STATS
+#include "yac_unordered_map_test.c"
@@ -167,6 +167,737 @@ void test_iterator(void)
     YacUnorderedMapDeinit(map);
 }
 
+void test_flat(void)
+{
+    {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_FLAT);
+        map->set_compare(map, compare_key);
+
+        map->put(map, (void*)(char*)"one", (void*)(int*)1);
+        map->put(map, (void*)(char*)"two", (void*)(int*)2);
+        map->put(map, (void*)(char*)"three", (void*)(int*)3);
+        assert(map->size(map) == 3);
+
+        int* val = (int*)map->get(map, (void*)(char*)"two");
+        assert((int*)val == (int*)2);
+
+        map->put(map, (void*)(char*)"two", (void*)(int*)9000);
+        assert(map->size(map) == 3);
+        val = (int*)map->get(map, (void*)(char*)"two");
+        assert((int*)val == (int*)9000);
+
+        assert(map->contain(map, (void*)(char*)"not found") == false);
+        assert(map->remove(map, (void*)(char*)"two") == true);
+        assert(map->remove(map, (void*)(char*)"two") == false);
+        assert(map->contain(map, (void*)(char*)"two") == false);
+        assert(map->size(map) == 2);
+
+        YacUnorderedMapDeinit(map);
+    }
+    {
+        // Grow through several rehashes and leave tombstones behind.
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_FLAT);
+
+        intptr_t i;
+        for (i = 1 ; i <= 10000 ; ++i)
+            assert(map->put(map, (void*)i, (void*)(i * 10)) == true);
+        assert(map->size(map) == 10000);
+
+        for (i = 1 ; i <= 10000 ; i += 2)
+            assert(YacUnorderedMapRemove(map, (void*)i) == true);
+        assert(map->size(map) == 5000);
+
+        for (i = 1 ; i <= 10000 ; ++i) {
+            if (i % 2)
+                assert(YacUnorderedMapContain(map, (void*)i) == false);
+            else
+                assert(YacUnorderedMapGet(map, (void*)i) == (void*)(i * 10));
+        }
+
+        int count = 0;
+        YacUnorderedMapPair* pair;
+        map->first(map);
+        while ((pair = map->next(map)) != NULL) {
+            assert((intptr_t)pair->value == (intptr_t)pair->key * 10);
+            ++count;
+        }
+        assert(count == 5000);
+
+        YacUnorderedMapDeinit(map);
+    }
+    {
+        // The slot array stops doubling at 2^31 slots instead of wrapping around.
+        unsigned num_slot = 1u << 31;
+        unsigned limit = num_slot - num_slot / 8;
+        assert(YacUnorderedMapFlatGrowSlot_(limit, num_slot / 2, limit / 2) == num_slot);
+        assert(YacUnorderedMapFlatGrowSlot_(limit / 4, num_slot, limit) == num_slot);
+        assert(YacUnorderedMapFlatGrowSlot_(limit - 1, num_slot, limit) == num_slot);
+        assert(YacUnorderedMapFlatGrowSlot_(limit, num_slot, limit) == 0);
+    }
+}
+
+// Check the compiled group matching kernel against the control bytes one by one.
+// The kernel is chosen at compile time, so the test is meant to be built with
+// the AVX2, the SSE2, and the scalar kernel in turn.
+static void check_group(const unsigned char* ctrl)
+{
+    unsigned char* group = malloc(YAC_UNORDERED_MAP_GROUP_WIDTH);
+    memcpy(group, ctrl, YAC_UNORDERED_MAP_GROUP_WIDTH);
+
+    unsigned char tags[YAC_UNORDERED_MAP_GROUP_WIDTH + 4] = {0x00, 0x05, 0x7F, YAC_UNORDERED_MAP_CTRL_EMPTY};
+    memcpy(tags + 4, ctrl, YAC_UNORDERED_MAP_GROUP_WIDTH);
+
+    unsigned empty = 0, full = 0, i, j;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i) {
+        if (ctrl[i] == YAC_UNORDERED_MAP_CTRL_EMPTY)
+            empty |= 1u << i;
+        if (YAC_UNORDERED_MAP_CTRL_IS_FULL(ctrl[i]))
+            full |= 1u << i;
+    }
+    unsigned all = (YAC_UNORDERED_MAP_GROUP_WIDTH == 32)? ~0u : (1u << YAC_UNORDERED_MAP_GROUP_WIDTH) - 1;
+    assert(YacUnorderedMapGroupMatchEmpty_(group) == empty);
+    assert(YacUnorderedMapGroupMatchEmptyOrDeleted_(group) == (all & ~full));
+
+    for (j = 0 ; j < sizeof(tags) ; ++j) {
+        unsigned match = 0;
+        for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i) {
+            if (ctrl[i] == tags[j])
+                match |= 1u << i;
+        }
+        assert(YacUnorderedMapGroupMatch_(group, tags[j]) == match);
+    }
+    free(group);
+}
+
+void test_group_match(void)
+{
+    unsigned char ctrl[YAC_UNORDERED_MAP_GROUP_WIDTH];
+    unsigned i, round;
+
+    memset(ctrl, YAC_UNORDERED_MAP_CTRL_EMPTY, sizeof(ctrl));
+    check_group(ctrl);
+    memset(ctrl, YAC_UNORDERED_MAP_CTRL_DELETED, sizeof(ctrl));
+    check_group(ctrl);
+    memset(ctrl, 0x7F, sizeof(ctrl));
+    check_group(ctrl);
+
+    // Every slot position takes every kind of control byte, including the
+    // highest and the lowest slot whose bits are easy to lose.
+    for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i)
+        ctrl[i] = (i % 4 == 0)? YAC_UNORDERED_MAP_CTRL_EMPTY : (i % 4 == 1)? YAC_UNORDERED_MAP_CTRL_DELETED :
+                  (i % 4 == 2)? 0x05 : 0x00;
+    check_group(ctrl);
+    for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i)
+        ctrl[i] = (unsigned char)(YAC_UNORDERED_MAP_GROUP_WIDTH - 1 - i);
+    check_group(ctrl);
+
+    unsigned seed = 2024;
+    for (round = 0 ; round < 1000 ; ++round) {
+        for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned pick = (seed >> 16) % 8;
+            ctrl[i] = (pick == 0)? YAC_UNORDERED_MAP_CTRL_EMPTY : (pick == 1)? YAC_UNORDERED_MAP_CTRL_DELETED :
+                      (unsigned char)((seed >> 8) & ((pick == 2)? 0x03 : 0x7F));
+        }
+        check_group(ctrl);
+    }
+}
+
+void test_incremental_rehash(void)
+{
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_INCREMENTAL_REHASH);
+
+    // Every key must stay reachable while the old slot arrays are drained.
+    intptr_t i;
+    for (i = 1 ; i <= 20000 ; ++i) {
+        assert(map->put(map, (void*)i, (void*)(i * 10)) == true);
+        assert(map->get(map, (void*)(i / 2 + 1)) == (void*)((i / 2 + 1) * 10));
+    }
+    assert(map->size(map) == 20000);
+
+    for (i = 1 ; i <= 20000 ; i += 2)
+        assert(map->remove(map, (void*)i) == true);
+    assert(map->size(map) == 10000);
+
+    for (i = 1 ; i <= 20000 ; ++i)
+        assert(map->contain(map, (void*)i) == ((i % 2) == 0));
+
+    int count = 0;
+    YacUnorderedMapPair* pair;
+    map->first(map);
+    while ((pair = map->next(map)) != NULL) {
+        assert((intptr_t)pair->value == (intptr_t)pair->key * 10);
+        ++count;
+    }
+    assert(count == 10000);
+
+    // The last put crosses the limit of 49157 slots and starts a new rehashing,
+    // so the destructor has to release the pairs left in the old slot array.
+    for (i = 20001 ; i <= 46868 ; ++i)
+        map->put(map, (void*)i, (void*)(i * 10));
+    YacUnorderedMapDeinit(map);
+}
+
+unsigned hash_key(void* key)
+{
+    return YacUnorderedMapHashDjb2((char*)key);
+}
+
+void test_cache_hash(void)
+{
+    static char keys[5000][8];
+
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_INCREMENTAL_REHASH);
+    map->set_hash(map, hash_key);
+    map->set_compare(map, compare_key);
+
+    intptr_t i;
+    for (i = 0 ; i < 5000 ; ++i) {
+        snprintf(keys[i], sizeof(keys[i]), "k%d", (int)i);
+        assert(map->put(map, (void*)keys[i], (void*)i) == true);
+    }
+    assert(map->size(map) == 5000);
+
+    // Lookup with an equal key stored at a different address.
+    char probe[8];
+    for (i = 0 ; i < 5000 ; ++i) {
+        snprintf(probe, sizeof(probe), "k%d", (int)i);
+        assert(map->get(map, (void*)probe) == (void*)i);
+    }
+
+    assert(map->remove(map, (void*)"k42") == true);
+    assert(map->contain(map, (void*)"k42") == false);
+    assert(map->contain(map, (void*)"k4999") == true);
+    assert(map->size(map) == 4999);
+
+    YacUnorderedMapDeinit(map);
+}
+
+void test_power_of_two(void)
+{
+    unsigned flags[] = {
+        YAC_UNORDERED_MAP_POWER_OF_TWO,
+        YAC_UNORDERED_MAP_POWER_OF_TWO | YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_INCREMENTAL_REHASH,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+
+        // Keys sharing their low bits must still spread over the slots.
+        intptr_t i;
+        for (i = 1 ; i <= 10000 ; ++i)
+            assert(map->put(map, (void*)(i << 12), (void*)i) == true);
+        assert(map->size(map) == 10000);
+
+        for (i = 1 ; i <= 10000 ; ++i)
+            assert(map->get(map, (void*)(i << 12)) == (void*)i);
+        assert(map->contain(map, (void*)(intptr_t)1) == false);
+
+        for (i = 1 ; i <= 10000 ; i += 2)
+            assert(map->remove(map, (void*)(i << 12)) == true);
+        assert(map->size(map) == 5000);
+
+        YacUnorderedMapDeinit(map);
+    }
+
+    // The slot array stops doubling at 2^31 slots instead of wrapping around.
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_POWER_OF_TWO);
+    YacUnorderedMapData* data = map->data;
+    unsigned num_slot = data->num_slot_;
+    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
+    data->num_slot_ = 1u << 31;
+    YacUnorderedMapReHash_(data);
+    assert(data->num_slot_ == (1u << 31));
+    assert(data->arr_slot_ == arr_slot);
+    data->num_slot_ = num_slot;
+    YacUnorderedMapDeinit(map);
+}
+
+void test_capacity_and_put_many(void)
+{
+    static YacUnorderedMapPair pairs[50000];
+
+    intptr_t i;
+    for (i = 0 ; i < 50000 ; ++i) {
+        pairs[i].key = (void*)(i + 1);
+        pairs[i].value = (void*)((i + 1) * 10);
+    }
+
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_POWER_OF_TWO | YAC_UNORDERED_MAP_INCREMENTAL_REHASH,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithCapacity(flags[j], 50000);
+        assert(map != NULL);
+        assert(YacUnorderedMapPutMany(map, pairs, 50000) == true);
+        assert(map->size(map) == 50000);
+        YacUnorderedMapDeinit(map);
+
+        // Bulk load on top of existing pairs, replacing the overlapping ones.
+        map = YacUnorderedMapInitWithFlags(flags[j]);
+        for (i = 1 ; i <= 1000 ; ++i)
+            map->put(map, (void*)i, (void*)i);
+        assert(YacUnorderedMapReserve(map, 100) == true);
+        assert(YacUnorderedMapPutMany(map, pairs, 50000) == true);
+        assert(map->size(map) == 50000);
+        for (i = 1 ; i <= 50000 ; ++i)
+            assert(map->get(map, (void*)i) == (void*)(i * 10));
+
+        // Reserving on a map with pairs keeps them reachable.
+        assert(YacUnorderedMapReserve(map, 200000) == true);
+        for (i = 1 ; i <= 50000 ; ++i)
+            assert(map->contain(map, (void*)i) == true);
+        assert(map->size(map) == 50000);
+        YacUnorderedMapDeinit(map);
+    }
+}
+
+void test_external_iterator(void)
+{
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        // The incremental rehashing is still migrating the old slots after 2320 puts.
+        intptr_t i;
+        for (i = 1 ; i <= 2320 ; ++i)
+            map->put(map, (void*)i, (void*)i);
+
+        // Nested traversals keep their own cursors.
+        intptr_t sum = 0;
+        unsigned num_pair = 0;
+        YacUnorderedMapIterator outer = YacUnorderedMapBegin(map);
+        YacUnorderedMapPair* pair;
+        while ((pair = YacUnorderedMapIteratorNext(&outer)) != NULL) {
+            sum += (intptr_t)pair->value;
+            if (num_pair++ == 0) {
+                unsigned num_inner = 0;
+                YacUnorderedMapIterator inner = YacUnorderedMapBegin(map);
+                while (YacUnorderedMapIteratorNext(&inner))
+                    ++num_inner;
+                assert(num_inner == 2320);
+            }
+        }
+        assert(num_pair == 2320);
+        assert(sum == 2320 * 2321 / 2);
+        assert(YacUnorderedMapIteratorNext(&outer) == NULL);
+
+        // Disjoint bucket ranges visit every pair once.
+        unsigned num_bucket = YacUnorderedMapBucketCount(map);
+        unsigned num_shard = 7;
+        sum = 0;
+        num_pair = 0;
+        unsigned k;
+        for (k = 0 ; k < num_shard ; ++k) {
+            YacUnorderedMapIterator iter = YacUnorderedMapBeginRange(map,
+                (unsigned)((unsigned long long)num_bucket * k / num_shard),
+                (unsigned)((unsigned long long)num_bucket * (k + 1) / num_shard));
+            while ((pair = YacUnorderedMapIteratorNext(&iter)) != NULL) {
+                sum += (intptr_t)pair->key;
+                ++num_pair;
+            }
+        }
+        assert(num_pair == 2320);
+        assert(sum == 2320 * 2321 / 2);
+
+        YacUnorderedMapIterator empty = YacUnorderedMapBeginRange(map, num_bucket, num_bucket + 10);
+        assert(YacUnorderedMapIteratorNext(&empty) == NULL);
+
+        YacUnorderedMapDeinit(map);
+    }
+}
+
+void test_hash_and_entry(void)
+{
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_CACHE_HASH,
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_READ_MOSTLY,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* lhs = YacUnorderedMapInitWithFlags(flags[j]);
+        YacUnorderedMap* rhs = YacUnorderedMapInitWithFlags(flags[j]);
+
+        // Count the keys with the entries, so that each key is probed once.
+        intptr_t i;
+        for (i = 0 ; i < 30000 ; ++i) {
+            bool inserted;
+            YacUnorderedMapPair* pair = YacUnorderedMapEntry(lhs, (void*)(i % 10000 + 1), &inserted);
+            assert(pair != NULL);
+            assert(inserted == (i < 10000));
+            pair->value = (void*)((intptr_t)pair->value + 1);
+        }
+        assert(lhs->size(lhs) == 10000);
+
+        // One hash serves the lookups in both maps.
+        for (i = 1 ; i <= 10000 ; ++i) {
+            unsigned hash = YacUnorderedMapHashKey(lhs, (void*)i);
+            assert(YacUnorderedMapGetWithHash(lhs, (void*)i, hash) == (void*)3);
+            assert(YacUnorderedMapContainWithHash(rhs, (void*)i, hash) == false);
+            assert(YacUnorderedMapPutWithHash(rhs, (void*)i, (void*)(i * 10), hash) == true);
+            if (i % 2 == 0)
+                assert(YacUnorderedMapRemoveWithHash(lhs, (void*)i, hash) == true);
+        }
+        assert(lhs->size(lhs) == 5000);
+        assert(rhs->size(rhs) == 10000);
+        for (i = 1 ; i <= 10000 ; ++i) {
+            assert(lhs->contain(lhs, (void*)i) == (i % 2 != 0));
+            assert(rhs->get(rhs, (void*)i) == (void*)(i * 10));
+        }
+
+        YacUnorderedMapDeinit(lhs);
+        YacUnorderedMapDeinit(rhs);
+    }
+}
+
+void test_get_many(void)
+{
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_CACHE_HASH,
+        YAC_UNORDERED_MAP_POWER_OF_TWO,
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_READ_MOSTLY,
+    };
+
+    // The batch size is not a multiple of the prefetch batch, and half the keys are missing.
+    static void* keys[1001];
+    static void* values[1001];
+    intptr_t i;
+    for (i = 0 ; i < 1001 ; ++i)
+        keys[i] = (void*)(i * 7 + 1);
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        for (i = 1 ; i <= 3500 ; ++i)
+            map->put(map, (void*)i, (void*)(i * 10));
+
+        assert(YacUnorderedMapGetMany(map, keys, 1001, values) == 500);
+        for (i = 0 ; i < 1001 ; ++i)
+            assert(values[i] == map->get(map, keys[i]));
+        assert(YacUnorderedMapGetMany(map, keys, 0, values) == 0);
+
+        YacUnorderedMapDeinit(map);
+    }
+}
+
+void sum_value(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    // One accumulator per shard.
+    ((intptr_t*)arg)[shard] += (intptr_t)pair->value;
+    pair->value = (void*)((intptr_t)pair->value * 2);
+}
+
+bool is_odd_key(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    (void)shard;
+    (void)arg;
+    return ((intptr_t)pair->key & 1) != 0;
+}
+
+void test_parallel_bulk(void)
+{
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_NODE_POOL,
+        YAC_UNORDERED_MAP_POWER_OF_TWO | YAC_UNORDERED_MAP_CACHE_HASH,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+    };
+    unsigned num_thread[] = {0, 1, 4, 1000};
+
+    unsigned j, k;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        for (k = 0 ; k < sizeof(num_thread) / sizeof(num_thread[0]) ; ++k) {
+            YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+            intptr_t i;
+            for (i = 1 ; i <= 20000 ; ++i)
+                map->put(map, (void*)i, (void*)i);
+
+            static intptr_t sum[64];
+            memset(sum, 0, sizeof(sum));
+            assert(YacUnorderedMapForEach(map, sum_value, sum, num_thread[k]) == true);
+            intptr_t total = 0;
+            for (i = 0 ; i < 64 ; ++i)
+                total += sum[i];
+            assert(total == (intptr_t)20000 * 20001 / 2);
+            assert(map->get(map, (void*)7) == (void*)14);
+
+            YacUnorderedMap* odd = YacUnorderedMapFilter(map, is_odd_key, NULL, num_thread[k]);
+            assert(odd != NULL);
+            assert(odd->size(odd) == 10000);
+            assert(odd->get(odd, (void*)7) == (void*)14);
+            assert(odd->contain(odd, (void*)8) == false);
+            YacUnorderedMapDeinit(odd);
+
+            assert(YacUnorderedMapRemoveIf(map, is_odd_key, NULL, num_thread[k]) == 10000);
+            assert(map->size(map) == 10000);
+            for (i = 1 ; i <= 20000 ; ++i)
+                assert(map->contain(map, (void*)i) == ((i & 1) == 0));
+            assert(YacUnorderedMapRemoveIf(map, is_odd_key, NULL, num_thread[k]) == 0);
+
+            // The removed slots and nodes are reusable.
+            for (i = 1 ; i <= 20000 ; i += 2)
+                assert(map->put(map, (void*)i, (void*)i) == true);
+            assert(map->size(map) == 20000);
+            YacUnorderedMapDeinit(map);
+        }
+    }
+}
+
+void concurrent_update(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    (void)shard;
+    YacUnorderedMap* map = arg;
+    intptr_t key = (intptr_t)pair->key;
+    assert(map->put(map, (void*)key, (void*)(key * 10)) == true);
+    assert(map->get(map, (void*)key) == (void*)(key * 10));
+    if (key % 3 == 0)
+        assert(map->remove(map, (void*)key) == true);
+    assert(map->contain(map, (void*)key) == (key % 3 != 0));
+}
+
+void test_concurrent(void)
+{
+    // The keys are fed to the concurrent map by the worker threads of ForEach.
+    YacUnorderedMap* keys = YacUnorderedMapInit();
+    intptr_t i;
+    for (i = 1 ; i <= 60000 ; ++i)
+        keys->put(keys, (void*)i, (void*)i);
+
+    unsigned flags[] = {
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_CONCURRENT | YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_FLAT,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        assert(map != NULL);
+        assert(YacUnorderedMapForEach(keys, concurrent_update, map, 8) == true);
+        assert(map->size(map) == 40000);
+        for (i = 1 ; i <= 60000 ; ++i)
+            assert(map->get(map, (void*)i) == ((i % 3 != 0)? (void*)(i * 10) : NULL));
+
+        // The operations with exclusive access see the same size.
+        static YacUnorderedMapPair pairs[3];
+        pairs[0].key = (void*)3;
+        pairs[1].key = (void*)6;
+        pairs[2].key = (void*)7;
+        assert(YacUnorderedMapPutMany(map, pairs, 3) == true);
+        assert(map->size(map) == 40002);
+        assert(map->remove(map, (void*)3) == true);
+        assert(map->size(map) == 40001);
+        YacUnorderedMapDeinit(map);
+    }
+
+    YacUnorderedMapDeinit(keys);
+}
+
+static int num_clean_value;
+
+void count_clean_value(void* value)
+{
+    (void)value;
+    ++num_clean_value;
+}
+
+void read_mostly_update(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    (void)shard;
+    YacUnorderedMap* map = arg;
+    intptr_t key = (intptr_t)pair->key;
+
+    // The keys up to 20000 are replaced, read, or removed, and the others are added.
+    if (key > 40000) {
+        key -= 40000;
+        if ((key & 1) && key % 3 == 0)
+            assert(map->remove(map, (void*)key) == true);
+    } else if (key > 20000) {
+        assert(map->put(map, (void*)key, (void*)key) == true);
+        assert(map->get(map, (void*)key) == (void*)key);
+    } else if (key & 1) {
+        unsigned token = YacUnorderedMapReadEnter(map);
+        void* value = map->get(map, (void*)(key + 1));
+        assert(value == (void*)(key + 1) || value == (void*)(key * 2 + 2));
+        YacUnorderedMapReadLeave(map, token);
+    } else {
+        assert(map->put(map, (void*)key, (void*)(key * 2)) == true);
+    }
+}
+
+void test_read_mostly(void)
+{
+    YacUnorderedMap* keys = YacUnorderedMapInit();
+    intptr_t i;
+    for (i = 1 ; i <= 60000 ; ++i)
+        keys->put(keys, (void*)i, (void*)i);
+
+    unsigned flags[] = {
+        YAC_UNORDERED_MAP_READ_MOSTLY,
+        YAC_UNORDERED_MAP_READ_MOSTLY | YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_NODE_POOL |
+            YAC_UNORDERED_MAP_POWER_OF_TWO,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        assert(map != NULL);
+        num_clean_value = 0;
+        map->set_clean_value(map, count_clean_value);
+        for (i = 1 ; i <= 20000 ; ++i)
+            assert(map->put(map, (void*)i, (void*)i) == true);
+
+        // The slot array grows while the readers traverse it.
+        assert(YacUnorderedMapForEach(keys, read_mostly_update, map, 8) == true);
+
+        int num_remove = 0;
+        for (i = 1 ; i <= 40000 ; ++i) {
+            void* value = map->get(map, (void*)i);
+            if (i > 20000)
+                assert(value == (void*)i);
+            else if (i % 2 == 0)
+                assert(value == (void*)(i * 2));
+            else if (i % 3 == 0) {
+                assert(value == NULL);
+                ++num_remove;
+            } else
+                assert(value == (void*)i);
+        }
+        assert(map->size(map) == 40000u - num_remove);
+
+        // The replaced and removed pairs are cleaned once, like the remaining ones.
+        assert(YacUnorderedMapReserve(map, 100000) == true);
+        assert(map->get(map, (void*)40000) == (void*)40000);
+        YacUnorderedMapDeinit(map);
+        assert(num_clean_value == 50000);
+    }
+
+    // The read sections are no-ops for the other maps.
+    YacUnorderedMapReadLeave(keys, YacUnorderedMapReadEnter(keys));
+    YacUnorderedMapDeinit(keys);
+}
+
+#define int_hash(key) ((unsigned)(key))
+#define int_eq(lhs, rhs) ((lhs) == (rhs))
+YAC_UNORDERED_MAP_DEFINE(IntCounter, int, int, int_hash, int_eq)
+
+#define str_hash(key) YacUnorderedMapHashDjb2((char*)(key))
+#define str_eq(lhs, rhs) (strcmp((lhs), (rhs)) == 0)
+YAC_UNORDERED_MAP_DEFINE(StrMap, const char*, double, str_hash, str_eq)
+
+void test_typed_map(void)
+{
+    IntCounter* counter = IntCounterInit();
+    assert(counter != NULL);
+
+    // Count the residues, updating the values in place.
+    int i;
+    for (i = 0 ; i < 100000 ; ++i) {
+        int* count = IntCounterGet(counter, i % 5000);
+        if (count)
+            ++(*count);
+        else
+            assert(IntCounterPut(counter, i % 5000, 1) == true);
+    }
+    assert(IntCounterSize(counter) == 5000);
+    for (i = 0 ; i < 5000 ; ++i)
+        assert(*IntCounterGet(counter, i) == 20);
+    assert(IntCounterGet(counter, 5000) == NULL);
+
+    for (i = 0 ; i < 5000 ; i += 2)
+        assert(IntCounterRemove(counter, i) == true);
+    assert(IntCounterRemove(counter, 0) == false);
+    assert(IntCounterSize(counter) == 2500);
+    for (i = 0 ; i < 5000 ; ++i)
+        assert(IntCounterContain(counter, i) == (i % 2 == 1));
+
+    assert(IntCounterReserve(counter, 100000) == true);
+    assert(IntCounterPut(counter, 1, 7) == true);
+    assert(IntCounterSize(counter) == 2500);
+
+    int num_pair = 0;
+    long long sum = 0;
+    IntCounterFirst(counter);
+    for (IntCounterPair* pair = IntCounterNext(counter); pair != NULL; pair = IntCounterNext(counter)) {
+        ++num_pair;
+        sum += pair->value;
+    }
+    assert(num_pair == 2500);
+    assert(sum == 2499 * 20 + 7);
+    IntCounterDeinit(counter);
+
+    StrMap* map = StrMapInit();
+    assert(StrMapPut(map, "pi", 3.14) == true);
+    assert(StrMapPut(map, "e", 2.71) == true);
+    assert(StrMapPut(map, "pi", 3.1416) == true);
+    assert(StrMapSize(map) == 2);
+    assert(*StrMapGet(map, "pi") == 3.1416);
+    assert(StrMapGet(map, "phi") == NULL);
+    StrMapDeinit(map);
+}
+
+void test_node_pool(void)
+{
+    unsigned flags[] = {
+        YAC_UNORDERED_MAP_NODE_POOL,
+        YAC_UNORDERED_MAP_NODE_POOL | YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_INCREMENTAL_REHASH,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        assert(map != NULL);
+
+        intptr_t i;
+        for (i = 1 ; i <= 10000 ; ++i)
+            assert(map->put(map, (void*)i, (void*)(i * 10)) == true);
+
+        // Remove the odd keys and put them back through the recycled nodes.
+        for (i = 1 ; i <= 10000 ; i += 2)
+            assert(map->remove(map, (void*)i) == true);
+        assert(map->size(map) == 5000);
+        for (i = 1 ; i <= 10000 ; i += 2)
+            assert(map->put(map, (void*)i, (void*)(i * 20)) == true);
+        assert(map->size(map) == 10000);
+
+        for (i = 1 ; i <= 10000 ; ++i)
+            assert(map->get(map, (void*)i) == (void*)(i * ((i & 1)? 20 : 10)));
+
+        YacUnorderedMapDeinit(map);
+
+        // The cleanup functions still see every pair on destruction.
+        num_clean_value = 0;
+        map = YacUnorderedMapInitWithFlags(flags[j]);
+        map->set_clean_value(map, count_clean_value);
+        for (i = 1 ; i <= 3000 ; ++i)
+            map->put(map, (void*)i, (void*)i);
+        map->remove(map, (void*)1);
+        YacUnorderedMapDeinit(map);
+        assert(num_clean_value == 3000);
+    }
+}
+
 void test_hash_murmur32(void)
 {
     unsigned value = YacUnorderedMapHashMurMur32(NULL, 32);
@@ -175,12 +906,17 @@ void test_hash_murmur32(void)
     value = YacUnorderedMapHashMurMur32("NULL", 0);
     assert(value == 0);
 
-    // Test string key.
+    // Test string key. The tail bytes follow the blocks.
     value = YacUnorderedMapHashMurMur32((void*)"1", 1);
+    assert(value == 0x0bc73f0d);
     value = YacUnorderedMapHashMurMur32((void*)"12", 2);
+    assert(value == 0xfa4ffce5);
     value = YacUnorderedMapHashMurMur32((void*)"123", 3);
+    assert(value == 0x0b392f6c);
     value = YacUnorderedMapHashMurMur32((void*)"1234", 4);
+    assert(value == 0x1357aeb8);
     value = YacUnorderedMapHashMurMur32((void*)"12345", 5);
+    assert(value == 0x286601ea);
 
     // Test integer key.
     int key_int = 32767;
@@ -205,6 +941,560 @@ void test_hash_murmur32(void)
 
 }
 
+void test_hash_suite(void)
+{
+    assert(YacUnorderedMapHashCrc32c((void*)"123456789", 9) == 0xe3069283);
+    assert(YacUnorderedMapHashCrc32c((void*)"", 0) == 0);
+
+    // Every length of the key, including the unaligned copies, hashes differently.
+    static unsigned char buf[257];
+    unsigned i;
+    for (i = 0 ; i < 256 ; ++i)
+        buf[i + 1] = (unsigned char)(i * 131 + 7);
+    static uint64_t arr_hash[256];
+    for (i = 0 ; i < 256 ; ++i) {
+        arr_hash[i] = YacUnorderedMapHashWy64(buf + 1, i, 0);
+        unsigned crc = YacUnorderedMapHashCrc32c(buf + 1, i);
+        unsigned j;
+        for (j = 0 ; j < i ; ++j)
+            assert(arr_hash[j] != arr_hash[i]);
+        memmove(buf, buf + 1, 256);
+        assert(YacUnorderedMapHashWy64(buf, i, 0) == arr_hash[i]);
+        assert(YacUnorderedMapHashCrc32c(buf, i) == crc);
+        memmove(buf + 1, buf, 256);
+    }
+
+    // The seed and every input bit change the hash.
+    assert(YacUnorderedMapHashWy64(buf, 100, 1) != YacUnorderedMapHashWy64(buf, 100, 0));
+    for (i = 0 ; i < 100 * 8 ; ++i) {
+        buf[1 + i / 8] ^= (unsigned char)(1u << (i % 8));
+        assert(YacUnorderedMapHashWy64(buf + 1, 100, 0) != arr_hash[100]);
+        buf[1 + i / 8] ^= (unsigned char)(1u << (i % 8));
+    }
+
+    // The string adapters hash the bytes before the terminator.
+    char* word = "the quick brown fox";
+    assert(YacUnorderedMapHashString64(word) == YacUnorderedMapHashWy64(word, strlen(word), 0));
+    assert(YacUnorderedMapHashString(word) == YacUnorderedMapHashWy32(word, strlen(word)));
+
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_FLAT);
+    map->set_hash(map, YacUnorderedMapHashString);
+    map->set_compare(map, (YacUnorderedMapCompare)strcmp);
+    static char keys[1000][8];
+    for (i = 0 ; i < 1000 ; ++i) {
+        sprintf(keys[i], "k%u", i);
+        assert(map->put(map, keys[i], (void*)(intptr_t)(i + 1)) == true);
+    }
+    char probe[8];
+    for (i = 0 ; i < 1000 ; ++i) {
+        sprintf(probe, "k%u", i);
+        assert(map->get(map, probe) == (void*)(intptr_t)(i + 1));
+    }
+    YacUnorderedMapDeinit(map);
+}
+
+unsigned colliding_hash(void* key)
+{
+    (void)key;
+    return 7;
+}
+
+uint64_t colliding_seeded_hash(void* key, const uint64_t* seed)
+{
+    (void)key;
+    return seed[0];
+}
+
+void test_seeded_and_treeify(void)
+{
+    // The reference vectors of SipHash-2-4 use the key 00..0f and the message 00..0e.
+    unsigned char bytes[16];
+    unsigned i;
+    for (i = 0 ; i < 16 ; ++i)
+        bytes[i] = (unsigned char)i;
+    uint64_t seed[2];
+    memcpy(seed, bytes, sizeof(seed));
+    assert(YacUnorderedMapHashSip24(bytes, 0, seed) == 0x726fdb47dd0e0e31ull);
+    assert(YacUnorderedMapHashSip24(bytes, 15, seed) == 0xa129ca6149be45e5ull);
+    assert(YacUnorderedMapHashSip13(bytes, 15, seed) != YacUnorderedMapHashSip24(bytes, 15, seed));
+
+    // Each seeded map draws its own seed unless one is injected before the insertions.
+    YacUnorderedMap* lhs = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_SEEDED);
+    YacUnorderedMap* rhs = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_SEEDED);
+    intptr_t key;
+    bool differ = false;
+    for (key = 1 ; key <= 8 ; ++key)
+        differ |= YacUnorderedMapHashKey(lhs, (void*)key) != YacUnorderedMapHashKey(rhs, (void*)key);
+    assert(differ);
+    assert(YacUnorderedMapSetSeed(lhs, 1, 2) == true);
+    assert(YacUnorderedMapSetSeed(rhs, 1, 2) == true);
+    for (key = 1 ; key <= 1000 ; ++key) {
+        assert(YacUnorderedMapHashKey(lhs, (void*)key) == YacUnorderedMapHashKey(rhs, (void*)key));
+        assert(lhs->put(lhs, (void*)key, (void*)key) == true);
+    }
+    for (key = 1 ; key <= 1000 ; ++key)
+        assert(lhs->get(lhs, (void*)key) == (void*)key);
+    assert(YacUnorderedMapSetSeed(lhs, 3, 4) == false);
+    YacUnorderedMapDeinit(lhs);
+    YacUnorderedMapDeinit(rhs);
+
+    // All the keys collide, so every operation runs against a single tree.
+    unsigned flags[] = {
+        YAC_UNORDERED_MAP_TREEIFY,
+        YAC_UNORDERED_MAP_TREEIFY | YAC_UNORDERED_MAP_CACHE_HASH | YAC_UNORDERED_MAP_NODE_POOL,
+        YAC_UNORDERED_MAP_TREEIFY | YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_POWER_OF_TWO,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        map->set_hash(map, colliding_hash);
+        num_clean_value = 0;
+        map->set_clean_value(map, count_clean_value);
+
+        for (key = 1 ; key <= 3000 ; ++key)
+            assert(map->put(map, (void*)key, (void*)key) == true);
+        for (key = 1 ; key <= 3000 ; key += 3)
+            assert(map->put(map, (void*)key, (void*)(key * 2)) == true);
+        for (key = 2 ; key <= 3000 ; key += 3)
+            assert(map->remove(map, (void*)key) == true);
+        assert(map->remove(map, (void*)2) == false);
+        assert(map->size(map) == 2000);
+
+        bool inserted;
+        YacUnorderedMapPair* pair = YacUnorderedMapEntry(map, (void*)3001, &inserted);
+        assert(pair != NULL && inserted == true);
+        pair->value = (void*)3001;
+        pair = YacUnorderedMapEntry(map, (void*)3, &inserted);
+        assert(pair != NULL && inserted == false && pair->value == (void*)3);
+
+        // Growing the slot array and removing in bulk rebuild the trees.
+        assert(YacUnorderedMapReserve(map, 10000) == true);
+        assert(YacUnorderedMapRemoveIf(map, is_odd_key, NULL, 4) == 1001);
+        for (key = 1 ; key <= 3001 ; ++key) {
+            void* value = map->get(map, (void*)key);
+            if (key % 2 != 0 || key % 3 == 2)
+                assert(value == NULL);
+            else if (key % 3 == 1)
+                assert(value == (void*)(key * 2));
+            else
+                assert(value == (void*)key);
+        }
+
+        unsigned num_pair = 0;
+        map->first(map);
+        while ((pair = map->next(map)) != NULL)
+            ++num_pair;
+        assert(num_pair == map->size(map));
+        assert(num_pair == 1000);
+
+        YacUnorderedMapDeinit(map);
+        assert(num_clean_value == 4001);
+    }
+
+    // The string keys of a seeded map are still ordered by the comparison function.
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_SEEDED | YAC_UNORDERED_MAP_TREEIFY);
+    YacUnorderedMapSetSeededHash(map, colliding_seeded_hash);
+    map->set_compare(map, compare_key);
+    static char words[500][8];
+    for (i = 0 ; i < 500 ; ++i) {
+        sprintf(words[i], "w%u", i);
+        assert(map->put(map, words[i], (void*)(intptr_t)(i + 1)) == true);
+    }
+    char probe[8];
+    for (i = 0 ; i < 500 ; ++i) {
+        sprintf(probe, "w%u", i);
+        assert(map->get(map, probe) == (void*)(intptr_t)(i + 1));
+        if (i % 2 == 0)
+            assert(map->remove(map, probe) == true);
+    }
+    assert(map->size(map) == 250);
+    YacUnorderedMapDeinit(map);
+}
+
+bool is_quarter_value(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    (void)shard;
+    (void)arg;
+    return (intptr_t)pair->value % 4 == 0;
+}
+
+void test_compact(void)
+{
+    YacUnorderedMap* map = YacUnorderedMapInitWithFlags(YAC_UNORDERED_MAP_COMPACT | YAC_UNORDERED_MAP_FLAT);
+    num_clean_value = 0;
+    map->set_clean_value(map, count_clean_value);
+
+    // The pairs are iterated in insertion order until the first removal.
+    intptr_t i;
+    for (i = 1 ; i <= 100000 ; ++i)
+        assert(map->put(map, (void*)(i * 7), (void*)i) == true);
+    YacUnorderedMapPair* pair;
+    map->first(map);
+    for (i = 1 ; (pair = map->next(map)) != NULL ; ++i)
+        assert(pair->key == (void*)(i * 7) && pair->value == (void*)i);
+    assert(i == 100001);
+
+    // Removal moves the last pairs into the vacated entries and reuses the
+    // tombstones, so churn keeps the index table from growing.
+    for (i = 1 ; i <= 100000 ; i += 2)
+        assert(map->remove(map, (void*)(i * 7)) == true);
+    assert(map->remove(map, (void*)7) == false);
+    assert(map->size(map) == 50000);
+    YacUnorderedMapData* data = map->data;
+    unsigned num_slot = data->num_slot_;
+    int round;
+    for (round = 0 ; round < 4 ; ++round) {
+        for (i = 1 ; i <= 100000 ; i += 2)
+            assert(map->put(map, (void*)(i * 7), (void*)(i + round)) == true);
+        for (i = 1 ; i <= 100000 ; i += 2)
+            assert(map->remove(map, (void*)(i * 7)) == true);
+    }
+    assert(data->num_slot_ == num_slot);
+#ifdef YAC_UNORDERED_MAP_STATS
+    YacUnorderedMapStats stats;
+    YacUnorderedMapGetStats(map, &stats);
+    assert(stats.num_occupied == 50000);
+#endif
+
+    for (i = 1 ; i <= 100000 ; ++i)
+        assert(map->get(map, (void*)(i * 7)) == ((i % 2 == 0)? (void*)i : NULL));
+    unsigned num_pair = 0;
+    map->first(map);
+    while ((pair = map->next(map)) != NULL) {
+        assert((intptr_t)pair->key == (intptr_t)pair->value * 7);
+        ++num_pair;
+    }
+    assert(num_pair == 50000);
+
+    // Bulk removal keeps the remaining pairs in their order.
+    static void* order[50000];
+    num_pair = 0;
+    map->first(map);
+    while ((pair = map->next(map)) != NULL) {
+        if ((intptr_t)pair->value % 4 != 0)
+            order[num_pair++] = pair->key;
+    }
+    assert(YacUnorderedMapRemoveIf(map, is_quarter_value, NULL, 4) == 25000);
+    assert(map->size(map) == 25000 && num_pair == 25000);
+    map->first(map);
+    for (num_pair = 0 ; (pair = map->next(map)) != NULL ; ++num_pair)
+        assert(pair->key == order[num_pair]);
+    for (i = 1 ; i <= 100000 ; ++i)
+        assert(map->contain(map, (void*)(i * 7)) == (i % 2 == 0 && i % 4 != 0));
+
+    // The index table stops doubling at 2^31 slots, and a full table fails the
+    // insert instead of wrapping around.
+    unsigned curr_limit = data->curr_limit_, growth_left = data->growth_left_;
+    uint32_t* arr_index = data->arr_index_;
+    num_slot = data->num_slot_;
+    data->num_slot_ = 1u << 31;
+    data->curr_limit_ = (unsigned)data->size_;
+    data->growth_left_ = 0;
+    assert(YacUnorderedMapCompactInsert_(data, (void*)1, (void*)1, 1) == NULL);
+    assert(data->num_slot_ == (1u << 31) && data->arr_index_ == arr_index);
+    assert(map->size(map) == 25000);
+    data->num_slot_ = num_slot;
+    data->curr_limit_ = curr_limit;
+    data->growth_left_ = growth_left;
+
+    YacUnorderedMapDeinit(map);
+    assert(num_clean_value == 100000 + 4 * 50000);
+}
+
+#ifdef YAC_UNORDERED_MAP_STATS
+
+void stats_get(YacUnorderedMapPair* pair, unsigned shard, void* arg)
+{
+    (void)shard;
+    YacUnorderedMap* map = arg;
+    assert(map->get(map, pair->key) == pair->key);
+}
+
+void stats_print(const char* line, void* arg)
+{
+    if (*(int*)arg == 0)
+        assert(strncmp(line, "size 1000,", 10) == 0);
+    ++(*(int*)arg);
+}
+
+void test_stats(void)
+{
+    // A single slot list of 1000 nodes takes 500.5 probes per hit on average.
+    YacUnorderedMap* map = YacUnorderedMapInit();
+    map->set_hash(map, colliding_hash);
+    intptr_t i;
+    for (i = 1 ; i <= 1000 ; ++i)
+        map->put(map, (void*)i, (void*)i);
+    YacUnorderedMapResetStats(map);
+    for (i = 1 ; i <= 1000 ; ++i)
+        assert(map->get(map, (void*)i) == (void*)i);
+
+    YacUnorderedMapStats stats;
+    YacUnorderedMapGetStats(map, &stats);
+    assert(stats.size == 1000);
+    assert(stats.num_occupied == 1);
+    assert(stats.max_chain == 1000);
+    assert(stats.histogram[0] == stats.num_slot - 1);
+    assert(stats.histogram[YAC_UNORDERED_MAP_STATS_NUM_BUCKET - 1] == 1);
+    assert(stats.num_get == 1000);
+    assert(stats.num_probe == 500500);
+    assert(stats.num_rehash == 0);
+
+    int num_line = 0;
+    YacUnorderedMapDumpStats(map, stats_print, &num_line);
+    assert(num_line == 6);
+    YacUnorderedMapDeinit(map);
+
+    // The histogram accounts for every slot or pair, and the gets of the
+    // locking maps are counted from the worker threads.
+    YacUnorderedMap* keys = YacUnorderedMapInit();
+    for (i = 1 ; i <= 20000 ; ++i)
+        keys->put(keys, (void*)i, (void*)i);
+
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_READ_MOSTLY,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        map = YacUnorderedMapInitWithFlags(flags[j]);
+        for (i = 1 ; i <= 20000 ; ++i)
+            map->put(map, (void*)i, (void*)i);
+        assert(YacUnorderedMapForEach(keys, stats_get, map, 4) == true);
+        assert(map->get(map, (void*)20001) == NULL);
+
+        YacUnorderedMapGetStats(map, &stats);
+        assert(stats.size == 20000);
+        assert(stats.num_rehash > 0);
+        assert(stats.num_get == 20001);
+        assert(stats.num_probe >= 20000);
+        assert(stats.avg_probe == (double)stats.num_probe / 20001);
+
+        unsigned num_bucket = 0;
+        unsigned k;
+        for (k = 0 ; k < YAC_UNORDERED_MAP_STATS_NUM_BUCKET ; ++k)
+            num_bucket += stats.histogram[k];
+        if (flags[j] & (YAC_UNORDERED_MAP_FLAT | YAC_UNORDERED_MAP_COMPACT))
+            assert(num_bucket == 20000 && stats.num_occupied == 20000);
+        else if (!(flags[j] & YAC_UNORDERED_MAP_INCREMENTAL_REHASH))
+            assert(num_bucket == stats.num_slot && stats.num_occupied <= 20000);
+
+        YacUnorderedMapResetStats(map);
+        YacUnorderedMapGetStats(map, &stats);
+        assert(stats.num_get == 0 && stats.num_rehash == 0);
+        YacUnorderedMapDeinit(map);
+    }
+
+    YacUnorderedMapDeinit(keys);
+}
+
+#endif // YAC_UNORDERED_MAP_STATS
+
+void test_clear_and_shrink(void)
+{
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_NODE_POOL,
+        YAC_UNORDERED_MAP_POWER_OF_TWO | YAC_UNORDERED_MAP_CACHE_HASH,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_READ_MOSTLY | YAC_UNORDERED_MAP_NODE_POOL,
+        YAC_UNORDERED_MAP_TREEIFY,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        YacUnorderedMapData* data = map->data;
+        unsigned num_slot_init = data->num_slot_;
+
+        // Some keys collide so that the treeified map clears its trees.
+        num_clean_value = 0;
+        map->set_clean_value(map, count_clean_value);
+        if (flags[j] & YAC_UNORDERED_MAP_TREEIFY)
+            map->set_hash(map, colliding_hash);
+        unsigned num_key = (flags[j] & YAC_UNORDERED_MAP_TREEIFY)? 100 : 20000;
+
+        // The incremental rehashing is still migrating when the map is cleared.
+        intptr_t i;
+        for (i = 1 ; i <= num_key ; ++i)
+            assert(map->put(map, (void*)i, (void*)i) == true);
+        YacUnorderedMapClear(map);
+        assert(map->size(map) == 0 && num_clean_value == (int)num_key);
+        assert(map->get(map, (void*)1) == NULL);
+        map->first(map);
+        assert(map->next(map) == NULL);
+        YacUnorderedMapIterator iter = YacUnorderedMapBegin(map);
+        assert(YacUnorderedMapIteratorNext(&iter) == NULL);
+
+        // Filling the cleared map again does not rehash.
+        unsigned num_slot = data->num_slot_;
+#ifdef YAC_UNORDERED_MAP_STATS
+        YacUnorderedMapStats stats;
+        YacUnorderedMapGetStats(map, &stats);
+        unsigned num_rehash = stats.num_rehash;
+#endif
+        for (i = 1 ; i <= num_key ; ++i)
+            assert(map->put(map, (void*)i, (void*)(i * 2)) == true);
+        assert(data->num_slot_ == num_slot);
+#ifdef YAC_UNORDERED_MAP_STATS
+        YacUnorderedMapGetStats(map, &stats);
+        assert(stats.num_rehash == num_rehash);
+#endif
+        assert(map->size(map) == num_key);
+
+        // Shrinking keeps the remaining pairs.
+        for (i = 1 ; i <= num_key ; ++i) {
+            if (i % 10 != 0)
+                assert(map->remove(map, (void*)i) == true);
+        }
+        assert(YacUnorderedMapShrinkToFit(map) == true);
+        assert(data->num_slot_ <= num_slot);
+        if (num_key > 10000)
+            assert(data->num_slot_ < num_slot);
+        for (i = 1 ; i <= num_key ; ++i)
+            assert(map->get(map, (void*)i) == ((i % 10 == 0)? (void*)(i * 2) : NULL));
+        assert(map->put(map, (void*)(intptr_t)(num_key + 1), (void*)1) == true);
+        assert(map->size(map) == num_key / 10 + 1);
+
+        // The empty map shrinks back to its initial size.
+        YacUnorderedMapClear(map);
+        assert(YacUnorderedMapShrinkToFit(map) == true);
+        assert(data->num_slot_ == num_slot_init && map->size(map) == 0);
+        for (i = 1 ; i <= num_key ; ++i)
+            assert(map->put(map, (void*)i, (void*)i) == true);
+        assert(map->size(map) == num_key && map->get(map, (void*)7) == (void*)7);
+        YacUnorderedMapDeinit(map);
+    }
+}
+
+size_t encode_int(void* item, void* buf, void* arg)
+{
+    int num = (int)(intptr_t)item;
+    if (buf)
+        memcpy(buf, &num, sizeof(num));
+    (void)arg;
+    return sizeof(num);
+}
+
+size_t encode_string(void* item, void* buf, void* arg)
+{
+    // The terminator is kept so that the values can be used as strings in place.
+    size_t size = strlen((char*)item) + (size_t)(intptr_t)arg;
+    if (buf)
+        memcpy(buf, item, size);
+    return size;
+}
+
+void test_snapshot(void)
+{
+    const char* path = "yac_unordered_map_test.snapshot";
+    unsigned flags[] = {
+        0,
+        YAC_UNORDERED_MAP_FLAT,
+        YAC_UNORDERED_MAP_COMPACT,
+        YAC_UNORDERED_MAP_CONCURRENT,
+        YAC_UNORDERED_MAP_SEEDED | YAC_UNORDERED_MAP_TREEIFY,
+    };
+
+    unsigned j;
+    for (j = 0 ; j < sizeof(flags) / sizeof(flags[0]) ; ++j) {
+        YacUnorderedMap* map = YacUnorderedMapInitWithFlags(flags[j]);
+        intptr_t i;
+        for (i = 1 ; i <= 30000 ; ++i)
+            map->put(map, (void*)i, (void*)(i * 3));
+        assert(YacUnorderedMapSave(map, path, encode_int, encode_int, NULL));
+        YacUnorderedMapDeinit(map);
+
+        // The view outlives the map.
+        YacUnorderedMapView* view = YacUnorderedMapViewInit(path);
+        assert(view != NULL);
+        assert(YacUnorderedMapViewSize(view) == 30000);
+        int key;
+        for (key = 0 ; key <= 30001 ; ++key) {
+            size_t size = 0;
+            const int* value = YacUnorderedMapViewGet(view, &key, sizeof(key), &size);
+            if (key == 0 || key == 30001) {
+                assert(value == NULL && !YacUnorderedMapViewContain(view, &key, sizeof(key)));
+                continue;
+            }
+            assert(value != NULL && size == sizeof(int) && *value == key * 3);
+            assert(((uintptr_t)value & 7) == 0);
+        }
+        short short_key = 7;
+        assert(!YacUnorderedMapViewContain(view, &short_key, sizeof(short_key)));
+        YacUnorderedMapViewDeinit(view);
+    }
+
+    {
+        // KEY = char*, VALUE = char* of varying lengths.
+        YacUnorderedMap* map = YacUnorderedMapInit();
+        map->set_compare(map, compare_key);
+        map->set_hash(map, YacUnorderedMapHashString);
+        map->put(map, "one", "1");
+        map->put(map, "two", "");
+        map->put(map, "three", "a longer value crossing the padding");
+        map->put(map, "", "empty key");
+        assert(YacUnorderedMapSave(map, path, encode_string, encode_string, (void*)(intptr_t)1));
+
+        YacUnorderedMapView* view = YacUnorderedMapViewInit(path);
+        assert(view != NULL && YacUnorderedMapViewSize(view) == 4);
+        size_t size;
+        const char* value = YacUnorderedMapViewGet(view, "three", sizeof("three"), &size);
+        assert(value && size == sizeof("a longer value crossing the padding"));
+        assert(strcmp(value, "a longer value crossing the padding") == 0);
+        assert(strcmp(YacUnorderedMapViewGet(view, "two", sizeof("two"), NULL), "") == 0);
+        assert(strcmp(YacUnorderedMapViewGet(view, "", 1, NULL), "empty key") == 0);
+        assert(!YacUnorderedMapViewContain(view, "three", strlen("three")));
+        assert(!YacUnorderedMapViewContain(view, "four", sizeof("four")));
+        YacUnorderedMapViewDeinit(view);
+
+        // The snapshot loaded by the caller is served from the buffer.
+        FILE* file = fopen(path, "rb");
+        assert(file != NULL);
+        uint64_t buf[64];
+        size_t size_file = fread(buf, 1, sizeof(buf), file);
+        fclose(file);
+        assert(size_file > 0 && size_file < sizeof(buf));
+
+        view = YacUnorderedMapViewInitWithBuffer(buf, size_file);
+        assert(view != NULL);
+        assert(strcmp(YacUnorderedMapViewGet(view, "one", sizeof("one"), NULL), "1") == 0);
+        YacUnorderedMapViewDeinit(view);
+
+        // Truncated, misaligned and corrupted snapshots are rejected.
+        assert(YacUnorderedMapViewInitWithBuffer(buf, size_file - 8) == NULL);
+        assert(YacUnorderedMapViewInitWithBuffer((char*)buf + 1, size_file - 1) == NULL);
+        ((char*)buf)[0] = 'X';
+        assert(YacUnorderedMapViewInitWithBuffer(buf, size_file) == NULL);
+
+        YacUnorderedMapDeinit(map);
+    }
+
+    {
+        // The empty map.
+        YacUnorderedMap* map = YacUnorderedMapInit();
+        assert(YacUnorderedMapSave(map, path, encode_int, encode_int, NULL));
+        YacUnorderedMapView* view = YacUnorderedMapViewInit(path);
+        assert(view != NULL && YacUnorderedMapViewSize(view) == 0);
+        int key = 1;
+        assert(!YacUnorderedMapViewContain(view, &key, sizeof(key)));
+        YacUnorderedMapViewDeinit(view);
+
+        remove(path);
+        assert(YacUnorderedMapViewInit(path) == NULL);
+        assert(!YacUnorderedMapSave(map, "no/such/directory/file", encode_int, encode_int, NULL));
+        YacUnorderedMapDeinit(map);
+    }
+}
+
 int main(void)
 {
     test_init_and_deinit();
@@ -212,8 +1502,30 @@ int main(void)
     test_contain();
     test_remove();
     test_iterator();
+    test_flat();
+    test_group_match();
+    test_incremental_rehash();
+    test_cache_hash();
+    test_power_of_two();
+    test_capacity_and_put_many();
+    test_node_pool();
+    test_typed_map();
+    test_hash_and_entry();
+    test_get_many();
+    test_external_iterator();
+    test_parallel_bulk();
+    test_concurrent();
+    test_read_mostly();
 
     test_hash_murmur32();
+    test_hash_suite();
+    test_seeded_and_treeify();
+#ifdef YAC_UNORDERED_MAP_STATS
+    test_stats();
+#endif
+    test_compact();
+    test_clear_and_shrink();
+    test_snapshot();
 
     return 0;
 }
@@ -38,6 +38,28 @@
 #endif // YAC_ORDERED_MAP_API
 
 
+// Flags for YacOrderedMapInitWithFlags.
+
+// Carve the tree nodes out of large chunks allocated with YAC_ORDERED_MAP_MALLOC
+// and recycle the removed nodes through a free list. The destructor releases
+// whole chunks instead of freeing every node.
+#define YAC_ORDERED_MAP_NODE_POOL (1u << 0)
+
+// Store the pairs in a B-tree instead of the red black tree. Every node holds up
+// to 2 * YAC_ORDERED_MAP_BTREE_DEGREE - 1 pairs, and packs their keys in an array
+// of its own, so a lookup binary searches a few adjacent cache lines per level
+// and follows one pointer per level instead of one per comparison.
+// The pairs move within and between the nodes as other pairs are inserted or
+// removed, so the pairs returned by the map are only valid until it is modified.
+// YAC_ORDERED_MAP_NODE_POOL is ignored with this flag.
+#define YAC_ORDERED_MAP_BTREE (1u << 1)
+
+// Keep the number of pairs under every node, which YacOrderedMapSelect and
+// YacOrderedMapRank need to answer in O(log n). The insertions and removals
+// update the counts along their paths.
+#define YAC_ORDERED_MAP_ORDER_STATISTIC (1u << 2)
+
+
 // The key value pair for associative data structures.
 typedef struct _YacOrderedMapPair {
     void* key;
@@ -118,6 +140,11 @@ typedef struct _YacOrderedMap {
 // The constructor for YacOrderedMap.
 YAC_ORDERED_MAP_API YacOrderedMap* YacOrderedMapInit(void);
 
+// The constructor for YacOrderedMap with the behavior selected by the
+// YAC_ORDERED_MAP_* flags.
+// YacOrderedMapInit is equivalent to YacOrderedMapInitWithFlags(0).
+YAC_ORDERED_MAP_API YacOrderedMap* YacOrderedMapInitWithFlags(unsigned flags);
+
 // The destructor for YacOrderedMap.
 YAC_ORDERED_MAP_API void YacOrderedMapDeinit(YacOrderedMap* obj);
 
@@ -127,6 +154,48 @@ YAC_ORDERED_MAP_API void YacOrderedMapDeinit(YacOrderedMap* obj);
 // Also, the cleanup functions are invoked for that replaced pair.
 YAC_ORDERED_MAP_API bool YacOrderedMapPut(YacOrderedMap* self, void* key, void* value);
 
+// Fill the empty map with the key value pairs of the array, whose keys must be
+// strictly increasing under the map comparison function.
+// This function builds the tree bottom up in O(n), without the descent and the
+// rebalancing of YacOrderedMapPut for every pair. The red black tree carves all
+// the nodes out of one allocation, which the node pool of the map owns from then
+// on as if the map were created with YAC_ORDERED_MAP_NODE_POOL. The flags of the
+// map stay as they are.
+// Return false and leave the map empty if the map is not empty, the keys are
+// out of order, or the allocation fails.
+YAC_ORDERED_MAP_API bool YacOrderedMapBuild(YacOrderedMap* self, const YacOrderedMapPair* pairs, unsigned num);
+
+// The following operations move the nodes between two maps created with the same
+// flags and comparison function. The red black tree restructures the trees by
+// their black heights along O(log n) nodes, but every map owns its dummy node and
+// node pool, so the smaller part is walked through to relink it to its new map,
+// or to copy it into the nodes of that map if either map pools its nodes. With n
+// and m the sizes of the two parts, the cost is therefore not O(log n) alone but
+// grows with the smaller part. The B-tree backend flattens both trees and
+// rebuilds the result with the bulk build in O(n + m).
+// They return false if the maps do not match or the allocation fails, and
+// leave both maps unchanged.
+
+// Move the key value pairs ordered not before the designated key, which needs
+// not be stored in the map, into the other map, which must be empty.
+// This takes O(log n + min(n, m)) for the red black tree, where n and m are the
+// sizes of the two parts, and O(n + m) for the B-tree.
+YAC_ORDERED_MAP_API bool YacOrderedMapSplit(YacOrderedMap* self, void* key, YacOrderedMap* other);
+
+// Move all the key value pairs of the other map into the map. All the keys of
+// one map must be ordered before all the keys of the other.
+// This takes O(log n + min(n, m)) for the red black tree, where n and m are the
+// sizes of the two maps, and O(n + m) for the B-tree.
+YAC_ORDERED_MAP_API bool YacOrderedMapJoin(YacOrderedMap* self, YacOrderedMap* other);
+
+// Move all the key value pairs of the other map into the map. If the other map
+// has a key equal to a stored one, its pair replaces the stored pair, and the
+// cleanup functions are invoked for the replaced pair like YacOrderedMapPut.
+// The red black tree splits the smaller map by the keys of the larger one in
+// O(m log(n / m + 1)), where m is the smaller size, on top of the O(m) move of
+// the smaller map. The B-tree takes O(n + m).
+YAC_ORDERED_MAP_API bool YacOrderedMapUnion(YacOrderedMap* self, YacOrderedMap* other);
+
 // Retrieve the value corresponding to the designated key.
 YAC_ORDERED_MAP_API void* YacOrderedMapGet(YacOrderedMap* self, void* key);
 
@@ -153,9 +222,41 @@ YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapPredecessor(YacOrderedMap* s
 // Retrieve the key value pair which is the successor of the given key.
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapSuccessor(YacOrderedMap* self, void* key);
 
+// Retrieve the key value pair with the minimum order not less than the given
+// key, which needs not be stored in the map.
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapLowerBound(YacOrderedMap* self, void* key);
+
+// Retrieve the key value pair with the minimum order greater than the given key,
+// which needs not be stored in the map.
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapUpperBound(YacOrderedMap* self, void* key);
+
+// Retrieve the key value pair with the maximum order not greater than the given
+// key, which needs not be stored in the map.
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapFloor(YacOrderedMap* self, void* key);
+
+// Retrieve the key value pair with the minimum order not less than the given
+// key, the counterpart of YacOrderedMapFloor. @see YacOrderedMapLowerBound.
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapCeiling(YacOrderedMap* self, void* key);
+
+// Retrieve the key value pair with the designated zero-based order, so that 0
+// selects the minimum. Return NULL if the order is not less than the size or
+// the map is not created with YAC_ORDERED_MAP_ORDER_STATISTIC.
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapSelect(YacOrderedMap* self, unsigned order);
+
+// Count the key value pairs ordered before the given key, which needs not be
+// stored in the map. If the key is stored, this is the order of its pair.
+// Return false if the map is not created with YAC_ORDERED_MAP_ORDER_STATISTIC.
+YAC_ORDERED_MAP_API bool YacOrderedMapRank(YacOrderedMap* self, void* key, unsigned* rank);
+
 // Initialize the map iterator.
 YAC_ORDERED_MAP_API void YacOrderedMapFirst(YacOrderedMap* self);
 
+// Initialize the map iterator to visit the key value pairs ordered in [lo, hi)
+// with YacOrderedMapNext. The iterator descends to the first pair once and then
+// walks in order, so the cost is O(log n) plus the number of visited pairs.
+// The keys need not be stored in the map.
+YAC_ORDERED_MAP_API void YacOrderedMapRange(YacOrderedMap* self, void* lo, void* hi);
+
 // Get the key value pair pointed by the iterator and advance the iterator.
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapNext(YacOrderedMap* self);
 
@@ -182,7 +283,14 @@ YAC_ORDERED_MAP_API void YacOrderedMapSetCleanValue(YacOrderedMap* self, YacOrde
 #ifdef YAC_ORDERED_MAP_IMPLEMENTATION
 
 
+#include <limits.h> // INT_MAX
+#include <stdint.h> // intptr_t, SIZE_MAX
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memmove
+
+#if defined(_MSC_VER)
+#include <intrin.h> // _mm_prefetch, __prefetch
+#endif
 
 #ifndef YAC_ORDERED_MAP_MALLOC
 #define YAC_ORDERED_MAP_MALLOC malloc
@@ -192,24 +300,85 @@ YAC_ORDERED_MAP_API void YacOrderedMapSetCleanValue(YacOrderedMap* self, YacOrde
 #define YAC_ORDERED_MAP_FREE free
 #endif
 
+// The number of nodes carved out of each node pool chunk.
+#ifndef YAC_ORDERED_MAP_POOL_CHUNK
+#define YAC_ORDERED_MAP_POOL_CHUNK 1024
+#endif
+
+// The minimum degree of the B-tree. Every node but the root holds between
+// DEGREE - 1 and 2 * DEGREE - 1 pairs.
+#ifndef YAC_ORDERED_MAP_BTREE_DEGREE
+#define YAC_ORDERED_MAP_BTREE_DEGREE 16
+#endif
+#if YAC_ORDERED_MAP_BTREE_DEGREE < 2
+#error "YAC_ORDERED_MAP_BTREE_DEGREE must be at least 2"
+#endif
+#define YAC_ORDERED_MAP_BTREE_MAX (2 * YAC_ORDERED_MAP_BTREE_DEGREE - 1)
+
+// The bound of the B-tree height for 2^31 pairs, which sizes the iterator path.
+#define YAC_ORDERED_MAP_BTREE_MAX_HEIGHT 32
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define YAC_ORDERED_MAP_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+#define YAC_ORDERED_MAP_PREFETCH(ptr) __prefetch((const void*)(ptr))
+#elif defined(__GNUC__)
+#define YAC_ORDERED_MAP_PREFETCH(ptr) __builtin_prefetch((ptr))
+#else
+#define YAC_ORDERED_MAP_PREFETCH(ptr) ((void)(ptr))
+#endif
+
 
 typedef struct _TreeNode {
     char color_;
+    unsigned count_;
     YacOrderedMapPair pair_;
     struct _TreeNode* parent_;
     struct _TreeNode* left_;
     struct _TreeNode* right_;
 } TreeNode;
 
+// The B-tree node. The keys are copied out of the pairs so that the binary
+// search scans a packed array, and only the internal nodes are allocated with
+// room for the children.
+typedef struct _BTreeNode {
+    unsigned num_;
+    unsigned total_;
+    bool leaf_;
+    void* key_[YAC_ORDERED_MAP_BTREE_MAX];
+    YacOrderedMapPair pair_[YAC_ORDERED_MAP_BTREE_MAX];
+    struct _BTreeNode* child_[];
+} BTreeNode;
+
 struct _YacOrderedMapData {
+    unsigned flags_;
     char iter_direct_;
     int size_;
     TreeNode* root_;
     TreeNode* null_;
     TreeNode* iter_node_;
+    bool iter_range_;
+    void* iter_hi_;
     YacOrderedMapCompare func_cmp_;
     YacOrderedMapCleanKey func_clean_key_;
     YacOrderedMapCleanValue func_clean_val_;
+
+    // The node pool. Each chunk starts with the link to the previous chunk,
+    // and pool_used_ nodes of the newest chunk are handed out. Recycled nodes
+    // are linked through their first word. The pool is in use if the flags ask
+    // for it or the bulk build has handed it the nodes.
+    bool pooled_;
+    void* pool_chunk_;
+    void* pool_free_;
+    unsigned pool_used_;
+
+    // The B-tree. The iterator keeps the path from the root to the current node
+    // with the position of the next pair to visit in each node, and a negative
+    // depth until the first step picks the direction.
+    BTreeNode* btree_root_;
+    int iter_depth_;
+    BTreeNode* iter_path_[YAC_ORDERED_MAP_BTREE_MAX_HEIGHT];
+    unsigned iter_idx_[YAC_ORDERED_MAP_BTREE_MAX_HEIGHT];
 };
 
 
@@ -251,9 +420,160 @@ static void YacOrderedMapDeleteFixup_(YacOrderedMapData* data, TreeNode* curr);
 // Get the node which stores the key having the same order with the designated one.
 static TreeNode* YacOrderedMapSearch_(YacOrderedMapData* data, void* key);
 
+// Get the node with the nearest order after (or before) the designated key, which
+// may be equal to the key if inclusive is set.
+static TreeNode* YacOrderedMapBound_(YacOrderedMapData* data, void* key, bool after, bool inclusive);
+
+// Advance the red black tree iterator.
+static YacOrderedMapPair* YacOrderedMapNext_(YacOrderedMapData* data);
+
+// Add the difference to the pair counts from the node up to the root.
+static void YacOrderedMapRecount_(TreeNode* null, TreeNode* curr, int diff);
+
+// Link the array of nodes holding the sorted pairs into a balanced subtree and
+// return its root. The nodes at the designated depth are colored red.
+static TreeNode* YacOrderedMapBuild_(TreeNode* null, TreeNode* nodes, unsigned num, unsigned depth, unsigned red);
+
+// Tell whether the nodes can move between the maps, which needs the same
+// backend, pair counts, and comparison function.
+static bool YacOrderedMapAlike_(YacOrderedMapData* data, YacOrderedMapData* other);
+
+// Return the number of the black nodes on the paths from the subtree root down
+// to the dummy node. The heights passed among the join and split operations
+// count the subtree root as black, since they blacken it anyway.
+static int YacOrderedMapBlackHeight_(TreeNode* null, TreeNode* curr);
+
+// Join the subtrees, whose keys are ordered before and after the key of the
+// middle node, through the middle node, and return the root of the result.
+static TreeNode* YacOrderedMapJoin_(YacOrderedMapData* data, TreeNode* left, int height_left, TreeNode* mid, TreeNode* right, int height_right, int* height);
+
+// Join the subtrees, whose keys are ordered one before the other, through the
+// minimal node of the right one.
+static TreeNode* YacOrderedMapJoin2_(YacOrderedMapData* data, TreeNode* left, int height_left, TreeNode* right, int height_right, int* height);
+
+// Split the subtree into the nodes ordered before and after the designated key,
+// and return the node storing the key, or the dummy node if it is absent.
+static TreeNode* YacOrderedMapSplit_(YacOrderedMapData* data, TreeNode* curr, int height, void* key, TreeNode** left, int* height_left, TreeNode** right, int* height_right);
+
+// Merge the other subtree into the base one and return the root of the result.
+// For the equal keys, the pair of the base subtree stays if designated, and the
+// replaced pair is cleaned.
+static TreeNode* YacOrderedMapUnion_(YacOrderedMapData* data, TreeNode* base, int height_base, TreeNode* other, int height_other, bool keep_base, unsigned* num_dup, int* height);
+
+// Count the nodes of the left subtree, walking both subtrees in step unless
+// the pair counts are kept, so that only the smaller one is walked through.
+static unsigned YacOrderedMapMeasure_(YacOrderedMapData* data, TreeNode* left, TreeNode* right, unsigned total);
+
+// Point the leaves of the subtree at the new dummy node and return its root.
+// If the spare nodes linked through their first word are given, the subtree is
+// copied into them and the old nodes are returned to the source map.
+static TreeNode* YacOrderedMapRehome_(YacOrderedMapData* src, TreeNode* old_null, TreeNode* new_null, TreeNode* curr, TreeNode* parent, void** spare);
+
+// Move the tree of the smaller map to the larger one, whose dummy node and node
+// pool the map then owns, and output the former roots of both maps. The other
+// map is left without a tree.
+static bool YacOrderedMapGather_(YacOrderedMapData* data, YacOrderedMapData* other, TreeNode** root_self, TreeNode** root_other);
+
 // The default hash key comparison function.
 static int YacOrderedMapCompare_(void* lhs, void* rhs);
 
+// Allocate a tree node from the node pool or the allocator.
+static TreeNode* YacOrderedMapNodeAlloc_(YacOrderedMapData* data);
+
+// Return the tree node to the node pool or the allocator.
+static void YacOrderedMapNodeFree_(YacOrderedMapData* data, TreeNode* node);
+
+// Release all the chunks of the node pool.
+static void YacOrderedMapPoolRelease_(YacOrderedMapData* data);
+
+// Hand the separately allocated chunk of nodes to the node pool.
+static void YacOrderedMapPoolAdopt_(YacOrderedMapData* data, void** chunk);
+
+// Allocate the designated number of nodes up front and link them through their
+// first word, so that copying a subtree cannot fail halfway.
+static bool YacOrderedMapPoolTake_(YacOrderedMapData* data, unsigned num, void** list);
+
+// Exchange the node pools of the maps.
+static void YacOrderedMapPoolSwap_(YacOrderedMapData* data, YacOrderedMapData* other);
+
+// Allocate a B-tree node without pairs.
+static BTreeNode* YacOrderedMapBTreeAlloc_(bool leaf);
+
+// Clean the pairs of the subtree and release its nodes.
+static void YacOrderedMapBTreeRelease_(YacOrderedMapData* data, BTreeNode* node);
+
+// Return the position of the first key of the node not less than the designated
+// one, and tell whether it is equal.
+static unsigned YacOrderedMapBTreeFind_(YacOrderedMapCompare func_cmp, BTreeNode* node, void* key, bool* found);
+
+// Return the pair storing the designated key, or NULL if it is absent.
+static YacOrderedMapPair* YacOrderedMapBTreeSearch_(YacOrderedMapData* data, void* key);
+
+// Move the designated number of keys and pairs between or within the nodes.
+static void YacOrderedMapBTreeMove_(BTreeNode* dst, unsigned idx_dst, BTreeNode* src, unsigned idx_src, unsigned count);
+
+// Split the full child at the designated position into two, moving its median
+// pair up to the node. Return false if the new node cannot be allocated.
+static bool YacOrderedMapBTreeSplit_(BTreeNode* node, unsigned idx);
+
+// Merge the child after the designated position and the pair separating them
+// into the child at the position, and return the merged child. The root is
+// replaced when its last pair moves down.
+static BTreeNode* YacOrderedMapBTreeMerge_(YacOrderedMapData* data, BTreeNode* node, unsigned idx);
+
+// Rotate a pair from the left or the right sibling through the node into the
+// child at the designated position.
+static void YacOrderedMapBTreeBorrowLeft_(BTreeNode* node, unsigned idx);
+static void YacOrderedMapBTreeBorrowRight_(BTreeNode* node, unsigned idx);
+
+// The B-tree counterparts of the exported member operations.
+static bool YacOrderedMapBTreePut_(YacOrderedMapData* data, void* key, void* value);
+static bool YacOrderedMapBTreeRemove_(YacOrderedMapData* data, void* key);
+
+// Return the pair right after or before the designated key, or NULL if the key
+// is absent or has no such neighbor.
+static YacOrderedMapPair* YacOrderedMapBTreeNeighbor_(YacOrderedMapData* data, void* key, bool succ);
+
+// Push the path from the node down to its minimal or maximal pair onto the iterator.
+static void YacOrderedMapBTreePush_(YacOrderedMapData* data, BTreeNode* node, bool reverse);
+
+// Advance the iterator in the designated direction.
+static YacOrderedMapPair* YacOrderedMapBTreeNext_(YacOrderedMapData* data, bool reverse);
+
+// The B-tree counterpart of YacOrderedMapBound_.
+static YacOrderedMapPair* YacOrderedMapBTreeBound_(YacOrderedMapData* data, void* key, bool after, bool inclusive);
+
+// Position the forward iterator at the first pair not less than the designated key.
+static void YacOrderedMapBTreeSeek_(YacOrderedMapData* data, void* key);
+
+// Return the number of the pairs under the node child at the designated position,
+// which is zero for the leaves.
+static unsigned YacOrderedMapBTreeBelow_(BTreeNode* node, unsigned idx);
+
+// Build a subtree of the designated height over the sorted pairs, and share the
+// pairs evenly so that every node but the root is at least half full. The
+// capacities of the subtrees are given by height. Return NULL if the allocation fails.
+static BTreeNode* YacOrderedMapBTreeBuild_(const YacOrderedMapPair* pairs, unsigned num, unsigned height, const uint64_t* cap, bool root);
+
+// Release the nodes of the subtree without cleaning its pairs.
+static void YacOrderedMapBTreeDrop_(BTreeNode* node);
+
+// Build the whole tree over the sorted pairs, which is NULL for no pairs.
+// Return false if the allocation fails.
+static bool YacOrderedMapBTreeBuildAll_(const YacOrderedMapPair* pairs, unsigned num, BTreeNode** root);
+
+// Copy the pairs of the subtree in order to the array, and return the end of the copies.
+static YacOrderedMapPair* YacOrderedMapBTreeFlatten_(BTreeNode* node, YacOrderedMapPair* out);
+
+// The B-tree counterparts of YacOrderedMapSplit and YacOrderedMapUnion, which
+// also joins the maps whose key ranges are checked.
+static bool YacOrderedMapBTreeSplit2_(YacOrderedMapData* data, YacOrderedMapData* other, void* key);
+static bool YacOrderedMapBTreeUnion_(YacOrderedMapData* data, YacOrderedMapData* other);
+
+// The B-tree counterparts of YacOrderedMapSelect and YacOrderedMapRank.
+static YacOrderedMapPair* YacOrderedMapBTreeSelect_(YacOrderedMapData* data, unsigned order);
+static unsigned YacOrderedMapBTreeRank_(YacOrderedMapData* data, void* key);
+
 
 #define YAC_DIRECT_LEFT 0
 #define YAC_DIRECT_RIGHT 1
@@ -271,6 +591,11 @@ static int YacOrderedMapCompare_(void* lhs, void* rhs);
 //
 
 YAC_ORDERED_MAP_API YacOrderedMap* YacOrderedMapInit(void)
+{
+    return YacOrderedMapInitWithFlags(0);
+}
+
+YAC_ORDERED_MAP_API YacOrderedMap* YacOrderedMapInitWithFlags(unsigned flags)
 {
     YacOrderedMap* obj = YAC_ORDERED_MAP_MALLOC (sizeof(YacOrderedMap));
     if (!obj)
@@ -291,17 +616,30 @@ YAC_ORDERED_MAP_API YacOrderedMap* YacOrderedMapInit(void)
     }
 
     null->color_ = YAC_COLOR_BLACK;
+    null->count_ = 0;
     null->parent_ = NULL;
     null->parent_ = null;
     null->right_ = null;
     null->left_ = null;
 
+    if (flags & YAC_ORDERED_MAP_BTREE)
+        flags &= ~YAC_ORDERED_MAP_NODE_POOL;
+
+    data->flags_ = flags;
     data->size_ = 0;
     data->null_ = null;
     data->root_ = null;
     data->func_cmp_ = YacOrderedMapCompare_;
     data->func_clean_key_ = NULL;
     data->func_clean_val_ = NULL;
+    data->pooled_ = (flags & YAC_ORDERED_MAP_NODE_POOL) != 0;
+    data->pool_chunk_ = NULL;
+    data->pool_free_ = NULL;
+    data->pool_used_ = 0;
+    data->btree_root_ = NULL;
+    data->iter_depth_ = 0;
+    data->iter_node_ = null;
+    data->iter_range_ = false;
 
     obj->data = data;
     obj->put = YacOrderedMapPut;
@@ -329,7 +667,10 @@ YAC_ORDERED_MAP_API void YacOrderedMapDeinit(YacOrderedMap* obj)
         return;
 
     YacOrderedMapData* data = obj->data;
+    if (data->btree_root_)
+        YacOrderedMapBTreeRelease_(data, data->btree_root_);
     YacOrderedMapDeinit_(data);
+    YacOrderedMapPoolRelease_(data);
     YAC_ORDERED_MAP_FREE(data->null_);
     YAC_ORDERED_MAP_FREE(data);
     YAC_ORDERED_MAP_FREE(obj);
@@ -338,15 +679,19 @@ YAC_ORDERED_MAP_API void YacOrderedMapDeinit(YacOrderedMap* obj)
 
 YAC_ORDERED_MAP_API bool YacOrderedMapPut(YacOrderedMap* self, void* key, void* value)
 {
-    TreeNode* node = YAC_ORDERED_MAP_MALLOC(sizeof(TreeNode));
+    YacOrderedMapData* data = self->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreePut_(data, key, value);
+
+    TreeNode* node = YacOrderedMapNodeAlloc_(data);
     if (!node)
         return false;
 
-    YacOrderedMapData* data = self->data;
     TreeNode* null = data->null_;
     node->pair_.key = key;
     node->pair_.value = value;
     node->color_ = YAC_COLOR_RED;
+    node->count_ = 1;
     node->parent_ = null;
     node->left_ = null;
     node->right_ = null;
@@ -368,7 +713,7 @@ YAC_ORDERED_MAP_API bool YacOrderedMapPut(YacOrderedMap* self, void* key, void*
         }
         else {
             // Conflict with the already stored key value pair.
-            YAC_ORDERED_MAP_FREE(node);
+            YacOrderedMapNodeFree_(data, node);
             if (data->func_clean_key_)
                 data->func_clean_key_(curr->pair_.key);
             if (data->func_clean_val_)
@@ -391,6 +736,8 @@ YAC_ORDERED_MAP_API bool YacOrderedMapPut(YacOrderedMap* self, void* key, void*
         data->root_ = node;
 
     data->size_++;
+    if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC)
+        YacOrderedMapRecount_(null, parent, 1);
 
     // Maintain the red black tree structure.
     YacOrderedMapInsertFixup_(data, node);
@@ -398,8 +745,204 @@ YAC_ORDERED_MAP_API bool YacOrderedMapPut(YacOrderedMap* self, void* key, void*
     return true;
 }
 
+YAC_ORDERED_MAP_API bool YacOrderedMapBuild(YacOrderedMap* self, const YacOrderedMapPair* pairs, unsigned num)
+{
+    YacOrderedMapData* data = self->data;
+    if (data->size_ != 0 || num > (unsigned)INT_MAX)
+        return false;
+
+    unsigned i;
+    for (i = 1 ; i < num ; ++i) {
+        if (data->func_cmp_(pairs[i - 1].key, pairs[i].key) >= 0)
+            return false;
+    }
+    if (num == 0)
+        return true;
+
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        if (!YacOrderedMapBTreeBuildAll_(pairs, num, &(data->btree_root_)))
+            return false;
+        data->size_ = (int)num;
+        return true;
+    }
+
+    // The byte count wraps for the large counts if size_t is 32-bit.
+    size_t size = sizeof(TreeNode) * (size_t)num;
+    if (size / sizeof(TreeNode) != num || size > SIZE_MAX - sizeof(void*))
+        return false;
+    void** chunk = YAC_ORDERED_MAP_MALLOC(sizeof(void*) + size);
+    if (!chunk)
+        return false;
+
+    TreeNode* nodes = (TreeNode*)((char*)chunk + sizeof(void*));
+    for (i = 0 ; i < num ; ++i)
+        nodes[i].pair_ = pairs[i];
+
+    // Only the deepest level of the balanced tree may be incomplete, so coloring
+    // it red leaves the same number of black nodes on every path.
+    unsigned deepest = 0;
+    while ((2u << deepest) <= num)
+        ++deepest;
+
+    TreeNode* null = data->null_;
+    TreeNode* root = YacOrderedMapBuild_(null, nodes, num, 0, (deepest > 0)? deepest : UINT_MAX);
+    root->parent_ = null;
+    data->root_ = root;
+    data->size_ = (int)num;
+
+    data->pooled_ = true;
+    YacOrderedMapPoolAdopt_(data, chunk);
+    return true;
+}
+
+YAC_ORDERED_MAP_API bool YacOrderedMapSplit(YacOrderedMap* self, void* key, YacOrderedMap* other)
+{
+    YacOrderedMapData* data = self->data;
+    YacOrderedMapData* dest = other->data;
+    if (self == other || dest->size_ != 0 || !YacOrderedMapAlike_(data, dest))
+        return false;
+    if (data->size_ == 0)
+        return true;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeSplit2_(data, dest, key);
+
+    TreeNode* null = data->null_;
+    TreeNode* left;
+    TreeNode* right;
+    int height_left;
+    int height_right;
+    int height = YacOrderedMapBlackHeight_(null, data->root_);
+    TreeNode* same = YacOrderedMapSplit_(data, data->root_, height, key, &left, &height_left, &right, &height_right);
+    if (same != null)
+        right = YacOrderedMapJoin_(data, null, 0, same, right, height_right, &height_right);
+
+    unsigned total = (unsigned)data->size_;
+    unsigned num_left = YacOrderedMapMeasure_(data, left, right, total);
+    unsigned num_right = total - num_left;
+    bool move_left = num_left < num_right;
+    unsigned num_small = (move_left)? num_left : num_right;
+
+    // If either map pools its nodes, the smaller part is copied into the nodes
+    // of the other map, which come from its recycled nodes first.
+    bool copy = data->pooled_ || dest->pooled_;
+    void* spare = NULL;
+    if (copy && !YacOrderedMapPoolTake_(dest, num_small, &spare)) {
+        data->root_ = YacOrderedMapJoin2_(data, left, height_left, right, height_right, &height);
+        return false;
+    }
+
+    // The larger part keeps the dummy node and the node pool, which go along to
+    // the other map if the larger part does.
+    if (move_left) {
+        TreeNode* temp = data->null_;
+        data->null_ = dest->null_;
+        dest->null_ = temp;
+        YacOrderedMapPoolSwap_(data, dest);
+        left = YacOrderedMapRehome_(dest, dest->null_, data->null_, left, data->null_, (copy)? &spare : NULL);
+    } else
+        right = YacOrderedMapRehome_(data, data->null_, dest->null_, right, dest->null_, (copy)? &spare : NULL);
+
+    data->root_ = left;
+    data->size_ = (int)num_left;
+    data->iter_node_ = data->null_;
+    dest->root_ = right;
+    dest->size_ = (int)num_right;
+    dest->iter_node_ = dest->null_;
+    return true;
+}
+
+YAC_ORDERED_MAP_API bool YacOrderedMapJoin(YacOrderedMap* self, YacOrderedMap* other)
+{
+    YacOrderedMapData* data = self->data;
+    YacOrderedMapData* src = other->data;
+    if (self == other || !YacOrderedMapAlike_(data, src))
+        return false;
+    if ((unsigned)data->size_ + (unsigned)src->size_ > (unsigned)INT_MAX)
+        return false;
+    if (src->size_ == 0)
+        return true;
+
+    // Check which map holds the keys ordered first.
+    bool after = true;
+    if (data->size_ > 0) {
+        YacOrderedMapCompare func_cmp = data->func_cmp_;
+        if (func_cmp(YacOrderedMapMaximum(self)->key, YacOrderedMapMinimum(other)->key) < 0)
+            after = true;
+        else if (func_cmp(YacOrderedMapMaximum(other)->key, YacOrderedMapMinimum(self)->key) < 0)
+            after = false;
+        else
+            return false;
+    }
+
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeUnion_(data, src);
+
+    TreeNode* root_self;
+    TreeNode* root_other;
+    if (!YacOrderedMapGather_(data, src, &root_self, &root_other))
+        return false;
+
+    TreeNode* null = data->null_;
+    int height_self = YacOrderedMapBlackHeight_(null, root_self);
+    int height_other = YacOrderedMapBlackHeight_(null, root_other);
+    int height;
+    if (after)
+        data->root_ = YacOrderedMapJoin2_(data, root_self, height_self, root_other, height_other, &height);
+    else
+        data->root_ = YacOrderedMapJoin2_(data, root_other, height_other, root_self, height_self, &height);
+
+    data->size_ += src->size_;
+    data->iter_node_ = data->null_;
+    src->size_ = 0;
+    return true;
+}
+
+YAC_ORDERED_MAP_API bool YacOrderedMapUnion(YacOrderedMap* self, YacOrderedMap* other)
+{
+    YacOrderedMapData* data = self->data;
+    YacOrderedMapData* src = other->data;
+    if (self == other || !YacOrderedMapAlike_(data, src))
+        return false;
+    if ((unsigned)data->size_ + (unsigned)src->size_ > (unsigned)INT_MAX)
+        return false;
+    if (src->size_ == 0)
+        return true;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeUnion_(data, src);
+
+    TreeNode* root_self;
+    TreeNode* root_other;
+    if (!YacOrderedMapGather_(data, src, &root_self, &root_other))
+        return false;
+
+    // The smaller tree is split by the keys of the larger tree, whose untouched
+    // subtrees are then linked back as they are.
+    bool keep_base = src->size_ > data->size_;
+    TreeNode* base = (keep_base)? root_other : root_self;
+    TreeNode* rest = (keep_base)? root_self : root_other;
+
+    unsigned num_dup = 0;
+    int height_base = YacOrderedMapBlackHeight_(data->null_, base);
+    int height_rest = YacOrderedMapBlackHeight_(data->null_, rest);
+    int height;
+    TreeNode* root = YacOrderedMapUnion_(data, base, height_base, rest, height_rest, keep_base, &num_dup, &height);
+    root->parent_ = data->null_;
+    root->color_ = YAC_COLOR_BLACK;
+
+    data->root_ = root;
+    data->size_ += src->size_ - (int)num_dup;
+    data->iter_node_ = data->null_;
+    src->size_ = 0;
+    return true;
+}
+
 YAC_ORDERED_MAP_API void* YacOrderedMapGet(YacOrderedMap* self, void* key)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        YacOrderedMapPair* pair = YacOrderedMapBTreeSearch_(self->data, key);
+        return (pair)? pair->value : NULL;
+    }
+
     TreeNode* node = YacOrderedMapSearch_(self->data, key);
     if (node != self->data->null_)
         return node->pair_.value;
@@ -408,6 +951,9 @@ YAC_ORDERED_MAP_API void* YacOrderedMapGet(YacOrderedMap* self, void* key)
 
 YAC_ORDERED_MAP_API bool YacOrderedMapFind(YacOrderedMap* self, void* key)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeSearch_(self->data, key) != NULL;
+
     TreeNode* node = YacOrderedMapSearch_(self->data, key);
     return (node != self->data->null_)? true : false;
 }
@@ -415,11 +961,23 @@ YAC_ORDERED_MAP_API bool YacOrderedMapFind(YacOrderedMap* self, void* key)
 YAC_ORDERED_MAP_API bool YacOrderedMapRemove(YacOrderedMap* self, void* key)
 {
     YacOrderedMapData* data = self->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeRemove_(data, key);
+
     TreeNode* null = data->null_;
     TreeNode* curr = YacOrderedMapSearch_(data, key);
     if (curr == null)
         return false;
 
+    // The node with two children is replaced by its successor, which is the one
+    // leaving the tree.
+    if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) {
+        TreeNode* gone = curr;
+        if ((curr->left_ != null) && (curr->right_ != null))
+            gone = YacOrderedMapSuccessor_(null, curr);
+        YacOrderedMapRecount_(null, gone->parent_, -1);
+    }
+
     TreeNode* child;
     char color;
     // The specified node has no child.
@@ -439,7 +997,7 @@ YAC_ORDERED_MAP_API bool YacOrderedMapRemove(YacOrderedMap* self, void* key)
             data->func_clean_key_(curr->pair_.key);
         if (data->func_clean_val_)
             data->func_clean_val_(curr->pair_.value);
-        YAC_ORDERED_MAP_FREE(curr);
+        YacOrderedMapNodeFree_(data, curr);
     } else {
         // The specified node has two children.
         if ((curr->left_ != null) && (curr->right_ != null)) {
@@ -463,7 +1021,7 @@ YAC_ORDERED_MAP_API bool YacOrderedMapRemove(YacOrderedMap* self, void* key)
                 data->func_clean_val_(curr->pair_.value);
             curr->pair_.key = succ->pair_.key;
             curr->pair_.value = succ->pair_.value;
-            YAC_ORDERED_MAP_FREE(succ);
+            YacOrderedMapNodeFree_(data, succ);
         }
         // The specified node has one child.
         else {
@@ -486,7 +1044,7 @@ YAC_ORDERED_MAP_API bool YacOrderedMapRemove(YacOrderedMap* self, void* key)
                 data->func_clean_key_(curr->pair_.key);
             if (data->func_clean_val_)
                 data->func_clean_val_(curr->pair_.value);
-            YAC_ORDERED_MAP_FREE(curr);
+            YacOrderedMapNodeFree_(data, curr);
         }
     }
 
@@ -507,6 +1065,15 @@ YAC_ORDERED_MAP_API unsigned YacOrderedMapSize(YacOrderedMap* self)
 
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapMinimum(YacOrderedMap* self)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        BTreeNode* node = self->data->btree_root_;
+        if (!node)
+            return NULL;
+        while (!node->leaf_)
+            node = node->child_[0];
+        return &(node->pair_[0]);
+    }
+
     TreeNode* node = YacOrderedMapMinimal_(self->data->null_, self->data->root_);
     if (node != self->data->null_)
         return &(node->pair_);
@@ -515,6 +1082,15 @@ YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapMinimum(YacOrderedMap* self)
 
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapMaximum(YacOrderedMap* self)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        BTreeNode* node = self->data->btree_root_;
+        if (!node)
+            return NULL;
+        while (!node->leaf_)
+            node = node->child_[node->num_];
+        return &(node->pair_[node->num_ - 1]);
+    }
+
     TreeNode* node = YacOrderedMapMaximal_(self->data->null_, self->data->root_);
     if (node != self->data->null_)
         return &(node->pair_);
@@ -523,6 +1099,9 @@ YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapMaximum(YacOrderedMap* self)
 
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapPredecessor(YacOrderedMap* self, void* key)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeNeighbor_(self->data, key, false);
+
     TreeNode* curr = YacOrderedMapSearch_(self->data, key);
     if (curr == self->data->null_)
         return NULL;
@@ -536,6 +1115,9 @@ YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapPredecessor(YacOrderedMap* s
 
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapSuccessor(YacOrderedMap* self, void* key)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeNeighbor_(self->data, key, true);
+
     TreeNode* curr = YacOrderedMapSearch_(self->data, key);
     if (curr == self->data->null_)
         return NULL;
@@ -547,81 +1129,138 @@ YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapSuccessor(YacOrderedMap* sel
     return NULL;
 }
 
-YAC_ORDERED_MAP_API void YacOrderedMapFirst(YacOrderedMap* self)
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapLowerBound(YacOrderedMap* self, void* key)
 {
-    self->data->iter_direct_ = YAC_DOWN_LEFT;
-    self->data->iter_node_ = self->data->root_;
+    YacOrderedMapData* data = self->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeBound_(data, key, true, true);
+
+    TreeNode* node = YacOrderedMapBound_(data, key, true, true);
+    return (node != data->null_)? &(node->pair_) : NULL;
 }
 
-YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapNext(YacOrderedMap* self)
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapUpperBound(YacOrderedMap* self, void* key)
 {
-    char direct = self->data->iter_direct_;
-    TreeNode* null = self->data->null_;
-    TreeNode* curr = self->data->iter_node_;
+    YacOrderedMapData* data = self->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeBound_(data, key, true, false);
 
-    while (curr != null) {
-        if (direct == YAC_DOWN_LEFT || direct == YAC_DOWN_RIGHT) {
-            if (curr->left_ != null) {
-                curr = curr->left_;
-                direct = YAC_DOWN_LEFT;
-                continue;
-            }
+    TreeNode* node = YacOrderedMapBound_(data, key, true, false);
+    return (node != data->null_)? &(node->pair_) : NULL;
+}
 
-            YacOrderedMapPair* pair = &(curr->pair_);
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapFloor(YacOrderedMap* self, void* key)
+{
+    YacOrderedMapData* data = self->data;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeBound_(data, key, false, true);
 
-            if (curr->right_ != null) {
-                self->data->iter_node_ = curr->right_;
-                self->data->iter_direct_ = YAC_DOWN_RIGHT;
-            } else {
-                TreeNode* temp = curr;
-                curr = curr->parent_;
-                self->data->iter_node_ = curr;
-                if (curr != null) {
-                    if (temp == curr->left_)
-                        self->data->iter_direct_ = YAC_UP_LEFT;
-                    else
-                        self->data->iter_direct_ = YAC_UP_RIGHT;
-                }
-            }
-            return pair;
-        }
+    TreeNode* node = YacOrderedMapBound_(data, key, false, true);
+    return (node != data->null_)? &(node->pair_) : NULL;
+}
 
-        if (direct == YAC_UP_LEFT) {
-            YacOrderedMapPair* pair = &(curr->pair_);
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapCeiling(YacOrderedMap* self, void* key)
+{
+    return YacOrderedMapLowerBound(self, key);
+}
 
-            if (curr->right_ != null) {
-                self->data->iter_node_ = curr->right_;
-                self->data->iter_direct_ = YAC_DOWN_RIGHT;
-            } else {
-                TreeNode* temp = curr;
-                curr = curr->parent_;
-                self->data->iter_node_ = curr;
-                if (curr != null) {
-                    if (temp == curr->left_)
-                        self->data->iter_direct_ = YAC_UP_LEFT;
-                    else
-                        self->data->iter_direct_ = YAC_UP_RIGHT;
-                }
-            }
-            return pair;
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapSelect(YacOrderedMap* self, unsigned order)
+{
+    YacOrderedMapData* data = self->data;
+    if (!(data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) || order >= (unsigned)data->size_)
+        return NULL;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeSelect_(data, order);
+
+    TreeNode* curr = data->root_;
+    while (true) {
+        unsigned left = curr->left_->count_;
+        if (order == left)
+            return &(curr->pair_);
+        if (order < left)
+            curr = curr->left_;
+        else {
+            order -= left + 1;
+            curr = curr->right_;
         }
+    }
+}
 
-        TreeNode* temp = curr;
-        curr = curr->parent_;
-        if (curr != null) {
-            if (temp == curr->left_)
-                direct = YAC_UP_LEFT;
-            else
-                direct = YAC_UP_RIGHT;
+YAC_ORDERED_MAP_API bool YacOrderedMapRank(YacOrderedMap* self, void* key, unsigned* rank)
+{
+    YacOrderedMapData* data = self->data;
+    if (!(data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC))
+        return false;
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        *rank = YacOrderedMapBTreeRank_(data, key);
+        return true;
+    }
+
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    TreeNode* null = data->null_;
+    TreeNode* curr = data->root_;
+    unsigned count = 0;
+    while (curr != null) {
+        int order = func_cmp(key, curr->pair_.key);
+        if (order > 0) {
+            count += curr->left_->count_ + 1;
+            curr = curr->right_;
+        } else if (order < 0)
+            curr = curr->left_;
+        else {
+            count += curr->left_->count_;
+            break;
         }
     }
 
-    self->data->iter_node_ = null;
-    return NULL;
+    *rank = count;
+    return true;
+}
+
+YAC_ORDERED_MAP_API void YacOrderedMapFirst(YacOrderedMap* self)
+{
+    self->data->iter_depth_ = -1;
+    self->data->iter_range_ = false;
+    self->data->iter_direct_ = YAC_DOWN_LEFT;
+    self->data->iter_node_ = self->data->root_;
+}
+
+YAC_ORDERED_MAP_API void YacOrderedMapRange(YacOrderedMap* self, void* lo, void* hi)
+{
+    YacOrderedMapData* data = self->data;
+    data->iter_range_ = true;
+    data->iter_hi_ = hi;
+
+    if (data->flags_ & YAC_ORDERED_MAP_BTREE) {
+        YacOrderedMapBTreeSeek_(data, lo);
+        return;
+    }
+
+    // Coming up from the left child, the iterator visits the node itself next.
+    data->iter_node_ = YacOrderedMapBound_(data, lo, true, true);
+    data->iter_direct_ = YAC_UP_LEFT;
+}
+
+YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapNext(YacOrderedMap* self)
+{
+    YacOrderedMapData* data = self->data;
+    YacOrderedMapPair* pair = (data->flags_ & YAC_ORDERED_MAP_BTREE)?
+        YacOrderedMapBTreeNext_(data, false) : YacOrderedMapNext_(data);
+
+    // Stop the range at the first pair not less than its upper end.
+    if (pair && data->iter_range_ && data->func_cmp_(pair->key, data->iter_hi_) >= 0) {
+        data->iter_node_ = data->null_;
+        data->iter_depth_ = 0;
+        return NULL;
+    }
+    return pair;
 }
 
 YAC_ORDERED_MAP_API YacOrderedMapPair* YacOrderedMapReverseNext(YacOrderedMap* self)
 {
+    if (self->data->flags_ & YAC_ORDERED_MAP_BTREE)
+        return YacOrderedMapBTreeNext_(self->data, true);
+
     char direct = self->data->iter_direct_;
     TreeNode* null = self->data->null_;
     TreeNode* curr = self->data->iter_node_;
@@ -716,6 +1355,11 @@ static void YacOrderedMapDeinit_(YacOrderedMapData* data)
     YacOrderedMapCleanKey func_clean_key = data->func_clean_key_;
     YacOrderedMapCleanValue func_clean_val = data->func_clean_val_;
 
+    // Pooled nodes are released together with their chunks, so the tree is
+    // only walked if there are cleanup functions to call.
+    if (data->pooled_ && !func_clean_key && !func_clean_val)
+        return;
+
     char direct = YAC_DOWN_LEFT;
     TreeNode* curr = data->root_;
     while (direct != YAC_STOP) {
@@ -742,7 +1386,7 @@ static void YacOrderedMapDeinit_(YacOrderedMapData* data)
                 func_clean_key(temp->pair_.key);
             if (func_clean_val)
                 func_clean_val(temp->pair_.value);
-            YAC_ORDERED_MAP_FREE(temp);
+            YacOrderedMapNodeFree_(data, temp);
             continue;
         }
 
@@ -764,7 +1408,7 @@ static void YacOrderedMapDeinit_(YacOrderedMapData* data)
                 func_clean_key(temp->pair_.key);
             if (func_clean_val)
                 func_clean_val(temp->pair_.value);
-            YAC_ORDERED_MAP_FREE(temp);
+            YacOrderedMapNodeFree_(data, temp);
             continue;
         }
 
@@ -779,7 +1423,7 @@ static void YacOrderedMapDeinit_(YacOrderedMapData* data)
             func_clean_key(temp->pair_.key);
         if (func_clean_val)
             func_clean_val(temp->pair_.value);
-        YAC_ORDERED_MAP_FREE(temp);
+        YacOrderedMapNodeFree_(data, temp);
     }
 
     return;
@@ -873,6 +1517,10 @@ static void YacOrderedMapRightRotate_(YacOrderedMapData* data, TreeNode* curr)
     curr->parent_ = child;
     child->right_ = curr;
 
+    // x takes over the subtree of y, and y keeps b and c.
+    child->count_ = curr->count_;
+    curr->count_ = curr->left_->count_ + curr->right_->count_ + 1;
+
     return;
 }
 
@@ -910,6 +1558,10 @@ static void YacOrderedMapLeftRotate_(YacOrderedMapData* data, TreeNode* curr)
     curr->parent_ = child;
     child->left_ = curr;
 
+    // y takes over the subtree of x, and x keeps a and b.
+    child->count_ = curr->count_;
+    curr->count_ = curr->left_->count_ + curr->right_->count_ + 1;
+
     return;
 }
 
@@ -1161,12 +1813,1264 @@ static TreeNode* YacOrderedMapSearch_(YacOrderedMapData* data, void* key)
     return curr;
 }
 
-static int YacOrderedMapCompare_(void* lhs, void* rhs)
+static TreeNode* YacOrderedMapBound_(YacOrderedMapData* data, void* key, bool after, bool inclusive)
 {
-    if ((intptr_t)lhs == (intptr_t)rhs)
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    TreeNode* null = data->null_;
+    TreeNode* curr = data->root_;
+    TreeNode* bound = null;
+
+    // Keep the nearest node on the wanted side, and keep looking toward the key.
+    while (curr != null) {
+        int order = func_cmp(key, curr->pair_.key);
+        bool hit = (after)? (order < 0 || (inclusive && order == 0))
+                          : (order > 0 || (inclusive && order == 0));
+        if (hit) {
+            bound = curr;
+            if (order == 0)
+                break;
+            curr = (after)? curr->left_ : curr->right_;
+        } else
+            curr = (order > 0 || (order == 0 && after))? curr->right_ : curr->left_;
+    }
+    return bound;
+}
+
+static YacOrderedMapPair* YacOrderedMapNext_(YacOrderedMapData* data)
+{
+    char direct = data->iter_direct_;
+    TreeNode* null = data->null_;
+    TreeNode* curr = data->iter_node_;
+
+    while (curr != null) {
+        if (direct == YAC_DOWN_LEFT || direct == YAC_DOWN_RIGHT) {
+            if (curr->left_ != null) {
+                curr = curr->left_;
+                direct = YAC_DOWN_LEFT;
+                continue;
+            }
+
+            YacOrderedMapPair* pair = &(curr->pair_);
+
+            if (curr->right_ != null) {
+                data->iter_node_ = curr->right_;
+                data->iter_direct_ = YAC_DOWN_RIGHT;
+            } else {
+                TreeNode* temp = curr;
+                curr = curr->parent_;
+                data->iter_node_ = curr;
+                if (curr != null) {
+                    if (temp == curr->left_)
+                        data->iter_direct_ = YAC_UP_LEFT;
+                    else
+                        data->iter_direct_ = YAC_UP_RIGHT;
+                }
+            }
+            return pair;
+        }
+
+        if (direct == YAC_UP_LEFT) {
+            YacOrderedMapPair* pair = &(curr->pair_);
+
+            if (curr->right_ != null) {
+                data->iter_node_ = curr->right_;
+                data->iter_direct_ = YAC_DOWN_RIGHT;
+            } else {
+                TreeNode* temp = curr;
+                curr = curr->parent_;
+                data->iter_node_ = curr;
+                if (curr != null) {
+                    if (temp == curr->left_)
+                        data->iter_direct_ = YAC_UP_LEFT;
+                    else
+                        data->iter_direct_ = YAC_UP_RIGHT;
+                }
+            }
+            return pair;
+        }
+
+        TreeNode* temp = curr;
+        curr = curr->parent_;
+        if (curr != null) {
+            if (temp == curr->left_)
+                direct = YAC_UP_LEFT;
+            else
+                direct = YAC_UP_RIGHT;
+        }
+    }
+
+    data->iter_node_ = null;
+    return NULL;
+}
+
+static void YacOrderedMapRecount_(TreeNode* null, TreeNode* curr, int diff)
+{
+    while (curr != null) {
+        curr->count_ += diff;
+        curr = curr->parent_;
+    }
+    return;
+}
+
+static TreeNode* YacOrderedMapBuild_(TreeNode* null, TreeNode* nodes, unsigned num, unsigned depth, unsigned red)
+{
+    if (num == 0)
+        return null;
+
+    unsigned mid = num >> 1;
+    TreeNode* node = nodes + mid;
+    node->left_ = YacOrderedMapBuild_(null, nodes, mid, depth + 1, red);
+    node->right_ = YacOrderedMapBuild_(null, nodes + mid + 1, num - mid - 1, depth + 1, red);
+    if (node->left_ != null)
+        node->left_->parent_ = node;
+    if (node->right_ != null)
+        node->right_->parent_ = node;
+
+    node->color_ = (depth == red)? YAC_COLOR_RED : YAC_COLOR_BLACK;
+    node->count_ = num;
+    return node;
+}
+
+static bool YacOrderedMapAlike_(YacOrderedMapData* data, YacOrderedMapData* other)
+{
+    return data->flags_ == other->flags_ && data->func_cmp_ == other->func_cmp_;
+}
+
+static int YacOrderedMapBlackHeight_(TreeNode* null, TreeNode* curr)
+{
+    int height = 0;
+    while (curr != null) {
+        if (curr->color_ == YAC_COLOR_BLACK)
+            ++height;
+        curr = curr->left_;
+    }
+    return height;
+}
+
+static TreeNode* YacOrderedMapJoin_(YacOrderedMapData* data, TreeNode* left, int height_left, TreeNode* mid, TreeNode* right, int height_right, int* height)
+{
+    TreeNode* null = data->null_;
+
+    // Turning the subtree roots black keeps both subtrees valid on their own.
+    if (left != null) {
+        left->parent_ = null;
+        left->color_ = YAC_COLOR_BLACK;
+    }
+    if (right != null) {
+        right->parent_ = null;
+        right->color_ = YAC_COLOR_BLACK;
+    }
+
+    mid->parent_ = null;
+
+    if (height_left == height_right) {
+        mid->left_ = left;
+        mid->right_ = right;
+        if (left != null)
+            left->parent_ = mid;
+        if (right != null)
+            right->parent_ = mid;
+        mid->color_ = YAC_COLOR_BLACK;
+        mid->count_ = left->count_ + right->count_ + 1;
+        *height = height_left + 1;
+        return mid;
+    }
+
+    // Walk down the inner spine of the taller subtree to the black node as high
+    // as the shorter subtree, and hang the red middle node there.
+    bool taller_left = height_left > height_right;
+    TreeNode* root = (taller_left)? left : right;
+    TreeNode* parent = null;
+    TreeNode* curr = root;
+    int taller = (taller_left)? height_left : height_right;
+    int target = (taller_left)? height_right : height_left;
+    int depth = taller;
+    while (curr->color_ == YAC_COLOR_RED || depth > target) {
+        if (curr->color_ == YAC_COLOR_BLACK)
+            --depth;
+        parent = curr;
+        curr = (taller_left)? curr->right_ : curr->left_;
+    }
+
+    if (taller_left) {
+        mid->left_ = curr;
+        mid->right_ = right;
+        parent->right_ = mid;
+    } else {
+        mid->left_ = left;
+        mid->right_ = curr;
+        parent->left_ = mid;
+    }
+    mid->parent_ = parent;
+    mid->color_ = YAC_COLOR_RED;
+    if (mid->left_ != null)
+        mid->left_->parent_ = mid;
+    if (mid->right_ != null)
+        mid->right_->parent_ = mid;
+    mid->count_ = mid->left_->count_ + mid->right_->count_ + 1;
+    YacOrderedMapRecount_(null, parent, (int)(((taller_left)? right : left)->count_ + 1));
+
+    // Repair the red parent above the middle node like an insertion does. The
+    // tree grows a level only if the recoloring reaches the root, which turns
+    // its two red children black.
+    bool red_children = root->left_->color_ == YAC_COLOR_RED && root->right_->color_ == YAC_COLOR_RED;
+    data->root_ = root;
+    YacOrderedMapInsertFixup_(data, mid);
+    bool grown = red_children && data->root_ == root && root->left_->color_ == YAC_COLOR_BLACK;
+    *height = taller + ((grown)? 1 : 0);
+    return data->root_;
+}
+
+static TreeNode* YacOrderedMapJoin2_(YacOrderedMapData* data, TreeNode* left, int height_left, TreeNode* right, int height_right, int* height)
+{
+    TreeNode* null = data->null_;
+    if (left == null || right == null) {
+        TreeNode* root = (left != null)? left : right;
+        if (root != null) {
+            root->parent_ = null;
+            root->color_ = YAC_COLOR_BLACK;
+        }
+        *height = (left != null)? height_left : height_right;
+        return root;
+    }
+
+    TreeNode* min = YacOrderedMapMinimal_(null, right);
+    TreeNode* lower;
+    TreeNode* rest;
+    int height_lower;
+    int height_rest;
+    YacOrderedMapSplit_(data, right, height_right, min->pair_.key, &lower, &height_lower, &rest, &height_rest);
+    return YacOrderedMapJoin_(data, left, height_left, min, rest, height_rest, height);
+}
+
+static TreeNode* YacOrderedMapSplit_(YacOrderedMapData* data, TreeNode* curr, int height, void* key, TreeNode** left, int* height_left, TreeNode** right, int* height_right)
+{
+    TreeNode* null = data->null_;
+    if (curr == null) {
+        *left = null;
+        *right = null;
+        *height_left = 0;
+        *height_right = 0;
+        return null;
+    }
+
+    TreeNode* lower = curr->left_;
+    TreeNode* upper = curr->right_;
+    int height_lower = height - ((lower->color_ == YAC_COLOR_BLACK)? 1 : 0);
+    int height_upper = height - ((upper->color_ == YAC_COLOR_BLACK)? 1 : 0);
+    int order = data->func_cmp_(key, curr->pair_.key);
+    if (order == 0) {
+        if (lower != null) {
+            lower->parent_ = null;
+            lower->color_ = YAC_COLOR_BLACK;
+        }
+        if (upper != null) {
+            upper->parent_ = null;
+            upper->color_ = YAC_COLOR_BLACK;
+        }
+        *left = lower;
+        *right = upper;
+        *height_left = height_lower;
+        *height_right = height_upper;
+        return curr;
+    }
+
+    // Split the side holding the key, and join the rest back through the node.
+    TreeNode* part;
+    TreeNode* same;
+    int height_part;
+    if (order < 0) {
+        same = YacOrderedMapSplit_(data, lower, height_lower, key, left, height_left, &part, &height_part);
+        *right = YacOrderedMapJoin_(data, part, height_part, curr, upper, height_upper, height_right);
+    } else {
+        same = YacOrderedMapSplit_(data, upper, height_upper, key, &part, &height_part, right, height_right);
+        *left = YacOrderedMapJoin_(data, lower, height_lower, curr, part, height_part, height_left);
+    }
+    return same;
+}
+
+static TreeNode* YacOrderedMapUnion_(YacOrderedMapData* data, TreeNode* base, int height_base, TreeNode* other, int height_other, bool keep_base, unsigned* num_dup, int* height)
+{
+    TreeNode* null = data->null_;
+    if (base == null || other == null) {
+        *height = (base != null)? height_base : height_other;
+        return (base != null)? base : other;
+    }
+
+    TreeNode* lower;
+    TreeNode* upper;
+    int height_lower;
+    int height_upper;
+    TreeNode* same = YacOrderedMapSplit_(data, other, height_other, base->pair_.key, &lower, &height_lower, &upper, &height_upper);
+    if (same != null) {
+        YacOrderedMapPair* pair = (keep_base)? &(same->pair_) : &(base->pair_);
+        if (data->func_clean_key_)
+            data->func_clean_key_(pair->key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(pair->value);
+        if (!keep_base)
+            base->pair_ = same->pair_;
+        YacOrderedMapNodeFree_(data, same);
+        ++(*num_dup);
+    }
+
+    TreeNode* prev = base->left_;
+    TreeNode* next = base->right_;
+    int height_prev = height_base - ((prev->color_ == YAC_COLOR_BLACK)? 1 : 0);
+    int height_next = height_base - ((next->color_ == YAC_COLOR_BLACK)? 1 : 0);
+    int height_left;
+    int height_right;
+    TreeNode* left = YacOrderedMapUnion_(data, prev, height_prev, lower, height_lower, keep_base, num_dup, &height_left);
+    TreeNode* right = YacOrderedMapUnion_(data, next, height_next, upper, height_upper, keep_base, num_dup, &height_right);
+    return YacOrderedMapJoin_(data, left, height_left, base, right, height_right, height);
+}
+
+static unsigned YacOrderedMapMeasure_(YacOrderedMapData* data, TreeNode* left, TreeNode* right, unsigned total)
+{
+    TreeNode* null = data->null_;
+    if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC)
+        return left->count_;
+
+    TreeNode* curr_left = YacOrderedMapMinimal_(null, left);
+    TreeNode* curr_right = YacOrderedMapMinimal_(null, right);
+    unsigned count = 0;
+    while (curr_left != null && curr_right != null) {
+        curr_left = YacOrderedMapSuccessor_(null, curr_left);
+        curr_right = YacOrderedMapSuccessor_(null, curr_right);
+        ++count;
+    }
+    return (curr_left == null)? count : total - count;
+}
+
+static TreeNode* YacOrderedMapRehome_(YacOrderedMapData* src, TreeNode* old_null, TreeNode* new_null, TreeNode* curr, TreeNode* parent, void** spare)
+{
+    if (curr == old_null)
+        return new_null;
+
+    TreeNode* node = curr;
+    if (spare) {
+        node = *spare;
+        *spare = *(void**)node;
+        *node = *curr;
+        YacOrderedMapNodeFree_(src, curr);
+    }
+
+    node->parent_ = parent;
+    node->left_ = YacOrderedMapRehome_(src, old_null, new_null, node->left_, node, spare);
+    node->right_ = YacOrderedMapRehome_(src, old_null, new_null, node->right_, node, spare);
+    return node;
+}
+
+static bool YacOrderedMapGather_(YacOrderedMapData* data, YacOrderedMapData* other, TreeNode** root_self, TreeNode** root_other)
+{
+    bool swap = other->size_ > data->size_;
+    YacOrderedMapData* small = (swap)? data : other;
+    YacOrderedMapData* large = (swap)? other : data;
+
+    // If either map pools its nodes, the smaller tree is copied into the nodes
+    // of the larger map, which come from its recycled nodes first, and the node
+    // pool of the smaller map is released as a whole.
+    bool copy = data->pooled_ || other->pooled_;
+    void* spare = NULL;
+    if (copy && !YacOrderedMapPoolTake_(large, (unsigned)small->size_, &spare))
+        return false;
+    TreeNode* moved = YacOrderedMapRehome_(small, small->null_, large->null_, small->root_, large->null_, (copy)? &spare : NULL);
+    YacOrderedMapPoolRelease_(small);
+
+    if (swap) {
+        TreeNode* temp = data->null_;
+        data->null_ = other->null_;
+        other->null_ = temp;
+        YacOrderedMapPoolSwap_(data, other);
+        *root_self = moved;
+        *root_other = other->root_;
+    } else {
+        *root_self = data->root_;
+        *root_other = moved;
+    }
+
+    other->root_ = other->null_;
+    other->iter_node_ = other->null_;
+    return true;
+}
+
+static int YacOrderedMapCompare_(void* lhs, void* rhs)
+{
+    if ((intptr_t)lhs == (intptr_t)rhs)
         return 0;
     return ((intptr_t)lhs >= (intptr_t)rhs)? 1 : (-1);
 }
 
+static TreeNode* YacOrderedMapNodeAlloc_(YacOrderedMapData* data)
+{
+    if (!data->pooled_)
+        return YAC_ORDERED_MAP_MALLOC(sizeof(TreeNode));
+
+    // Reuse a recycled node first.
+    if (data->pool_free_) {
+        void* node = data->pool_free_;
+        data->pool_free_ = *(void**)node;
+        return node;
+    }
+
+    // Carve the node out of the newest chunk, and append a chunk when it is used up.
+    if (!data->pool_chunk_ || data->pool_used_ == YAC_ORDERED_MAP_POOL_CHUNK) {
+        void** chunk = YAC_ORDERED_MAP_MALLOC(sizeof(void*) + sizeof(TreeNode) * YAC_ORDERED_MAP_POOL_CHUNK);
+        if (!chunk)
+            return NULL;
+        *chunk = data->pool_chunk_;
+        data->pool_chunk_ = chunk;
+        data->pool_used_ = 0;
+    }
+
+    TreeNode* base = (TreeNode*)((char*)data->pool_chunk_ + sizeof(void*));
+    return base + (data->pool_used_)++;
+}
+
+static void YacOrderedMapNodeFree_(YacOrderedMapData* data, TreeNode* node)
+{
+    if (!data->pooled_) {
+        YAC_ORDERED_MAP_FREE(node);
+        return;
+    }
+
+    *(void**)node = data->pool_free_;
+    data->pool_free_ = node;
+    return;
+}
+
+static void YacOrderedMapPoolRelease_(YacOrderedMapData* data)
+{
+    void* chunk = data->pool_chunk_;
+    while (chunk) {
+        void* prev = *(void**)chunk;
+        YAC_ORDERED_MAP_FREE(chunk);
+        chunk = prev;
+    }
+
+    data->pool_chunk_ = NULL;
+    data->pool_free_ = NULL;
+    data->pool_used_ = 0;
+    return;
+}
+
+static void YacOrderedMapPoolAdopt_(YacOrderedMapData* data, void** chunk)
+{
+    // Link the chunk behind the newest chunk, which keeps carving the new nodes.
+    if (data->pool_chunk_) {
+        *chunk = *(void**)data->pool_chunk_;
+        *(void**)data->pool_chunk_ = chunk;
+    } else {
+        *chunk = NULL;
+        data->pool_chunk_ = chunk;
+        data->pool_used_ = YAC_ORDERED_MAP_POOL_CHUNK;
+    }
+    return;
+}
+
+static bool YacOrderedMapPoolTake_(YacOrderedMapData* data, unsigned num, void** list)
+{
+    *list = NULL;
+    unsigned i;
+    for (i = 0 ; i < num ; ++i) {
+        TreeNode* node = YacOrderedMapNodeAlloc_(data);
+        if (!node) {
+            // Give back the nodes taken so far.
+            while (*list) {
+                void* next = *(void**)*list;
+                YacOrderedMapNodeFree_(data, *list);
+                *list = next;
+            }
+            return false;
+        }
+        *(void**)node = *list;
+        *list = node;
+    }
+    return true;
+}
+
+static void YacOrderedMapPoolSwap_(YacOrderedMapData* data, YacOrderedMapData* other)
+{
+    bool pooled = data->pooled_;
+    void* chunk = data->pool_chunk_;
+    void* free = data->pool_free_;
+    unsigned used = data->pool_used_;
+
+    data->pooled_ = other->pooled_;
+    data->pool_chunk_ = other->pool_chunk_;
+    data->pool_free_ = other->pool_free_;
+    data->pool_used_ = other->pool_used_;
+    other->pooled_ = pooled;
+    other->pool_chunk_ = chunk;
+    other->pool_free_ = free;
+    other->pool_used_ = used;
+    return;
+}
+
+static BTreeNode* YacOrderedMapBTreeAlloc_(bool leaf)
+{
+    size_t size = sizeof(BTreeNode);
+    if (!leaf)
+        size += sizeof(BTreeNode*) * (YAC_ORDERED_MAP_BTREE_MAX + 1);
+    BTreeNode* node = (BTreeNode*)YAC_ORDERED_MAP_MALLOC(size);
+    if (!node)
+        return NULL;
+
+    node->num_ = 0;
+    node->total_ = 0;
+    node->leaf_ = leaf;
+    return node;
+}
+
+static void YacOrderedMapBTreeRelease_(YacOrderedMapData* data, BTreeNode* node)
+{
+    unsigned i;
+    for (i = 0 ; i < node->num_ ; ++i) {
+        if (data->func_clean_key_)
+            data->func_clean_key_(node->pair_[i].key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(node->pair_[i].value);
+    }
+
+    if (!node->leaf_) {
+        for (i = 0 ; i <= node->num_ ; ++i)
+            YacOrderedMapBTreeRelease_(data, node->child_[i]);
+    }
+
+    YAC_ORDERED_MAP_FREE(node);
+    return;
+}
+
+static unsigned YacOrderedMapBTreeFind_(YacOrderedMapCompare func_cmp, BTreeNode* node, void* key, bool* found)
+{
+    // Request all the cache lines of the keys at once, so that the binary search
+    // waits for one miss instead of one per step.
+    const char* line = (const char*)node->key_;
+    const char* end = (const char*)(node->key_ + node->num_);
+    for ( ; line < end ; line += 64)
+        YAC_ORDERED_MAP_PREFETCH(line);
+
+    unsigned low = 0;
+    unsigned high = node->num_;
+    while (low < high) {
+        unsigned mid = low + ((high - low) >> 1);
+        int order = func_cmp(key, node->key_[mid]);
+        if (order == 0) {
+            *found = true;
+            return mid;
+        }
+        if (order > 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    *found = false;
+    return low;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeSearch_(YacOrderedMapData* data, void* key)
+{
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    BTreeNode* node = data->btree_root_;
+
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+        if (found)
+            return &(node->pair_[idx]);
+        if (node->leaf_)
+            break;
+        node = node->child_[idx];
+    }
+
+    return NULL;
+}
+
+static void YacOrderedMapBTreeMove_(BTreeNode* dst, unsigned idx_dst, BTreeNode* src, unsigned idx_src, unsigned count)
+{
+    memmove(dst->key_ + idx_dst, src->key_ + idx_src, sizeof(void*) * count);
+    memmove(dst->pair_ + idx_dst, src->pair_ + idx_src, sizeof(YacOrderedMapPair) * count);
+    return;
+}
+
+static bool YacOrderedMapBTreeSplit_(BTreeNode* node, unsigned idx)
+{
+    const unsigned degree = YAC_ORDERED_MAP_BTREE_DEGREE;
+    BTreeNode* left = node->child_[idx];
+    BTreeNode* right = YacOrderedMapBTreeAlloc_(left->leaf_);
+    if (!right)
+        return false;
+
+    // The upper half moves to the new node, and the median moves up between them.
+    YacOrderedMapBTreeMove_(right, 0, left, degree, degree - 1);
+    if (!left->leaf_)
+        memcpy(right->child_, left->child_ + degree, sizeof(BTreeNode*) * degree);
+    right->num_ = degree - 1;
+    left->num_ = degree - 1;
+
+    unsigned i;
+    right->total_ = degree - 1;
+    for (i = 0 ; i < degree ; ++i)
+        right->total_ += YacOrderedMapBTreeBelow_(right, i);
+    left->total_ -= right->total_ + 1;
+
+    YacOrderedMapBTreeMove_(node, idx + 1, node, idx, node->num_ - idx);
+    memmove(node->child_ + idx + 2, node->child_ + idx + 1,
+        sizeof(BTreeNode*) * (node->num_ - idx));
+    YacOrderedMapBTreeMove_(node, idx, left, degree - 1, 1);
+    node->child_[idx + 1] = right;
+    ++(node->num_);
+    return true;
+}
+
+static BTreeNode* YacOrderedMapBTreeMerge_(YacOrderedMapData* data, BTreeNode* node, unsigned idx)
+{
+    BTreeNode* left = node->child_[idx];
+    BTreeNode* right = node->child_[idx + 1];
+
+    YacOrderedMapBTreeMove_(left, left->num_, node, idx, 1);
+    YacOrderedMapBTreeMove_(left, left->num_ + 1, right, 0, right->num_);
+    if (!left->leaf_) {
+        memcpy(left->child_ + left->num_ + 1, right->child_,
+            sizeof(BTreeNode*) * (right->num_ + 1));
+    }
+    left->num_ += right->num_ + 1;
+    left->total_ += right->total_ + 1;
+    YAC_ORDERED_MAP_FREE(right);
+
+    YacOrderedMapBTreeMove_(node, idx, node, idx + 1, node->num_ - idx - 1);
+    memmove(node->child_ + idx + 1, node->child_ + idx + 2,
+        sizeof(BTreeNode*) * (node->num_ - idx - 1));
+    --(node->num_);
+
+    if (node->num_ == 0 && node == data->btree_root_) {
+        data->btree_root_ = left;
+        YAC_ORDERED_MAP_FREE(node);
+    }
+
+    return left;
+}
+
+static void YacOrderedMapBTreeBorrowLeft_(BTreeNode* node, unsigned idx)
+{
+    BTreeNode* child = node->child_[idx];
+    BTreeNode* left = node->child_[idx - 1];
+
+    YacOrderedMapBTreeMove_(child, 1, child, 0, child->num_);
+    YacOrderedMapBTreeMove_(child, 0, node, idx - 1, 1);
+    YacOrderedMapBTreeMove_(node, idx - 1, left, left->num_ - 1, 1);
+    unsigned moved = 1 + YacOrderedMapBTreeBelow_(left, left->num_);
+    if (!child->leaf_) {
+        memmove(child->child_ + 1, child->child_, sizeof(BTreeNode*) * (child->num_ + 1));
+        child->child_[0] = left->child_[left->num_];
+    }
+
+    --(left->num_);
+    ++(child->num_);
+    left->total_ -= moved;
+    child->total_ += moved;
+    return;
+}
+
+static void YacOrderedMapBTreeBorrowRight_(BTreeNode* node, unsigned idx)
+{
+    BTreeNode* child = node->child_[idx];
+    BTreeNode* right = node->child_[idx + 1];
+
+    unsigned moved = 1 + YacOrderedMapBTreeBelow_(right, 0);
+    YacOrderedMapBTreeMove_(child, child->num_, node, idx, 1);
+    YacOrderedMapBTreeMove_(node, idx, right, 0, 1);
+    YacOrderedMapBTreeMove_(right, 0, right, 1, right->num_ - 1);
+    if (!child->leaf_) {
+        child->child_[child->num_ + 1] = right->child_[0];
+        memmove(right->child_, right->child_ + 1, sizeof(BTreeNode*) * right->num_);
+    }
+
+    --(right->num_);
+    ++(child->num_);
+    right->total_ -= moved;
+    child->total_ += moved;
+    return;
+}
+
+static bool YacOrderedMapBTreePut_(YacOrderedMapData* data, void* key, void* value)
+{
+    BTreeNode* root = data->btree_root_;
+    if (!root) {
+        root = YacOrderedMapBTreeAlloc_(true);
+        if (!root)
+            return false;
+        data->btree_root_ = root;
+    }
+
+    // Split the full root first, which is the only way the tree grows taller.
+    if (root->num_ == YAC_ORDERED_MAP_BTREE_MAX) {
+        BTreeNode* parent = YacOrderedMapBTreeAlloc_(false);
+        if (!parent)
+            return false;
+        parent->child_[0] = root;
+        parent->total_ = root->total_;
+        if (!YacOrderedMapBTreeSplit_(parent, 0)) {
+            YAC_ORDERED_MAP_FREE(parent);
+            return false;
+        }
+        data->btree_root_ = root = parent;
+    }
+
+    // Split every full child before descending into it, so that the leaf
+    // always has room for the new pair.
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    BTreeNode* path[YAC_ORDERED_MAP_BTREE_MAX_HEIGHT];
+    int depth = 0;
+    BTreeNode* node = root;
+    while (true) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+
+        if (found) {
+            YacOrderedMapPair* pair = &(node->pair_[idx]);
+            if (data->func_clean_key_)
+                data->func_clean_key_(pair->key);
+            if (data->func_clean_val_)
+                data->func_clean_val_(pair->value);
+            node->key_[idx] = key;
+            pair->key = key;
+            pair->value = value;
+            return true;
+        }
+
+        if (node->leaf_) {
+            YacOrderedMapBTreeMove_(node, idx + 1, node, idx, node->num_ - idx);
+            node->key_[idx] = key;
+            node->pair_[idx].key = key;
+            node->pair_[idx].value = value;
+            ++(node->num_);
+            ++(node->total_);
+            ++(data->size_);
+            if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) {
+                while (depth > 0)
+                    ++(path[--depth]->total_);
+            }
+            return true;
+        }
+
+        if (node->child_[idx]->num_ == YAC_ORDERED_MAP_BTREE_MAX) {
+            if (!YacOrderedMapBTreeSplit_(node, idx))
+                return false;
+            // Search the node again for the side of the median to descend.
+            continue;
+        }
+
+        path[depth++] = node;
+        node = node->child_[idx];
+    }
+}
+
+static bool YacOrderedMapBTreeRemove_(YacOrderedMapData* data, void* key)
+{
+    const unsigned degree = YAC_ORDERED_MAP_BTREE_DEGREE;
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    BTreeNode* node = data->btree_root_;
+    BTreeNode* path[YAC_ORDERED_MAP_BTREE_MAX_HEIGHT];
+    int depth = 0;
+    bool clean = true;
+    bool removed = false;
+
+    // Make sure that every child holds at least DEGREE pairs before descending
+    // into it, so that a pair can be taken from it without another pass.
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+        path[depth++] = node;
+
+        if (found && clean) {
+            if (data->func_clean_key_)
+                data->func_clean_key_(node->pair_[idx].key);
+            if (data->func_clean_val_)
+                data->func_clean_val_(node->pair_[idx].value);
+            removed = true;
+        }
+
+        if (node->leaf_) {
+            if (found) {
+                YacOrderedMapBTreeMove_(node, idx, node, idx + 1, node->num_ - idx - 1);
+                --(node->num_);
+                --(node->total_);
+                --depth;
+            }
+            break;
+        }
+
+        if (found) {
+            BTreeNode* left = node->child_[idx];
+            BTreeNode* right = node->child_[idx + 1];
+
+            // Replace the pair with its predecessor or successor, and remove
+            // that one from the child without cleaning it.
+            if (left->num_ >= degree) {
+                BTreeNode* curr = left;
+                while (!curr->leaf_)
+                    curr = curr->child_[curr->num_];
+                YacOrderedMapBTreeMove_(node, idx, curr, curr->num_ - 1, 1);
+                key = node->key_[idx];
+                clean = false;
+                node = left;
+            } else if (right->num_ >= degree) {
+                BTreeNode* curr = right;
+                while (!curr->leaf_)
+                    curr = curr->child_[0];
+                YacOrderedMapBTreeMove_(node, idx, curr, 0, 1);
+                key = node->key_[idx];
+                clean = false;
+                node = right;
+            } else {
+                // The pair moves down into the merged child, already cleaned.
+                clean = false;
+                node = YacOrderedMapBTreeMerge_(data, node, idx);
+                if (node == data->btree_root_)
+                    depth = 0;
+            }
+            continue;
+        }
+
+        BTreeNode* child = node->child_[idx];
+        if (child->num_ < degree) {
+            if (idx > 0 && node->child_[idx - 1]->num_ >= degree)
+                YacOrderedMapBTreeBorrowLeft_(node, idx);
+            else if (idx < node->num_ && node->child_[idx + 1]->num_ >= degree)
+                YacOrderedMapBTreeBorrowRight_(node, idx);
+            else if (idx < node->num_)
+                child = YacOrderedMapBTreeMerge_(data, node, idx);
+            else
+                child = YacOrderedMapBTreeMerge_(data, node, idx - 1);
+            // The collapsed root is released.
+            if (child == data->btree_root_)
+                depth = 0;
+        }
+        node = child;
+    }
+
+    if (!removed)
+        return false;
+
+    --(data->size_);
+    if (data->flags_ & YAC_ORDERED_MAP_ORDER_STATISTIC) {
+        while (depth > 0)
+            --(path[--depth]->total_);
+    }
+    BTreeNode* root = data->btree_root_;
+    if (root->num_ == 0) {
+        YAC_ORDERED_MAP_FREE(root);
+        data->btree_root_ = NULL;
+    }
+    return true;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeNeighbor_(YacOrderedMapData* data, void* key, bool succ)
+{
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    YacOrderedMapPair* bound = NULL;
+    BTreeNode* node = data->btree_root_;
+
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+
+        if (found) {
+            if (node->leaf_) {
+                if (succ)
+                    return (idx + 1 < node->num_)? &(node->pair_[idx + 1]) : bound;
+                return (idx > 0)? &(node->pair_[idx - 1]) : bound;
+            }
+
+            BTreeNode* curr;
+            if (succ) {
+                curr = node->child_[idx + 1];
+                while (!curr->leaf_)
+                    curr = curr->child_[0];
+                return &(curr->pair_[0]);
+            }
+            curr = node->child_[idx];
+            while (!curr->leaf_)
+                curr = curr->child_[curr->num_];
+            return &(curr->pair_[curr->num_ - 1]);
+        }
+
+        // The pairs around the subtree to descend bound the neighbors found in it.
+        if (succ && idx < node->num_)
+            bound = &(node->pair_[idx]);
+        if (!succ && idx > 0)
+            bound = &(node->pair_[idx - 1]);
+
+        if (node->leaf_)
+            break;
+        node = node->child_[idx];
+    }
+
+    return NULL;
+}
+
+static void YacOrderedMapBTreePush_(YacOrderedMapData* data, BTreeNode* node, bool reverse)
+{
+    int depth = data->iter_depth_;
+    while (node) {
+        data->iter_path_[depth] = node;
+        data->iter_idx_[depth] = (reverse)? node->num_ : 0;
+        ++depth;
+        if (node->leaf_)
+            break;
+        node = node->child_[(reverse)? node->num_ : 0];
+    }
+
+    data->iter_depth_ = depth;
+    return;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeNext_(YacOrderedMapData* data, bool reverse)
+{
+    if (data->iter_depth_ < 0) {
+        data->iter_depth_ = 0;
+        YacOrderedMapBTreePush_(data, data->btree_root_, reverse);
+    }
+
+    // Forward, the index is the next pair to visit in the node. In reverse, it
+    // is the number of the pairs left to visit.
+    while (data->iter_depth_ > 0) {
+        int depth = data->iter_depth_ - 1;
+        BTreeNode* node = data->iter_path_[depth];
+        unsigned idx = data->iter_idx_[depth];
+
+        if (!reverse && idx < node->num_) {
+            data->iter_idx_[depth] = idx + 1;
+            if (!node->leaf_)
+                YacOrderedMapBTreePush_(data, node->child_[idx + 1], false);
+            return &(node->pair_[idx]);
+        }
+        if (reverse && idx > 0) {
+            data->iter_idx_[depth] = idx - 1;
+            if (!node->leaf_)
+                YacOrderedMapBTreePush_(data, node->child_[idx - 1], true);
+            return &(node->pair_[idx - 1]);
+        }
+
+        --(data->iter_depth_);
+    }
+
+    return NULL;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeBound_(YacOrderedMapData* data, void* key, bool after, bool inclusive)
+{
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    YacOrderedMapPair* bound = NULL;
+    BTreeNode* node = data->btree_root_;
+
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+        if (found && inclusive)
+            return &(node->pair_[idx]);
+
+        // The pairs at idx and after are not less than the key, and the equal
+        // one is skipped when going after it.
+        unsigned child = idx;
+        if (after) {
+            if (found)
+                child = idx + 1;
+            if (child < node->num_)
+                bound = &(node->pair_[child]);
+        } else if (idx > 0)
+            bound = &(node->pair_[idx - 1]);
+
+        if (node->leaf_)
+            break;
+        node = node->child_[child];
+    }
+
+    return bound;
+}
+
+static void YacOrderedMapBTreeSeek_(YacOrderedMapData* data, void* key)
+{
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    BTreeNode* node = data->btree_root_;
+    int depth = 0;
+
+    // The pairs and children before the index are treated as visited already.
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+        data->iter_path_[depth] = node;
+        data->iter_idx_[depth] = idx;
+        ++depth;
+        if (found || node->leaf_)
+            break;
+        node = node->child_[idx];
+    }
+
+    data->iter_depth_ = depth;
+    return;
+}
+
+static BTreeNode* YacOrderedMapBTreeBuild_(const YacOrderedMapPair* pairs, unsigned num, unsigned height, const uint64_t* cap, bool root)
+{
+    BTreeNode* node = YacOrderedMapBTreeAlloc_(height == 1);
+    if (!node)
+        return NULL;
+
+    unsigned i;
+    if (height == 1) {
+        for (i = 0 ; i < num ; ++i) {
+            node->key_[i] = pairs[i].key;
+            node->pair_[i] = pairs[i];
+        }
+        node->num_ = num;
+        node->total_ = num;
+        return node;
+    }
+
+    // Use as few children as can hold the pairs, but no fewer than a node needs.
+    // Every child takes its share of the pairs plus the separator after it.
+    unsigned count = (unsigned)((num + 1 + cap[height - 1]) / (cap[height - 1] + 1));
+    unsigned min = (root)? 2 : YAC_ORDERED_MAP_BTREE_DEGREE;
+    if (count < min)
+        count = min;
+    unsigned share = (num + 1) / count;
+    unsigned extra = (num + 1) % count;
+
+    for (i = 0 ; i < count ; ++i) {
+        unsigned size = share - 1 + ((i < extra)? 1 : 0);
+        BTreeNode* child = YacOrderedMapBTreeBuild_(pairs, size, height - 1, cap, false);
+        if (!child) {
+            while (i > 0)
+                YacOrderedMapBTreeDrop_(node->child_[--i]);
+            YAC_ORDERED_MAP_FREE(node);
+            return NULL;
+        }
+
+        node->child_[i] = child;
+        pairs += size;
+        if (i + 1 < count) {
+            node->key_[i] = pairs->key;
+            node->pair_[i] = *pairs;
+            ++pairs;
+        }
+    }
+
+    node->num_ = count - 1;
+    node->total_ = num;
+    return node;
+}
+
+static void YacOrderedMapBTreeDrop_(BTreeNode* node)
+{
+    if (!node->leaf_) {
+        unsigned i;
+        for (i = 0 ; i <= node->num_ ; ++i)
+            YacOrderedMapBTreeDrop_(node->child_[i]);
+    }
+
+    YAC_ORDERED_MAP_FREE(node);
+    return;
+}
+
+static bool YacOrderedMapBTreeBuildAll_(const YacOrderedMapPair* pairs, unsigned num, BTreeNode** root)
+{
+    if (num == 0) {
+        *root = NULL;
+        return true;
+    }
+
+    // The capacity of the subtree with height h is (2 * DEGREE)^h - 1.
+    uint64_t cap[YAC_ORDERED_MAP_BTREE_MAX_HEIGHT + 1];
+    unsigned height = 0;
+    cap[0] = 0;
+    while (cap[height] < num) {
+        ++height;
+        cap[height] = (cap[height - 1] + 1) * (2 * YAC_ORDERED_MAP_BTREE_DEGREE) - 1;
+    }
+
+    *root = YacOrderedMapBTreeBuild_(pairs, num, height, cap, true);
+    return *root != NULL;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeFlatten_(BTreeNode* node, YacOrderedMapPair* out)
+{
+    if (!node)
+        return out;
+
+    unsigned i;
+    for (i = 0 ; i < node->num_ ; ++i) {
+        if (!node->leaf_)
+            out = YacOrderedMapBTreeFlatten_(node->child_[i], out);
+        *(out++) = node->pair_[i];
+    }
+    if (!node->leaf_)
+        out = YacOrderedMapBTreeFlatten_(node->child_[i], out);
+    return out;
+}
+
+static bool YacOrderedMapBTreeSplit2_(YacOrderedMapData* data, YacOrderedMapData* other, void* key)
+{
+    if (!YacOrderedMapBTreeBound_(data, key, true, true))
+        return true;
+
+    unsigned num = (unsigned)data->size_;
+    size_t size = sizeof(YacOrderedMapPair) * (size_t)num;
+    if (size / sizeof(YacOrderedMapPair) != num)
+        return false;
+    YacOrderedMapPair* pairs = YAC_ORDERED_MAP_MALLOC(size);
+    if (!pairs)
+        return false;
+    YacOrderedMapBTreeFlatten_(data->btree_root_, pairs);
+
+    unsigned low = 0;
+    unsigned high = num;
+    while (low < high) {
+        unsigned mid = low + ((high - low) >> 1);
+        if (data->func_cmp_(pairs[mid].key, key) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    BTreeNode* left;
+    BTreeNode* right;
+    bool done = YacOrderedMapBTreeBuildAll_(pairs, low, &left);
+    if (done) {
+        done = YacOrderedMapBTreeBuildAll_(pairs + low, num - low, &right);
+        if (!done && left)
+            YacOrderedMapBTreeDrop_(left);
+    }
+    YAC_ORDERED_MAP_FREE(pairs);
+    if (!done)
+        return false;
+
+    YacOrderedMapBTreeDrop_(data->btree_root_);
+    data->btree_root_ = left;
+    data->size_ = (int)low;
+    data->iter_depth_ = 0;
+    other->btree_root_ = right;
+    other->size_ = (int)(num - low);
+    return true;
+}
+
+static bool YacOrderedMapBTreeUnion_(YacOrderedMapData* data, YacOrderedMapData* other)
+{
+    unsigned num_self = (unsigned)data->size_;
+    unsigned num = num_self + (unsigned)other->size_;
+
+    // Flatten both trees into the first half, and merge them into the second
+    // half with the kept pairs from the front and the replaced ones from the back.
+    size_t size = sizeof(YacOrderedMapPair) * 2 * (size_t)num;
+    if (size / (sizeof(YacOrderedMapPair) * 2) != num)
+        return false;
+    YacOrderedMapPair* pairs = YAC_ORDERED_MAP_MALLOC(size);
+    if (!pairs)
+        return false;
+    YacOrderedMapPair* mine = pairs;
+    YacOrderedMapPair* theirs = YacOrderedMapBTreeFlatten_(data->btree_root_, mine);
+    YacOrderedMapBTreeFlatten_(other->btree_root_, theirs);
+
+    YacOrderedMapPair* out = pairs + num;
+    unsigned num_mine = num_self;
+    unsigned num_theirs = num - num_self;
+    unsigned i = 0, j = 0, front = 0, back = num;
+    while (i < num_mine && j < num_theirs) {
+        int order = data->func_cmp_(mine[i].key, theirs[j].key);
+        if (order < 0)
+            out[front++] = mine[i++];
+        else if (order > 0)
+            out[front++] = theirs[j++];
+        else {
+            out[--back] = mine[i++];
+            out[front++] = theirs[j++];
+        }
+    }
+    while (i < num_mine)
+        out[front++] = mine[i++];
+    while (j < num_theirs)
+        out[front++] = theirs[j++];
+
+    BTreeNode* root;
+    if (!YacOrderedMapBTreeBuildAll_(out, front, &root)) {
+        YAC_ORDERED_MAP_FREE(pairs);
+        return false;
+    }
+
+    if (data->btree_root_)
+        YacOrderedMapBTreeDrop_(data->btree_root_);
+    if (other->btree_root_)
+        YacOrderedMapBTreeDrop_(other->btree_root_);
+    data->btree_root_ = root;
+    data->size_ = (int)front;
+    data->iter_depth_ = 0;
+    other->btree_root_ = NULL;
+    other->size_ = 0;
+    other->iter_depth_ = 0;
+
+    for (i = front ; i < num ; ++i) {
+        if (data->func_clean_key_)
+            data->func_clean_key_(out[i].key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(out[i].value);
+    }
+
+    YAC_ORDERED_MAP_FREE(pairs);
+    return true;
+}
+
+static unsigned YacOrderedMapBTreeBelow_(BTreeNode* node, unsigned idx)
+{
+    return (node->leaf_)? 0 : node->child_[idx]->total_;
+}
+
+static YacOrderedMapPair* YacOrderedMapBTreeSelect_(YacOrderedMapData* data, unsigned order)
+{
+    BTreeNode* node = data->btree_root_;
+    while (true) {
+        // Skip the children and the pairs ordered before the wanted one.
+        unsigned idx = 0;
+        while (true) {
+            unsigned below = YacOrderedMapBTreeBelow_(node, idx);
+            if (order < below)
+                break;
+            order -= below;
+            if (order == 0)
+                return &(node->pair_[idx]);
+            --order;
+            ++idx;
+        }
+        node = node->child_[idx];
+    }
+}
+
+static unsigned YacOrderedMapBTreeRank_(YacOrderedMapData* data, void* key)
+{
+    YacOrderedMapCompare func_cmp = data->func_cmp_;
+    BTreeNode* node = data->btree_root_;
+    unsigned count = 0;
+
+    while (node) {
+        bool found;
+        unsigned idx = YacOrderedMapBTreeFind_(func_cmp, node, key, &found);
+        unsigned i;
+        count += idx;
+        for (i = 0 ; i < idx ; ++i)
+            count += YacOrderedMapBTreeBelow_(node, i);
+
+        if (node->leaf_)
+            break;
+        if (found) {
+            count += node->child_[idx]->total_;
+            break;
+        }
+        node = node->child_[idx];
+    }
+
+    return count;
+}
+
 
 #endif // YAC_ORDERED_MAP_IMPLEMENTATION
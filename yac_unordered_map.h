@@ -28,6 +28,8 @@
 #define YAC_UNORDERED_MAP_H_
 
 #include <stdbool.h> // bool
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
 
 #ifndef YAC_UNORDERED_MAP_API
 #ifdef YAC_UNORDERED_MAP_STATIC
@@ -38,6 +40,88 @@
 #endif // YAC_UNORDERED_MAP_API
 
 
+// Flags for YacUnorderedMapInitWithFlags.
+
+// Store the pairs in a flat control byte array and a flat pair array with
+// open addressing and group probing instead of separate chaining.
+// No node is allocated per pair, and a lookup touches one control byte group
+// and usually a single pair slot.
+#define YAC_UNORDERED_MAP_FLAT (1u << 0)
+
+// Spread the rehashing of the chained engine over the following operations.
+// When the slot array grows, the old and the new arrays coexist and every
+// put, get, contain and remove migrates a bounded number of old slots, so no
+// single operation pays for moving the whole map.
+#define YAC_UNORDERED_MAP_INCREMENTAL_REHASH (1u << 1)
+
+// Store the full hash of the key in each node of the chained engine.
+// Rehashing reuses the stored hash instead of calling the hash function, and
+// a slot list traversal skips the nodes with a different hash without calling
+// the comparison function.
+#define YAC_UNORDERED_MAP_CACHE_HASH (1u << 2)
+
+// Size the slot array of the chained engine with powers of two instead of the
+// prime table. The slot index is taken from the scrambled hash with a bit mask,
+// which avoids the integer division on every operation. The prime sizing stays
+// the default because it tolerates weak hash functions better.
+#define YAC_UNORDERED_MAP_POWER_OF_TWO (1u << 3)
+
+// Carve the nodes of the chained engine out of large chunks allocated with
+// YAC_ORDERED_MAP_MALLOC and recycle the removed nodes through a free list.
+// The destructor releases whole chunks instead of freeing every node.
+#define YAC_UNORDERED_MAP_NODE_POOL (1u << 4)
+
+// Make put, get, contain, remove and size safe to call from concurrent threads.
+// The slot array is guarded by a fixed array of lock stripes, and a slot is
+// guarded by the stripe selected by the low bits of its index, so threads
+// working on different stripes do not contend. Growing the slot array takes
+// all the stripes. The other operations, including iteration, the bulk
+// operations and the destructor, still require exclusive access.
+// The flag implies YAC_UNORDERED_MAP_POWER_OF_TWO, and the flat engine,
+// incremental rehashing and the node pool are not available with it.
+#define YAC_UNORDERED_MAP_CONCURRENT (1u << 5)
+
+// Make the map safe for concurrent threads with lock-free readers.
+// get and contain traverse the slot lists without taking any lock, while put
+// and remove are serialized by a writer lock and publish their changes with
+// release stores. Replaced and removed nodes, and the slot arrays replaced by
+// growing, are reclaimed once no reader can see them, with an epoch scheme.
+// The cleanup functions of replaced and removed pairs are deferred the same way.
+// Suited for maps that are read far more often than written. The flat engine,
+// incremental rehashing and YAC_UNORDERED_MAP_CONCURRENT are not available with
+// it, and the other operations still require exclusive access.
+#define YAC_UNORDERED_MAP_READ_MOSTLY (1u << 6)
+
+// Hash the keys with a keyed hash function and a random seed drawn per map, so
+// that colliding keys cannot be crafted without knowing the seed. The seeded
+// hash function replaces the plain one, and defaults to SipHash-1-3 of the key
+// pointer value. @see YacUnorderedMapSetSeededHash and YacUnorderedMapSetSeed.
+// Combine it with YAC_UNORDERED_MAP_TREEIFY to also bound the cost of the
+// collisions that remain.
+#define YAC_UNORDERED_MAP_SEEDED (1u << 7)
+
+// Index the slot lists of the chained engine growing beyond
+// YAC_UNORDERED_MAP_TREEIFY_THRESHOLD pairs with a balanced tree ordered by the
+// hash and then by the comparison function, so that a lookup in a flooded slot
+// costs a logarithmic number of comparisons. The comparison function must then
+// order the keys like strcmp instead of only testing their equality.
+// Incremental rehashing is not available with it, and it is ignored by the
+// flat engine and the concurrent maps.
+#define YAC_UNORDERED_MAP_TREEIFY (1u << 8)
+
+// Store the pairs contiguously in a dense pair array in insertion order, and
+// locate them with an open addressing table of 32 bit entry indices. A pair
+// costs its 16 bytes plus about 6 bytes of index instead of a slot node, its
+// allocation header and a slot pointer, and iteration scans the pair array.
+// The index bits the table size does not need carry hash bits, which reject
+// most mismatching entries without touching the pairs.
+// Removal moves the last pair into the vacated entry, so the insertion order
+// holds only until the first removal, and insertion may move all the pairs.
+// This flag is ignored with YAC_UNORDERED_MAP_CONCURRENT and
+// YAC_UNORDERED_MAP_READ_MOSTLY, and overrides the other engine flags.
+#define YAC_UNORDERED_MAP_COMPACT (1u << 9)
+
+
 // The key value pair for associative data structures.
 typedef struct _YacUnorderedMapPair {
     void* key;
@@ -51,6 +135,9 @@ typedef struct _YacUnorderedMapData YacUnorderedMapData;
 // Calculate the hash of the given key.
 typedef unsigned (*YacUnorderedMapHash) (void*);
 
+// Calculate the hash of the given key keyed by the two word seed of the map.
+typedef uint64_t (*YacUnorderedMapSeededHash) (void*, const uint64_t*);
+
 // Compare the equality of two keys.
 typedef int (*YacUnorderedMapCompare) (void*, void*);
 
@@ -60,6 +147,15 @@ typedef void (*YacUnorderedMapCleanKey) (void*);
 // Value cleanup function called whenever a live entry is removed.
 typedef void (*YacUnorderedMapCleanValue) (void*);
 
+// Visit function called for each pair by the parallel bulk operations. The second
+// argument is the shard index in [0, num_thread), which lets aggregations keep
+// one accumulator per shard without locking. The third is the caller argument.
+typedef void (*YacUnorderedMapVisit) (YacUnorderedMapPair*, unsigned, void*);
+
+// Predicate function called for each pair by the parallel bulk operations, with
+// the same arguments as YacUnorderedMapVisit.
+typedef bool (*YacUnorderedMapPredicate) (YacUnorderedMapPair*, unsigned, void*);
+
 
 // The implementation for unordered map.
 typedef struct _YacUnorderedMap {
@@ -101,6 +197,18 @@ typedef struct _YacUnorderedMap {
 } YacUnorderedMap;
 
 
+// The external iterator for YacUnorderedMap.
+// The iterator is a value holding its own cursor over a range of buckets, so
+// any number of traversals can run at the same time, and disjoint bucket ranges
+// can be scanned by different threads. The members are private.
+typedef struct _YacUnorderedMapIterator {
+    YacUnorderedMapData* data_;
+    unsigned bucket_;
+    unsigned end_;
+    void* node_;
+} YacUnorderedMapIterator;
+
+
 //
 // Definition for the exported member operations
 //
@@ -108,6 +216,15 @@ typedef struct _YacUnorderedMap {
 // The constructor for YacUnorderedMap.
 YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInit(void);
 
+// The constructor for YacUnorderedMap with the storage engine and behavior
+// selected by the YAC_UNORDERED_MAP_* flags.
+// YacUnorderedMapInit is equivalent to YacUnorderedMapInitWithFlags(0).
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInitWithFlags(unsigned flags);
+
+// The constructor for YacUnorderedMap with the slot array sized up front.
+// The map can hold the designated number of pairs without rehashing.
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInitWithCapacity(unsigned flags, unsigned capacity);
+
 // The destructor for YacUnorderedMap.
 YAC_UNORDERED_MAP_API void YacUnorderedMapDeinit(YacUnorderedMap* obj);
 
@@ -128,15 +245,130 @@ YAC_UNORDERED_MAP_API bool YacUnorderedMapContain(YacUnorderedMap* self, void* k
 // Also, the cleanup functions are invoked for that removed pair.
 YAC_UNORDERED_MAP_API bool YacUnorderedMapRemove(YacUnorderedMap* self, void* key);
 
+// Return the hash of the designated key with the hash function of the map.
+// The hash can be passed to the *WithHash functions of any map sharing the
+// hash function, so that looking up the same key in several maps, or getting
+// and then putting it, hashes the key only once.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashKey(YacUnorderedMap* self, void* key);
+
+// The counterparts of put, get, contain, and remove taking the hash of the key
+// computed by YacUnorderedMapHashKey.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapPutWithHash(YacUnorderedMap* self, void* key, void* value, unsigned hash);
+YAC_UNORDERED_MAP_API void* YacUnorderedMapGetWithHash(YacUnorderedMap* self, void* key, unsigned hash);
+YAC_UNORDERED_MAP_API bool YacUnorderedMapContainWithHash(YacUnorderedMap* self, void* key, unsigned hash);
+YAC_UNORDERED_MAP_API bool YacUnorderedMapRemoveWithHash(YacUnorderedMap* self, void* key, unsigned hash);
+
+// Return the pair stored with the designated key, inserting it first if absent.
+// An inserted pair holds the key and a NULL value, and the inserted flag tells
+// the caller to fill its value. This replaces the get-then-put pattern with a
+// single probe. The value of the returned pair can be updated in place, but the
+// key must not be changed, and the pointer is only valid until the map is
+// modified. NULL is returned if the pair cannot be inserted.
+// The function requires exclusive access to the map in every mode.
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapEntry(YacUnorderedMap* self, void* key, bool* inserted);
+
+// The counterpart of YacUnorderedMapEntry taking the hash of the key.
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapEntryWithHash(YacUnorderedMap* self, void* key,
+                                                                        unsigned hash, bool* inserted);
+
 // Return the number of stored key value pairs.
 YAC_UNORDERED_MAP_API unsigned YacUnorderedMapSize(YacUnorderedMap* self);
 
+// Extend the slot array so that the map can hold the designated number of pairs
+// without rehashing. The slot array is never shrunk by this function.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapReserve(YacUnorderedMap* self, unsigned capacity);
+
+// Remove all the key value pairs, calling the cleanup functions, but keep the
+// slot array at its current size so that filling the map again does not rehash.
+// The nodes of YAC_UNORDERED_MAP_NODE_POOL are recycled into the pool. Like the
+// bulk operations, this requires exclusive access to concurrent and read-mostly maps.
+YAC_UNORDERED_MAP_API void YacUnorderedMapClear(YacUnorderedMap* self);
+
+// Shrink the slot array to the size YacUnorderedMapInitWithCapacity would pick
+// for the stored pairs, and drop the tombstones of the open addressing engines.
+// The compact engine also trims its pair array, and the node pool is released
+// once the map is empty. Return false if the smaller arrays cannot be allocated,
+// in which case the map is left valid. This requires exclusive access like
+// YacUnorderedMapClear.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapShrinkToFit(YacUnorderedMap* self);
+
+// Insert an array of key value pairs into the map.
+// This function reserves the room for all the pairs once and then inserts them
+// without checking the loading factor per pair. Pairs with a key already stored
+// in the map replace the existing ones like YacUnorderedMapPut.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapPutMany(YacUnorderedMap* self, const YacUnorderedMapPair* pairs, unsigned num_pair);
+
+// Retrieve the values corresponding to an array of keys, storing NULL for the
+// missing ones, and return the number of non-NULL values retrieved.
+// The keys are resolved in batches. A batch is hashed and its buckets are
+// prefetched before any of them is searched, so the cache misses of the keys
+// overlap instead of stalling each lookup in turn.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapGetMany(YacUnorderedMap* self, void** keys, unsigned num_key, void** values);
+
 // Initialize the map iterator.
+// This function finishes the pending incremental rehashing if there is one.
 YAC_UNORDERED_MAP_API void YacUnorderedMapFirst(YacUnorderedMap* self);
 
 // Get the key value pair pointed by the iterator and advance the iterator.
 YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapNext(YacUnorderedMap* self);
 
+// Return the number of buckets which YacUnorderedMapBeginRange splits.
+// The slot arrays being drained by incremental rehashing are also counted, so
+// the count is only valid until the map is modified.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapBucketCount(YacUnorderedMap* self);
+
+// Return an external iterator over all the key value pairs.
+// Unlike YacUnorderedMapFirst, this function does not modify the map, so it can
+// be called from concurrent readers. The map must not be modified while the
+// iterator is in use.
+YAC_UNORDERED_MAP_API YacUnorderedMapIterator YacUnorderedMapBegin(YacUnorderedMap* self);
+
+// Return an external iterator over the key value pairs stored in the buckets
+// [begin, end). Ranges splitting [0, YacUnorderedMapBucketCount) visit every
+// pair exactly once.
+YAC_UNORDERED_MAP_API YacUnorderedMapIterator YacUnorderedMapBeginRange(YacUnorderedMap* self, unsigned begin, unsigned end);
+
+// Get the key value pair pointed by the external iterator and advance the iterator.
+// Return NULL when the range is exhausted.
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapIteratorNext(YacUnorderedMapIterator* iter);
+
+// Enter a read section of a YAC_UNORDERED_MAP_READ_MOSTLY map, and return the
+// token for YacUnorderedMapReadLeave. The pairs seen inside the section are not
+// reclaimed before the section is left, so a value returned by get can be used
+// safely until then. Sections may nest, and they must be short because they
+// hold back the reclamation. The functions do nothing for the other maps.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapReadEnter(YacUnorderedMap* self);
+
+// Leave the read section entered with the designated token.
+YAC_UNORDERED_MAP_API void YacUnorderedMapReadLeave(YacUnorderedMap* self, unsigned token);
+
+// Parallel bulk operations
+//
+// The buckets are split into num_thread contiguous ranges, and each range is
+// processed on its own thread while the calling thread handles the first one.
+// The callbacks must be safe to call concurrently. Define
+// YAC_UNORDERED_MAP_NO_THREADS to process all the ranges on the calling thread.
+
+// Call the visit function for every key value pair.
+// The visit function may update the value of the pair, but must not modify the map.
+// Return false if the working memory cannot be allocated.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapForEach(YacUnorderedMap* self, YacUnorderedMapVisit func,
+                                                  void* arg, unsigned num_thread);
+
+// Return a new map holding the key value pairs matched by the predicate.
+// The new map shares the keys and values with this map, so it has the same hash
+// and comparison functions but no cleanup functions. Return NULL if the memory
+// cannot be allocated.
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapFilter(YacUnorderedMap* self, YacUnorderedMapPredicate func,
+                                                             void* arg, unsigned num_thread);
+
+// Remove the key value pairs matched by the predicate, and return the number of
+// removed pairs. The cleanup functions are invoked on the worker threads, while
+// the nodes are released on the calling thread. Return (unsigned)-1 if the working
+// memory cannot be allocated, in which case the map is left untouched.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapRemoveIf(YacUnorderedMap* self, YacUnorderedMapPredicate func,
+                                                       void* arg, unsigned num_thread);
+
 // Set the custom hash function.
 // By default, the hash function is HashMurMur32.
 YAC_UNORDERED_MAP_API void YacUnorderedMapSetHash(YacUnorderedMap* self, YacUnorderedMapHash func);
@@ -153,6 +385,118 @@ YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanKey(YacUnorderedMap* self, Yac
 // By default, no cleanup operation for value.
 YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanValue(YacUnorderedMap* self, YacUnorderedMapCleanValue func);
 
+// Set the keyed hash function of a YAC_UNORDERED_MAP_SEEDED map.
+// By default, the hash function is HashSipInt. It must be set before the first insertion.
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetSeededHash(YacUnorderedMap* self, YacUnorderedMapSeededHash func);
+
+// Replace the random seed of a YAC_UNORDERED_MAP_SEEDED map, for example with one
+// drawn from the entropy source of the platform or a fixed one for reproducible
+// runs. Return false if the map is not empty.
+// The default seed mixes the address of the map, the time, the cycle counter and
+// a process wide counter, as no portable entropy source is available.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapSetSeed(YacUnorderedMap* self, uint64_t seed0, uint64_t seed1);
+
+#ifdef YAC_UNORDERED_MAP_STATS
+
+// Statistics
+//
+// Define YAC_UNORDERED_MAP_STATS to count the probes of every get and the work
+// spent on rehashing. The counters cost a few instructions per get, so they are
+// compiled out by default. The typed maps are not instrumented.
+
+// The number of buckets of the chain length histogram. The last bucket also
+// counts the longer chains.
+#ifndef YAC_UNORDERED_MAP_STATS_NUM_BUCKET
+#define YAC_UNORDERED_MAP_STATS_NUM_BUCKET 16
+#endif
+
+// The statistics snapshot.
+// For the chained engines, histogram[i] counts the slot lists of length i and a
+// probe is a visited node. For the flat engine, histogram[i] counts the pairs
+// stored i groups away from their home group and a probe is a visited group.
+// The compact engine counts index slots the same way.
+typedef struct _YacUnorderedMapStats {
+    unsigned size;
+    unsigned num_slot;
+    double load_factor;
+    unsigned num_occupied; // The non-empty slot lists or the full flat slots.
+    unsigned max_chain;
+    unsigned histogram[YAC_UNORDERED_MAP_STATS_NUM_BUCKET];
+    uint64_t num_get;
+    uint64_t num_probe;
+    double avg_probe;
+    unsigned num_rehash;
+    uint64_t time_rehash; // In nanoseconds, including the incremental migration.
+} YacUnorderedMapStats;
+
+// The callback receiving the lines of YacUnorderedMapDumpStats.
+typedef void (*YacUnorderedMapPrint) (const char*, void*);
+
+// Take a snapshot of the statistics. The bucket figures are gathered by walking
+// the slot array, so the map must not be modified meanwhile.
+YAC_UNORDERED_MAP_API void YacUnorderedMapGetStats(YacUnorderedMap* self, YacUnorderedMapStats* stats);
+
+// Reset the get and rehash counters.
+YAC_UNORDERED_MAP_API void YacUnorderedMapResetStats(YacUnorderedMap* self);
+
+// Take a snapshot of the statistics and pass it to the callback line by line.
+YAC_UNORDERED_MAP_API void YacUnorderedMapDumpStats(YacUnorderedMap* self, YacUnorderedMapPrint func, void* arg);
+
+#endif // YAC_UNORDERED_MAP_STATS
+
+
+// Snapshot
+//
+// A map can be saved to a flat file and opened again as a read-only view, which
+// maps the file into memory and looks the keys up in place. Opening a view costs
+// the same for any map size, and the pages of the file are shared by all the
+// processes viewing it. The keys and values are stored as the byte strings
+// produced by the encoder callbacks, and are indexed by the HashWy64 of the key
+// bytes, so the view needs neither the hash nor the comparison function of the
+// map. The file is position independent, but records the byte order of the
+// writer and is rejected on machines of the other order.
+
+// Encode the key or value in the first argument into the buffer in the second,
+// and return the encoded size in bytes. With a NULL buffer, only return the size.
+// The third argument is the caller argument.
+typedef size_t (*YacUnorderedMapEncode) (void*, void*, void*);
+
+// The read-only view of a saved map. The view is never modified, so it can be
+// read from concurrent threads.
+typedef struct _YacUnorderedMapView YacUnorderedMapView;
+
+// Save the map to the file at the designated path, replacing the file. Distinct
+// keys must have distinct encodings, and the map must not be modified meanwhile.
+// Return false if an encoding exceeds 4 GiB or the file cannot be written, in
+// which case the file is removed. Write to a temporary path and rename it to
+// replace a file being viewed by other processes.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapSave(YacUnorderedMap* self, const char* path, YacUnorderedMapEncode func_key,
+                                               YacUnorderedMapEncode func_value, void* arg);
+
+// Open the file saved by YacUnorderedMapSave as a view. Return NULL if the file
+// cannot be opened or is not a valid snapshot.
+// The file is mapped with MapViewOfFile or mmap. On other platforms, or with
+// YAC_UNORDERED_MAP_NO_MMAP defined, it is read into memory instead.
+YAC_UNORDERED_MAP_API YacUnorderedMapView* YacUnorderedMapViewInit(const char* path);
+
+// Open the snapshot held in the designated buffer, such as one embedded in the
+// program. The buffer must be aligned to 8 bytes and outlive the view.
+YAC_UNORDERED_MAP_API YacUnorderedMapView* YacUnorderedMapViewInitWithBuffer(const void* buf, size_t size);
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapViewDeinit(YacUnorderedMapView* obj);
+
+// Retrieve the value bytes stored for the designated key bytes, and store their
+// size in value_size unless it is NULL. Return NULL if the key is absent.
+// The value is aligned to 8 bytes and stays valid until the view is closed.
+YAC_UNORDERED_MAP_API const void* YacUnorderedMapViewGet(YacUnorderedMapView* self, const void* key, size_t key_size,
+                                                         size_t* value_size);
+
+// Check if the view contains the designated key bytes.
+YAC_UNORDERED_MAP_API bool YacUnorderedMapViewContain(YacUnorderedMapView* self, const void* key, size_t key_size);
+
+// Return the number of key value pairs in the view.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapViewSize(YacUnorderedMapView* self);
+
 
 // Non-cryptographic hash function
 
@@ -165,6 +509,492 @@ YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashMurMur32(void* key, size_t siz
 // http://www.cse.yorku.ca/~oz/hash.html
 YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashDjb2(char* key);
 
+// 64 bit hash function following the construction of wyhash final4 by Wang Yi.
+// Every round folds 16 bytes with a 64x64 to 128 bit multiplication, and keys
+// of at least 48 bytes run three independent lanes. Keys up to 16 bytes are
+// read with at most four overlapping loads and no byte loop.
+// https://github.com/wangyi-fudan/wyhash
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashWy64(void* key, size_t size, uint64_t seed);
+
+// HashWy64 with zero seed folded to 32 bits, with the signature of HashMurMur32.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashWy32(void* key, size_t size);
+
+// CRC32C (Castagnoli) of the key. It runs on the crc32 instruction when the
+// compiler targets SSE4.2 or the ARMv8 CRC extension, and on a portable table
+// otherwise. Being linear, it suits trusted keys only.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashCrc32c(void* key, size_t size);
+
+// HashWy32 and HashWy64 of null-terminated string keys. HashString matches
+// YacUnorderedMapHash, so it can be passed to YacUnorderedMapSetHash.
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashString(void* key);
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashString64(void* key);
+
+// Keyed hash functions
+
+// SipHash proposed by Jean-Philippe Aumasson and Daniel J. Bernstein in 2012,
+// keyed by a 128 bit seed. SipHash-2-4 is the conservative original, and
+// SipHash-1-3 is the faster variant adopted by hash table implementations.
+// https://www.aumasson.jp/siphash/siphash.pdf
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSip13(void* key, size_t size, const uint64_t* seed);
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSip24(void* key, size_t size, const uint64_t* seed);
+
+// HashSip13 of the key pointer value and of a null-terminated string key, with
+// the YacUnorderedMapSeededHash signature.
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSipInt(void* key, const uint64_t* seed);
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSipString(void* key, const uint64_t* seed);
+
+
+//
+// Definition for the flat engine primitives
+//
+// These are shared by the YAC_UNORDERED_MAP_FLAT engine and the typed maps
+// generated with YAC_UNORDERED_MAP_DEFINE, so they are visible without
+// YAC_UNORDERED_MAP_IMPLEMENTATION.
+//
+
+#include <stdlib.h> // malloc, free
+
+#if defined(_MSC_VER)
+#include <intrin.h> // _BitScanForward
+#endif
+
+// The group matching kernel is chosen at compile time. AVX2 matches 32 control
+// bytes per instruction and SSE2 matches 16. Define YAC_UNORDERED_MAP_NO_SIMD
+// to force the portable scalar kernel.
+#if !defined(YAC_UNORDERED_MAP_NO_SIMD) && defined(__AVX2__)
+#define YAC_UNORDERED_MAP_AVX2
+#include <immintrin.h>
+#elif !defined(YAC_UNORDERED_MAP_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define YAC_UNORDERED_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+// The control bytes of the flat engine and the typed maps are allocated with
+// YAC_UNORDERED_MAP_MALLOC, which defaults to malloc.
+#ifndef YAC_UNORDERED_MAP_MALLOC
+#define YAC_UNORDERED_MAP_MALLOC malloc
+#endif
+
+#ifndef YAC_UNORDERED_MAP_FREE
+#define YAC_UNORDERED_MAP_FREE free
+#endif
+
+// The flat engine probes the control bytes one group at a time. The slot count
+// is always a power of two and a multiple of the group width.
+#ifdef YAC_UNORDERED_MAP_AVX2
+#define YAC_UNORDERED_MAP_GROUP_WIDTH 32
+#else
+#define YAC_UNORDERED_MAP_GROUP_WIDTH 16
+#endif
+#define YAC_UNORDERED_MAP_FLAT_INIT_SLOT 512
+
+// The control byte of a flat slot. A full slot stores the low 7 bits of the
+// mixed hash so that most mismatches are rejected without comparing the keys.
+#define YAC_UNORDERED_MAP_CTRL_EMPTY 0x80
+#define YAC_UNORDERED_MAP_CTRL_DELETED 0xFE
+#define YAC_UNORDERED_MAP_CTRL_IS_FULL(ctrl) ((ctrl) < 0x80)
+
+// Scramble the user hash so that the low and high bits are both usable.
+static inline unsigned YacUnorderedMapMix_(unsigned hash)
+{
+    // The MurMur3 finalizer.
+    hash ^= (hash >> 16);
+    hash *= 0x85ebca6b;
+    hash ^= (hash >> 13);
+    hash *= 0xc2b2ae35;
+    hash ^= (hash >> 16);
+    return hash;
+}
+
+// Return the index of the lowest set bit of the non-zero mask.
+static inline unsigned YacUnorderedMapCtz_(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (unsigned)idx;
+#elif defined(__GNUC__)
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned idx = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++idx;
+    }
+    return idx;
+#endif
+}
+
+#if defined(YAC_UNORDERED_MAP_AVX2)
+
+// Return the bit mask of the group slots whose control byte equals the tag.
+static inline unsigned YacUnorderedMapGroupMatch_(const unsigned char* group, unsigned char tag)
+{
+    __m256i ctrl = _mm256_loadu_si256((const __m256i*)group);
+    __m256i match = _mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8((char)tag));
+    return (unsigned)_mm256_movemask_epi8(match);
+}
+
+// Return the bit mask of the empty or deleted group slots.
+static inline unsigned YacUnorderedMapGroupMatchEmptyOrDeleted_(const unsigned char* group)
+{
+    // Only the empty and deleted control bytes have the sign bit set.
+    __m256i ctrl = _mm256_loadu_si256((const __m256i*)group);
+    return (unsigned)_mm256_movemask_epi8(ctrl);
+}
+
+#elif defined(YAC_UNORDERED_MAP_SSE2)
+
+// Return the bit mask of the group slots whose control byte equals the tag.
+static inline unsigned YacUnorderedMapGroupMatch_(const unsigned char* group, unsigned char tag)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    __m128i match = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag));
+    return (unsigned)_mm_movemask_epi8(match);
+}
+
+// Return the bit mask of the empty or deleted group slots.
+static inline unsigned YacUnorderedMapGroupMatchEmptyOrDeleted_(const unsigned char* group)
+{
+    // Only the empty and deleted control bytes have the sign bit set.
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (unsigned)_mm_movemask_epi8(ctrl);
+}
+
+#else
+
+// Return the bit mask of the group slots whose control byte equals the tag.
+static inline unsigned YacUnorderedMapGroupMatch_(const unsigned char* group, unsigned char tag)
+{
+    unsigned mask = 0;
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i) {
+        if (group[i] == tag)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+// Return the bit mask of the empty or deleted group slots.
+static inline unsigned YacUnorderedMapGroupMatchEmptyOrDeleted_(const unsigned char* group)
+{
+    unsigned mask = 0;
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_GROUP_WIDTH ; ++i) {
+        if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(group[i]))
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+#endif // YAC_UNORDERED_MAP_AVX2
+
+// Return the bit mask of the empty group slots.
+static inline unsigned YacUnorderedMapGroupMatchEmpty_(const unsigned char* group)
+{
+    return YacUnorderedMapGroupMatch_(group, YAC_UNORDERED_MAP_CTRL_EMPTY);
+}
+
+// Return the smallest flat slot count that holds the designated number of pairs.
+// The flat engine keeps one eighth of the slots empty.
+static inline unsigned YacUnorderedMapFlatFitSlot_(unsigned capacity)
+{
+    unsigned num_slot = YAC_UNORDERED_MAP_FLAT_INIT_SLOT;
+    while (num_slot - num_slot / 8 < capacity && num_slot < (1u << 31))
+        num_slot *= 2;
+    return num_slot;
+}
+
+// Return the slot count to rebuild with once the growth budget is used up.
+// Doubling is skipped when most of the used slots are tombstones left by removal,
+// and it stops at 2^31 slots like YacUnorderedMapFlatFitSlot_. Return 0 if the
+// slots are full at that size and a rebuild would reclaim nothing.
+static inline unsigned YacUnorderedMapFlatGrowSlot_(unsigned size, unsigned num_slot, unsigned curr_limit)
+{
+    if (size <= curr_limit / 2)
+        return num_slot;
+    if (num_slot < (1u << 31))
+        return num_slot * 2;
+    return (size < curr_limit)? num_slot : 0;
+}
+
+// Allocate a control byte array with all the slots empty.
+static inline unsigned char* YacUnorderedMapFlatAllocCtrl_(unsigned num_slot)
+{
+    unsigned char* arr_ctrl = YAC_UNORDERED_MAP_MALLOC(sizeof(unsigned char) * num_slot);
+    if (!arr_ctrl)
+        return NULL;
+
+    unsigned i;
+    for (i = 0 ; i < num_slot ; ++i)
+        arr_ctrl[i] = YAC_UNORDERED_MAP_CTRL_EMPTY;
+    return arr_ctrl;
+}
+
+// Return the first empty or deleted slot on the probe sequence of the hash.
+static inline unsigned YacUnorderedMapFlatFindFree_(const unsigned char* arr_ctrl, unsigned num_slot, unsigned hash)
+{
+    unsigned mask_group = num_slot / YAC_UNORDERED_MAP_GROUP_WIDTH - 1;
+    unsigned idx_group = (hash >> 7) & mask_group;
+    unsigned step = 0;
+
+    while (true) {
+        unsigned base = idx_group * YAC_UNORDERED_MAP_GROUP_WIDTH;
+        unsigned match = YacUnorderedMapGroupMatchEmptyOrDeleted_(arr_ctrl + base);
+        if (match)
+            return base + YacUnorderedMapCtz_(match);
+
+        ++step;
+        idx_group = (idx_group + step) & mask_group;
+    }
+}
+
+// Release the full slot. Return true if the slot became empty, and false if it
+// was left as a tombstone.
+static inline bool YacUnorderedMapFlatErase_(unsigned char* arr_ctrl, unsigned idx)
+{
+    // If the group still has an empty slot, no probe sequence has passed through
+    // it, so the slot can be emptied directly. Otherwise leave a tombstone.
+    unsigned base = idx - idx % YAC_UNORDERED_MAP_GROUP_WIDTH;
+    if (YacUnorderedMapGroupMatchEmpty_(arr_ctrl + base)) {
+        arr_ctrl[idx] = YAC_UNORDERED_MAP_CTRL_EMPTY;
+        return true;
+    }
+    arr_ctrl[idx] = YAC_UNORDERED_MAP_CTRL_DELETED;
+    return false;
+}
+
+
+//
+// Definition for the typed unordered map
+//
+
+// Generate an unordered map type called name which stores the keys of type K
+// and the values of type V inline, without the void* boxing of YacUnorderedMap.
+// HASH(key) returns the unsigned hash of a key, and EQ(lhs, rhs) returns
+// non-zero if two keys are equal. Both are expanded at the call sites, so they
+// can be macros or functions and get inlined by the compiler. The map uses the
+// flat engine layout and probing of YAC_UNORDERED_MAP_FLAT.
+//
+// Expand the macro once per translation unit, without a trailing semicolon:
+//
+//   #define IntHash(key) ((unsigned)(key))
+//   #define IntEq(lhs, rhs) ((lhs) == (rhs))
+//   YAC_UNORDERED_MAP_DEFINE(IntMap, int, int, IntHash, IntEq)
+//
+// It generates the following operations:
+//
+//   name* nameInit(void);
+//   void nameDeinit(name* obj);
+//   bool namePut(name* self, K key, V value);
+//   V* nameGet(name* self, K key);             // NULL if the key is absent
+//   bool nameContain(name* self, K key);
+//   bool nameRemove(name* self, K key);
+//   unsigned nameSize(name* self);
+//   bool nameReserve(name* self, unsigned capacity);
+//   void nameFirst(name* self);
+//   namePair* nameNext(name* self);            // NULL at the end
+//
+// The pointers returned by nameGet and nameNext are invalidated by the next put
+// or reserve.
+#define YAC_UNORDERED_MAP_DEFINE(name, K, V, HASH, EQ)                                                           \
+                                                                                                                 \
+typedef struct _##name##Pair {                                                                                   \
+    K key;                                                                                                       \
+    V value;                                                                                                     \
+} name##Pair;                                                                                                    \
+                                                                                                                 \
+typedef struct _##name {                                                                                         \
+    unsigned size_;                                                                                              \
+    unsigned num_slot_;                                                                                          \
+    unsigned curr_limit_;                                                                                        \
+    unsigned growth_left_;                                                                                       \
+    unsigned iter_slot_;                                                                                         \
+    unsigned char* arr_ctrl_;                                                                                    \
+    name##Pair* arr_pair_;                                                                                       \
+} name;                                                                                                          \
+                                                                                                                 \
+static inline bool name##Alloc_(name* self, unsigned num_slot)                                                   \
+{                                                                                                                \
+    unsigned char* arr_ctrl = YacUnorderedMapFlatAllocCtrl_(num_slot);                                           \
+    if (!arr_ctrl)                                                                                               \
+        return false;                                                                                            \
+                                                                                                                 \
+    name##Pair* arr_pair = YAC_UNORDERED_MAP_MALLOC(sizeof(name##Pair) * num_slot);                              \
+    if (!arr_pair) {                                                                                             \
+        YAC_UNORDERED_MAP_FREE(arr_ctrl);                                                                        \
+        return false;                                                                                            \
+    }                                                                                                            \
+                                                                                                                 \
+    self->arr_ctrl_ = arr_ctrl;                                                                                  \
+    self->arr_pair_ = arr_pair;                                                                                  \
+    self->num_slot_ = num_slot;                                                                                  \
+    self->curr_limit_ = num_slot - num_slot / 8;                                                                 \
+    self->growth_left_ = self->curr_limit_ - self->size_;                                                        \
+    return true;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline unsigned name##Find_(name* self, K key, unsigned hash)                                             \
+{                                                                                                                \
+    unsigned char tag = (unsigned char)(hash & 0x7f);                                                            \
+    unsigned mask_group = self->num_slot_ / YAC_UNORDERED_MAP_GROUP_WIDTH - 1;                                   \
+    unsigned idx_group = (hash >> 7) & mask_group;                                                               \
+    unsigned step = 0;                                                                                           \
+                                                                                                                 \
+    unsigned char* arr_ctrl = self->arr_ctrl_;                                                                   \
+    name##Pair* arr_pair = self->arr_pair_;                                                                      \
+    while (true) {                                                                                               \
+        unsigned base = idx_group * YAC_UNORDERED_MAP_GROUP_WIDTH;                                               \
+        unsigned match = YacUnorderedMapGroupMatch_(arr_ctrl + base, tag);                                       \
+        while (match) {                                                                                          \
+            unsigned idx = base + YacUnorderedMapCtz_(match);                                                    \
+            if (EQ(key, arr_pair[idx].key))                                                                      \
+                return idx;                                                                                      \
+            match &= match - 1;                                                                                  \
+        }                                                                                                        \
+                                                                                                                 \
+        if (YacUnorderedMapGroupMatchEmpty_(arr_ctrl + base))                                                    \
+            return self->num_slot_;                                                                              \
+                                                                                                                 \
+        ++step;                                                                                                  \
+        if (step > mask_group)                                                                                   \
+            return self->num_slot_;                                                                              \
+        idx_group = (idx_group + step) & mask_group;                                                             \
+    }                                                                                                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool name##ReHash_(name* self, unsigned num_slot_new)                                              \
+{                                                                                                                \
+    unsigned char* arr_ctrl = self->arr_ctrl_;                                                                   \
+    name##Pair* arr_pair = self->arr_pair_;                                                                      \
+    unsigned num_slot = self->num_slot_;                                                                         \
+                                                                                                                 \
+    if (!name##Alloc_(self, num_slot_new))                                                                       \
+        return false;                                                                                            \
+                                                                                                                 \
+    unsigned i;                                                                                                  \
+    for (i = 0 ; i < num_slot ; ++i) {                                                                           \
+        if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[i]))                                                        \
+            continue;                                                                                            \
+        unsigned hash = YacUnorderedMapMix_(HASH(arr_pair[i].key));                                              \
+        unsigned idx = YacUnorderedMapFlatFindFree_(self->arr_ctrl_, self->num_slot_, hash);                     \
+        self->arr_ctrl_[idx] = (unsigned char)(hash & 0x7f);                                                     \
+        self->arr_pair_[idx] = arr_pair[i];                                                                      \
+    }                                                                                                            \
+                                                                                                                 \
+    YAC_UNORDERED_MAP_FREE(arr_ctrl);                                                                            \
+    YAC_UNORDERED_MAP_FREE(arr_pair);                                                                            \
+    return true;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline name* name##Init(void)                                                                             \
+{                                                                                                                \
+    name* obj = YAC_UNORDERED_MAP_MALLOC(sizeof(name));                                                          \
+    if (!obj)                                                                                                    \
+        return NULL;                                                                                             \
+                                                                                                                 \
+    obj->size_ = 0;                                                                                              \
+    obj->iter_slot_ = 0;                                                                                         \
+    if (!name##Alloc_(obj, YAC_UNORDERED_MAP_FLAT_INIT_SLOT)) {                                                  \
+        YAC_UNORDERED_MAP_FREE(obj);                                                                             \
+        return NULL;                                                                                             \
+    }                                                                                                            \
+    return obj;                                                                                                  \
+}                                                                                                                \
+                                                                                                                 \
+static inline void name##Deinit(name* obj)                                                                       \
+{                                                                                                                \
+    if (!obj)                                                                                                    \
+        return;                                                                                                  \
+                                                                                                                 \
+    YAC_UNORDERED_MAP_FREE(obj->arr_ctrl_);                                                                      \
+    YAC_UNORDERED_MAP_FREE(obj->arr_pair_);                                                                      \
+    YAC_UNORDERED_MAP_FREE(obj);                                                                                 \
+    return;                                                                                                      \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool name##Put(name* self, K key, V value)                                                         \
+{                                                                                                                \
+    unsigned hash = YacUnorderedMapMix_(HASH(key));                                                              \
+    unsigned idx = name##Find_(self, key, hash);                                                                 \
+    if (idx != self->num_slot_) {                                                                                \
+        self->arr_pair_[idx].value = value;                                                                      \
+        return true;                                                                                             \
+    }                                                                                                            \
+                                                                                                                 \
+    if (self->growth_left_ == 0) {                                                                               \
+        unsigned num_slot_new = YacUnorderedMapFlatGrowSlot_(self->size_, self->num_slot_, self->curr_limit_);   \
+        if (num_slot_new == 0 || !name##ReHash_(self, num_slot_new))                                             \
+            return false;                                                                                        \
+    }                                                                                                            \
+                                                                                                                 \
+    idx = YacUnorderedMapFlatFindFree_(self->arr_ctrl_, self->num_slot_, hash);                                  \
+    if (self->arr_ctrl_[idx] == YAC_UNORDERED_MAP_CTRL_EMPTY)                                                    \
+        --(self->growth_left_);                                                                                  \
+    self->arr_ctrl_[idx] = (unsigned char)(hash & 0x7f);                                                         \
+    self->arr_pair_[idx].key = key;                                                                              \
+    self->arr_pair_[idx].value = value;                                                                          \
+    ++(self->size_);                                                                                             \
+    return true;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline V* name##Get(name* self, K key)                                                                    \
+{                                                                                                                \
+    unsigned idx = name##Find_(self, key, YacUnorderedMapMix_(HASH(key)));                                       \
+    if (idx != self->num_slot_)                                                                                  \
+        return &(self->arr_pair_[idx].value);                                                                    \
+    return NULL;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool name##Contain(name* self, K key)                                                              \
+{                                                                                                                \
+    return name##Find_(self, key, YacUnorderedMapMix_(HASH(key))) != self->num_slot_;                            \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool name##Remove(name* self, K key)                                                               \
+{                                                                                                                \
+    unsigned idx = name##Find_(self, key, YacUnorderedMapMix_(HASH(key)));                                       \
+    if (idx == self->num_slot_)                                                                                  \
+        return false;                                                                                            \
+                                                                                                                 \
+    if (YacUnorderedMapFlatErase_(self->arr_ctrl_, idx))                                                         \
+        ++(self->growth_left_);                                                                                  \
+    --(self->size_);                                                                                             \
+    return true;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+static inline unsigned name##Size(name* self)                                                                    \
+{                                                                                                                \
+    return self->size_;                                                                                          \
+}                                                                                                                \
+                                                                                                                 \
+static inline bool name##Reserve(name* self, unsigned capacity)                                                  \
+{                                                                                                                \
+    if (capacity <= self->size_ + self->growth_left_)                                                            \
+        return true;                                                                                             \
+                                                                                                                 \
+    unsigned num_slot_new = YacUnorderedMapFlatFitSlot_(capacity);                                               \
+    if (num_slot_new < self->num_slot_)                                                                          \
+        num_slot_new = self->num_slot_;                                                                          \
+    return name##ReHash_(self, num_slot_new);                                                                    \
+}                                                                                                                \
+                                                                                                                 \
+static inline void name##First(name* self)                                                                       \
+{                                                                                                                \
+    self->iter_slot_ = 0;                                                                                        \
+    return;                                                                                                      \
+}                                                                                                                \
+                                                                                                                 \
+static inline name##Pair* name##Next(name* self)                                                                 \
+{                                                                                                                \
+    while (self->iter_slot_ < self->num_slot_) {                                                                 \
+        unsigned idx = (self->iter_slot_)++;                                                                     \
+        if (YAC_UNORDERED_MAP_CTRL_IS_FULL(self->arr_ctrl_[idx]))                                                \
+            return &(self->arr_pair_[idx]);                                                                      \
+    }                                                                                                            \
+    return NULL;                                                                                                 \
+}
+
 
 #endif // YAC_UNORDERED_MAP_H_
 
@@ -176,8 +1006,12 @@ YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashDjb2(char* key);
 #ifdef YAC_UNORDERED_MAP_IMPLEMENTATION
 
 
+#include <limits.h> // UINT_MAX
 #include <stdint.h> // utf8_t
 #include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, strlen
+#include <time.h> // time, clock, timespec_get
+#include <stdio.h> // snprintf, fopen, fwrite
 
 #ifndef YAC_ORDERED_MAP_MALLOC
 #define YAC_ORDERED_MAP_MALLOC malloc
@@ -187,6 +1021,39 @@ YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashDjb2(char* key);
 #define YAC_ORDERED_MAP_FREE free
 #endif
 
+// CRC32C runs on the crc32 instruction of SSE4.2 or of the ARMv8 CRC extension.
+#if !defined(YAC_UNORDERED_MAP_NO_SIMD) && (defined(__SSE4_2__) || (defined(_MSC_VER) && defined(__AVX__)))
+#define YAC_UNORDERED_MAP_CRC32C_SSE42
+#include <nmmintrin.h> // _mm_crc32_u8, _mm_crc32_u32, _mm_crc32_u64
+#elif !defined(YAC_UNORDERED_MAP_NO_SIMD) && (defined(__ARM_FEATURE_CRC32) || defined(_M_ARM64))
+#define YAC_UNORDERED_MAP_CRC32C_ARM
+#if !defined(_MSC_VER)
+#include <arm_acle.h> // __crc32cb, __crc32cd
+#endif
+#endif
+
+// The parallel bulk operations run their shards on Win32 threads or pthreads.
+#if !defined(YAC_UNORDERED_MAP_NO_THREADS) && defined(_WIN32)
+#define YAC_UNORDERED_MAP_THREADS_WIN32
+#include <windows.h> // WaitForSingleObject, CloseHandle
+#include <process.h> // _beginthreadex
+#elif !defined(YAC_UNORDERED_MAP_NO_THREADS)
+#define YAC_UNORDERED_MAP_THREADS_PTHREAD
+#include <pthread.h> // pthread_create, pthread_join, pthread_mutex_t
+#endif
+
+// The snapshot views map their files with Win32 or POSIX file mappings.
+#if !defined(YAC_UNORDERED_MAP_NO_MMAP) && defined(_WIN32)
+#define YAC_UNORDERED_MAP_MMAP_WIN32
+#include <windows.h> // CreateFileMappingA, MapViewOfFile, UnmapViewOfFile
+#elif !defined(YAC_UNORDERED_MAP_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define YAC_UNORDERED_MAP_MMAP_POSIX
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+#endif
+
 
 //
 // The container private data
@@ -201,13 +1068,136 @@ static const unsigned yac_unordered_map_magic_primes[] = {
 static const int yac_unordered_map_num_prime = sizeof(yac_unordered_map_magic_primes) / sizeof(unsigned);
 static const double yac_unordered_map_load_factor = 0.75;
 
+// The initial slot count of the power of two sizing.
+#define YAC_UNORDERED_MAP_POW2_INIT_SLOT 1024
+
+// The number of nodes carved out of each node pool chunk.
+#ifndef YAC_UNORDERED_MAP_POOL_CHUNK
+#define YAC_UNORDERED_MAP_POOL_CHUNK 1024
+#endif
+
+// The number of lock stripes of the concurrent map. It must be a power of two
+// not greater than YAC_UNORDERED_MAP_POW2_INIT_SLOT.
+#ifndef YAC_UNORDERED_MAP_NUM_STRIPE
+#define YAC_UNORDERED_MAP_NUM_STRIPE 64
+#endif
+
+// The number of reader slots of the read-mostly map. The reader threads are
+// spread over the slots, and threads sharing a slot share its cache line.
+#ifndef YAC_UNORDERED_MAP_NUM_READER
+#define YAC_UNORDERED_MAP_NUM_READER 64
+#endif
+
+// The stripes and reader slots are padded to a cache line so that they do not share one.
+#define YAC_UNORDERED_MAP_CACHE_LINE 64
+
+#if defined(_MSC_VER)
+#define YAC_UNORDERED_MAP_THREAD_LOCAL __declspec(thread)
+#else
+#define YAC_UNORDERED_MAP_THREAD_LOCAL _Thread_local
+#endif
+
+// The maximum number of shards used by the parallel bulk operations.
+#ifndef YAC_UNORDERED_MAP_MAX_SHARD
+#define YAC_UNORDERED_MAP_MAX_SHARD 64
+#endif
+
+// The number of keys whose buckets are prefetched together by YacUnorderedMapGetMany.
+#ifndef YAC_UNORDERED_MAP_PREFETCH_BATCH
+#define YAC_UNORDERED_MAP_PREFETCH_BATCH 16
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define YAC_UNORDERED_MAP_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+#define YAC_UNORDERED_MAP_PREFETCH(ptr) __prefetch((const void*)(ptr))
+#elif defined(__GNUC__)
+#define YAC_UNORDERED_MAP_PREFETCH(ptr) __builtin_prefetch((ptr))
+#else
+#define YAC_UNORDERED_MAP_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+// The slot list length from which YAC_UNORDERED_MAP_TREEIFY indexes the list with a tree.
+#ifndef YAC_UNORDERED_MAP_TREEIFY_THRESHOLD
+#define YAC_UNORDERED_MAP_TREEIFY_THRESHOLD 8
+#endif
+
+// The number of old slots migrated by each operation during incremental rehashing.
+#ifndef YAC_UNORDERED_MAP_REHASH_STEP
+#define YAC_UNORDERED_MAP_REHASH_STEP 64
+#endif
+
+
+
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+typedef SRWLOCK YacUnorderedMapLock;
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+typedef pthread_mutex_t YacUnorderedMapLock;
+#else
+typedef int YacUnorderedMapLock;
+#endif
+
+// A lock stripe of the concurrent map. size_ counts the pairs inserted minus
+// the pairs removed through this stripe since the last gathering.
+typedef union _YacUnorderedMapStripe {
+    struct {
+        YacUnorderedMapLock lock_;
+        int size_;
+    } s_;
+    char pad_[YAC_UNORDERED_MAP_CACHE_LINE];
+} YacUnorderedMapStripe;
 
 typedef struct _YacUnorderedMapSlotNode {
     YacUnorderedMapPair pair_;
     struct _YacUnorderedMapSlotNode* next_;
+    // Only allocated and valid with YAC_UNORDERED_MAP_CACHE_HASH.
+    unsigned hash_;
 } YacUnorderedMapSlotNode;
 
+// The AVL tree node indexing a slot list node of a treeified slot. The tree
+// nodes are also linked in the order of the slot list, so that a node found in
+// the tree can be unlinked from the list without walking it.
+typedef struct _YacUnorderedMapTreeNode {
+    struct _YacUnorderedMapTreeNode* left_;
+    struct _YacUnorderedMapTreeNode* right_;
+    struct _YacUnorderedMapTreeNode* prev_;
+    struct _YacUnorderedMapTreeNode* next_;
+    YacUnorderedMapSlotNode* node_;
+    unsigned hash_;
+    int height_;
+} YacUnorderedMapTreeNode;
+
+// The tree of a treeified slot, with the tree node of the slot list head.
+typedef struct _YacUnorderedMapBin {
+    YacUnorderedMapTreeNode* root_;
+    YacUnorderedMapTreeNode* head_;
+} YacUnorderedMapBin;
+
+// The slot array published to the readers of the read-mostly map.
+typedef struct _YacUnorderedMapTable {
+    unsigned num_slot_;
+    YacUnorderedMapSlotNode** arr_slot_;
+} YacUnorderedMapTable;
+
+// A reader slot of the read-mostly map. cnt_[i] counts the readers inside a
+// read section entered in an epoch congruent to i modulo 3.
+typedef union _YacUnorderedMapReader {
+    volatile long cnt_[3];
+    char pad_[YAC_UNORDERED_MAP_CACHE_LINE];
+} YacUnorderedMapReader;
+
+// An object retired by a writer of the read-mostly map. It is either a node
+// whose pair is cleaned on reclamation, or a slot array replaced by growing
+// together with the node copies it links.
+typedef struct _YacUnorderedMapRetired {
+    struct _YacUnorderedMapRetired* next_;
+    YacUnorderedMapSlotNode* node_;
+    YacUnorderedMapTable* table_;
+} YacUnorderedMapRetired;
+
 struct _YacUnorderedMapData {
+    unsigned flags_;
+    unsigned node_size_;
     int size_;
     int idx_prime_;
     unsigned num_slot_;
@@ -216,9 +1206,142 @@ struct _YacUnorderedMapData {
     YacUnorderedMapSlotNode** arr_slot_;
     YacUnorderedMapSlotNode* iter_node_;
     YacUnorderedMapHash func_hash_;
+    YacUnorderedMapSeededHash func_seeded_;
+    uint64_t seed_[2];
     YacUnorderedMapCompare func_cmp_;
     YacUnorderedMapCleanKey func_clean_key_;
     YacUnorderedMapCleanValue func_clean_val_;
+
+    // The slot array being drained by incremental rehashing. The old slots
+    // before idx_migrate_ are empty, and the others are still searched.
+    unsigned num_slot_old_;
+    unsigned idx_migrate_;
+    YacUnorderedMapSlotNode** arr_slot_old_;
+
+    // The node pool. Each chunk starts with the link to the previous chunk,
+    // and pool_used_ nodes of the newest chunk are handed out. Recycled nodes
+    // are linked through their first word.
+    void* pool_chunk_;
+    void* pool_free_;
+    unsigned pool_used_;
+
+    // The trees of the treeified slots, parallel to the slot array. The array
+    // is allocated when the first slot is treeified.
+    YacUnorderedMapBin** arr_bin_;
+    unsigned num_bin_;
+
+    // The lock stripes of the concurrent map.
+    YacUnorderedMapStripe* arr_stripe_;
+
+    // The read-mostly map. Readers load table_ and announce themselves in
+    // arr_reader_ without locking. Writers hold lock_writer_, and keep the
+    // retired objects in the limbo list of the retirement epoch modulo 3 until
+    // epoch_ has advanced twice.
+    YacUnorderedMapTable* table_;
+    YacUnorderedMapReader* arr_reader_;
+    volatile long epoch_;
+    YacUnorderedMapRetired* limbo_[3];
+    YacUnorderedMapLock lock_writer_;
+
+    // The flat engine keeps one control byte and one pair per slot.
+    // curr_limit_ is the maximum load, and growth_left_ counts the empty
+    // slots that may still be consumed before the arrays are rebuilt.
+    unsigned growth_left_;
+    unsigned char* arr_ctrl_;
+    YacUnorderedMapPair* arr_pair_;
+
+    // The compact engine keeps size_ pairs at the front of arr_pair_, which
+    // holds cap_entry_ pairs, and indexes them with num_slot_ index slots.
+    // curr_limit_ and growth_left_ work like those of the flat engine.
+    uint32_t* arr_index_;
+    unsigned cap_entry_;
+
+#ifdef YAC_UNORDERED_MAP_STATS
+    // The counters of the statistics. The get counters are updated atomically
+    // as gets may run in parallel, and the rehash counters are updated with
+    // exclusive access only.
+    volatile long long stat_num_get_;
+    volatile long long stat_num_probe_;
+    unsigned stat_num_rehash_;
+    uint64_t stat_time_rehash_;
+#endif
+};
+
+// The parallel bulk operations.
+enum {
+    YAC_UNORDERED_MAP_SHARD_FOR_EACH,
+    YAC_UNORDERED_MAP_SHARD_FILTER,
+    YAC_UNORDERED_MAP_SHARD_REMOVE_IF,
+};
+
+// The work of one thread in a parallel bulk operation. The bucket range is
+// [begin_, end_), and the results are merged by the calling thread.
+typedef struct _YacUnorderedMapShard {
+    YacUnorderedMapData* data_;
+    int op_;
+    unsigned idx_;
+    unsigned begin_;
+    unsigned end_;
+    YacUnorderedMapVisit func_visit_;
+    YacUnorderedMapPredicate func_pred_;
+    void* arg_;
+
+    // The pairs matched by the filter.
+    bool fail_;
+    unsigned num_pair_;
+    unsigned cap_pair_;
+    YacUnorderedMapPair* arr_pair_;
+
+    // The pairs removed by remove-if. The nodes are linked through next_, and
+    // num_emptied_ counts the flat slots which became empty.
+    unsigned num_removed_;
+    unsigned num_emptied_;
+    YacUnorderedMapSlotNode* removed_;
+
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+    HANDLE thread_;
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+    pthread_t thread_;
+#endif
+    bool spawned_;
+} YacUnorderedMapShard;
+
+// The snapshot file starts with the header, followed by the records and then by
+// the slot table at off_slot_. A record holds the key size and the value size
+// as uint32_t, then the key bytes and the value bytes, each padded to 8 bytes.
+// The slot table is probed linearly from the HashWy64 of the key bytes with
+// zero seed. An empty slot is zero, and a used one stores the record offset
+// divided by 8 in the low 40 bits and the top 24 hash bits above them.
+typedef struct _YacUnorderedMapSnapshot {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t order_;
+    uint64_t num_pair_;
+    uint64_t num_slot_;
+    uint64_t off_slot_;
+    uint64_t size_file_;
+} YacUnorderedMapSnapshot;
+
+#define YAC_UNORDERED_MAP_SNAPSHOT_MAGIC "YACUMAP"
+#define YAC_UNORDERED_MAP_SNAPSHOT_VERSION 1u
+#define YAC_UNORDERED_MAP_SNAPSHOT_ORDER 0x01020304u
+#define YAC_UNORDERED_MAP_SNAPSHOT_OFFSET ((UINT64_C(1) << 40) - 1)
+
+// How the memory of a view is held.
+enum {
+    YAC_UNORDERED_MAP_VIEW_BUFFER,
+    YAC_UNORDERED_MAP_VIEW_MAPPED,
+    YAC_UNORDERED_MAP_VIEW_READ,
+};
+
+struct _YacUnorderedMapView {
+    const unsigned char* base_;
+    size_t size_;
+    int kind_;
+    unsigned num_pair_;
+    uint64_t num_slot_;
+    uint64_t off_slot_;
+    const uint64_t* arr_slot_;
 };
 
 
@@ -229,12 +1352,263 @@ struct _YacUnorderedMapData {
 // The default hash function.
 static unsigned YacUnorderedMapHash_(void* key);
 
+// Return the hash of the key with the seeded or the plain hash function.
+static unsigned YacUnorderedMapHashOf_(YacUnorderedMapData* data, void* key);
+
+// Draw the random seed of the map.
+static void YacUnorderedMapSeed_(YacUnorderedMapData* data);
+
+// Return SipHash of the key with the designated numbers of compression and
+// finalization rounds.
+static uint64_t YacUnorderedMapSip_(const unsigned char* ptr, size_t size, const uint64_t* seed,
+                                    int num_c_round, int num_d_round);
+
+// Multiply the operands into 128 bits, leaving the low half in lhs and the high
+// half in rhs.
+static void YacUnorderedMapWyMum_(uint64_t* lhs, uint64_t* rhs);
+
+// Return the exclusive or of the halves of the 128 bit product.
+static uint64_t YacUnorderedMapWyMix_(uint64_t lhs, uint64_t rhs);
+
+// Read 8 or 4 bytes from a possibly unaligned address.
+static uint64_t YacUnorderedMapRead8_(const unsigned char* ptr);
+static uint64_t YacUnorderedMapRead4_(const unsigned char* ptr);
+
 // The default hash key comparison function.
 static int YacUnorderedMapCompare_(void* lhs, void* rhs);
 
 // Extend the slot array and re-distribute the stored pairs.
 static void YacUnorderedMapReHash_(YacUnorderedMapData* data);
 
+// Replace the slot array with one of the designated slot count.
+static bool YacUnorderedMapReHashTo_(YacUnorderedMapData* data, unsigned num_slot_new);
+
+// Return the smallest slot count of the sizing policy that holds the designated
+// number of pairs. The matching prime table index is stored for the prime sizing.
+static unsigned YacUnorderedMapFitSlot_(unsigned flags, unsigned capacity, int* idx_prime);
+
+// The hooks of the statistics, which vanish without YAC_UNORDERED_MAP_STATS.
+#ifdef YAC_UNORDERED_MAP_STATS
+static void YacUnorderedMapStatGet_(YacUnorderedMapData* data, unsigned num_probe);
+static void YacUnorderedMapStatReHash_(YacUnorderedMapData* data, uint64_t start, unsigned num_rehash);
+static uint64_t YacUnorderedMapStatClock_(void);
+static void YacUnorderedMapStatChain_(YacUnorderedMapStats* stats, unsigned length);
+#define YAC_UNORDERED_MAP_STAT_GET(data, num_probe) YacUnorderedMapStatGet_((data), (num_probe))
+#define YAC_UNORDERED_MAP_STAT_CLOCK(start) uint64_t start = YacUnorderedMapStatClock_()
+#define YAC_UNORDERED_MAP_STAT_REHASH(data, start, num_rehash) YacUnorderedMapStatReHash_((data), (start), (num_rehash))
+#else
+#define YAC_UNORDERED_MAP_STAT_GET(data, num_probe) ((void)0)
+#define YAC_UNORDERED_MAP_STAT_CLOCK(start) ((void)0)
+#define YAC_UNORDERED_MAP_STAT_REHASH(data, start, num_rehash) ((void)0)
+#endif
+
+// Return the tree of the designated slot, or NULL if the slot is a plain list.
+static YacUnorderedMapBin* YacUnorderedMapBin_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot);
+
+// Search the slot list, or the tree of a treeified slot, for the designated key.
+// The number of the nodes visited before the match is stored in length, which
+// is the length of a plain list missing the key, as the treeification checks.
+static YacUnorderedMapSlotNode* YacUnorderedMapChainFind_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                                          void* key, unsigned hash, unsigned* length);
+
+// Link the new node at the head of the slot list, and index it with the tree
+// of the slot. The list is treeified if its length before the insertion reaches
+// the threshold. Return false if the tree node cannot be allocated.
+static bool YacUnorderedMapChainLink_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                      YacUnorderedMapSlotNode* node, unsigned hash, unsigned length);
+
+// Unlink the node indexed by the tree node from the treeified slot, and return it.
+static YacUnorderedMapSlotNode* YacUnorderedMapBinUnlink_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                                          YacUnorderedMapTreeNode* tree);
+
+// Index the slot list with a tree. The slot is left as a plain list if the
+// memory cannot be allocated.
+static void YacUnorderedMapTreeify_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot);
+
+// Release all the trees.
+static void YacUnorderedMapTreeRelease_(YacUnorderedMapData* data);
+
+// Clean and release the nodes of the slot range, and empty the slots. Pooled
+// nodes are recycled into the pool.
+static void YacUnorderedMapClearSlot_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** arr_slot,
+                                      unsigned begin, unsigned end);
+
+// Release all the trees and treeify the slot lists reaching the threshold again
+// after the slot lists are rearranged.
+static void YacUnorderedMapTreeRebuild_(YacUnorderedMapData* data);
+
+// The AVL tree primitives. The nodes are ordered by the hash and then by the
+// comparison function.
+static int YacUnorderedMapTreeOrder_(YacUnorderedMapData* data, unsigned hash, void* key, YacUnorderedMapTreeNode* tree);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeFind_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* tree,
+                                                         void* key, unsigned hash, unsigned* length);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeInsert_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* root,
+                                                           YacUnorderedMapTreeNode* tree);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeErase_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* root,
+                                                          YacUnorderedMapTreeNode* tree);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeRemoveMin_(YacUnorderedMapTreeNode* root, YacUnorderedMapTreeNode** min);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeBalance_(YacUnorderedMapTreeNode* tree);
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeRotate_(YacUnorderedMapTreeNode* tree, bool left);
+static int YacUnorderedMapTreeHeight_(YacUnorderedMapTreeNode* tree);
+
+// Insert the pair into the chained engine without checking the loading factor.
+// The designated counter is incremented if a new pair is inserted.
+static bool YacUnorderedMapChainPut_(YacUnorderedMapData* data, void* key, void* value, unsigned hash, int* size);
+
+// Allocate a slot node from the node pool or the allocator.
+static YacUnorderedMapSlotNode* YacUnorderedMapNodeAlloc_(YacUnorderedMapData* data);
+
+// Return the slot node to the node pool or the allocator.
+static void YacUnorderedMapNodeFree_(YacUnorderedMapData* data, YacUnorderedMapSlotNode* node);
+
+// Clean and release the pairs stored in the designated range of the slot array.
+static void YacUnorderedMapReleaseSlot_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** arr_slot,
+                                        unsigned begin, unsigned end);
+
+// Release all the chunks of the node pool.
+static void YacUnorderedMapPoolRelease_(YacUnorderedMapData* data);
+
+// Migrate at most the designated number of old slots to the new slot array.
+static void YacUnorderedMapReHashStep_(YacUnorderedMapData* data, unsigned num_step);
+
+// Return the slot list which holds the pairs having the designated hash.
+static YacUnorderedMapSlotNode** YacUnorderedMapSlot_(YacUnorderedMapData* data, unsigned hash);
+
+// Map the hash to a slot index with the sizing policy of the map.
+static unsigned YacUnorderedMapIndex_(YacUnorderedMapData* data, unsigned hash, unsigned num_slot);
+
+// Allocate the control byte and pair arrays of the flat engine.
+static bool YacUnorderedMapFlatAlloc_(YacUnorderedMapData* data, unsigned num_slot);
+
+// Return the slot storing the designated key, or num_slot_ if it is absent.
+static unsigned YacUnorderedMapFlatFind_(YacUnorderedMapData* data, void* key, unsigned hash, unsigned* num_group);
+
+// Rebuild the flat arrays with the designated slot count.
+static bool YacUnorderedMapFlatReHash_(YacUnorderedMapData* data, unsigned num_slot_new);
+
+// The flat engine counterparts of the exported member operations.
+static bool YacUnorderedMapFlatPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash);
+static void* YacUnorderedMapFlatGet_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapFlatContain_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapFlatRemove_(YacUnorderedMap* self, void* key, unsigned hash);
+
+// Return the pair of the flat engine stored with the designated key, inserting
+// it first if absent. The hash must be mixed.
+static YacUnorderedMapPair* YacUnorderedMapFlatEntry_(YacUnorderedMapData* data, void* key,
+                                                      unsigned hash, bool* inserted);
+static void YacUnorderedMapFlatFirst_(YacUnorderedMap* self);
+static YacUnorderedMapPair* YacUnorderedMapFlatNext_(YacUnorderedMap* self);
+
+// The index slot encoding of the compact engine. A used slot stores the entry
+// index plus one in the bits below the slot count, and the hash bits above it.
+#define YAC_UNORDERED_MAP_INDEX_EMPTY 0u
+#define YAC_UNORDERED_MAP_INDEX_DELETED 0xffffffffu
+
+// Rebuild the index table of the compact engine with the designated slot count.
+static bool YacUnorderedMapCompactReHash_(YacUnorderedMapData* data, unsigned num_slot_new);
+
+// Extend the pair array of the compact engine to hold at least the designated
+// number of pairs.
+static bool YacUnorderedMapCompactGrow_(YacUnorderedMapData* data, unsigned capacity);
+
+// Return the index slot referring to the designated key, or num_slot_ if it is absent.
+// The hash must be mixed.
+static unsigned YacUnorderedMapCompactFind_(YacUnorderedMapData* data, void* key, unsigned hash, unsigned* num_probe);
+
+// Append the pair to the compact engine and index it. The hash must be mixed.
+static YacUnorderedMapPair* YacUnorderedMapCompactInsert_(YacUnorderedMapData* data, void* key, void* value,
+                                                          unsigned hash);
+
+// The compact engine counterparts of the exported member operations.
+static bool YacUnorderedMapCompactPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash);
+static void* YacUnorderedMapCompactGet_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapCompactContain_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapCompactRemove_(YacUnorderedMap* self, void* key, unsigned hash);
+static YacUnorderedMapPair* YacUnorderedMapCompactEntry_(YacUnorderedMapData* data, void* key,
+                                                         unsigned hash, bool* inserted);
+static unsigned YacUnorderedMapCompactRemoveIf_(YacUnorderedMapData* data, YacUnorderedMapPredicate func, void* arg);
+static void YacUnorderedMapCompactFirst_(YacUnorderedMap* self);
+static YacUnorderedMapPair* YacUnorderedMapCompactNext_(YacUnorderedMap* self);
+
+// The lock primitives of the concurrent map. They do nothing without threads.
+static void YacUnorderedMapLockInit_(YacUnorderedMapLock* lock);
+static void YacUnorderedMapLockDeinit_(YacUnorderedMapLock* lock);
+static void YacUnorderedMapLockAcquire_(YacUnorderedMapLock* lock);
+static void YacUnorderedMapLockRelease_(YacUnorderedMapLock* lock);
+
+// Return the lock stripe which guards the slots of the designated hash.
+static YacUnorderedMapStripe* YacUnorderedMapStripe_(YacUnorderedMapData* data, unsigned hash);
+
+// Move the per stripe counts into size_ for the operations having exclusive access.
+static void YacUnorderedMapGatherSize_(YacUnorderedMapData* data);
+
+// Grow the slot array with all the stripes held, unless another thread has
+// already grown it from the designated slot count.
+static void YacUnorderedMapConcurrentReHash_(YacUnorderedMapData* data, unsigned num_slot);
+
+// The concurrent counterparts of the exported member operations.
+static bool YacUnorderedMapConcurrentPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash);
+static void* YacUnorderedMapConcurrentGet_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapConcurrentContain_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapConcurrentRemove_(YacUnorderedMap* self, void* key, unsigned hash);
+
+// The atomic primitives of the read-mostly map. The pointer loads and stores
+// have acquire and release semantics, and the counter operations are sequentially
+// consistent.
+static void* YacUnorderedMapLoadAcquire_(void* volatile* ptr);
+static void YacUnorderedMapStoreRelease_(void* volatile* ptr, void* value);
+static long YacUnorderedMapLoadSeq_(volatile long* ptr);
+static void YacUnorderedMapStoreSeq_(volatile long* ptr, long value);
+static long YacUnorderedMapFetchAdd_(volatile long* ptr, long value);
+
+// Return the slot list node storing the designated key in the published table.
+// The caller must be inside a read section.
+static YacUnorderedMapSlotNode* YacUnorderedMapReadMostlyFind_(YacUnorderedMapData* data, void* key, unsigned hash,
+                                                               unsigned* length);
+
+// Replace the slot array with a larger one linking copies of the nodes, so
+// that the readers of the old array are not disturbed.
+static bool YacUnorderedMapReadMostlyGrow_(YacUnorderedMapData* data);
+
+// Retire the node or the table for reclamation once no reader can see it.
+static void YacUnorderedMapRetire_(YacUnorderedMapData* data, YacUnorderedMapSlotNode* node, YacUnorderedMapTable* table);
+
+// Advance the epoch if no reader remains in the previous one, and reclaim the
+// objects retired two epochs ago.
+static void YacUnorderedMapTryAdvance_(YacUnorderedMapData* data);
+
+// Release the retired object.
+static void YacUnorderedMapReclaim_(YacUnorderedMapData* data, YacUnorderedMapRetired* retired);
+
+// The read-mostly counterparts of the exported member operations.
+static bool YacUnorderedMapReadMostlyPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash);
+static void* YacUnorderedMapReadMostlyGet_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapReadMostlyContain_(YacUnorderedMap* self, void* key, unsigned hash);
+static bool YacUnorderedMapReadMostlyRemove_(YacUnorderedMap* self, void* key, unsigned hash);
+
+// Split the buckets into shards and run the bulk operation on them in parallel.
+// The shards are returned for the calling thread to merge the results.
+static YacUnorderedMapShard* YacUnorderedMapRunShards_(YacUnorderedMapData* data, int op, YacUnorderedMapVisit func_visit,
+                                                       YacUnorderedMapPredicate func_pred, void* arg,
+                                                       unsigned* num_thread);
+
+// Process the bucket range of a shard.
+static void YacUnorderedMapShardRun_(YacUnorderedMapShard* shard);
+
+// Append the pair to the filter result of the shard.
+static void YacUnorderedMapShardAppend_(YacUnorderedMapShard* shard, YacUnorderedMapPair* pair);
+
+// Validate the snapshot held in the memory, and return a view over it. Return
+// NULL without releasing the memory if it is not a valid snapshot.
+static YacUnorderedMapView* YacUnorderedMapViewCreate_(const void* base, size_t size, int kind);
+
+// Release the memory of a view according to how it is held.
+static void YacUnorderedMapViewRelease_(const void* base, size_t size, int kind);
+
+// Return the record storing the designated key bytes, or NULL if the key is
+// absent. The record is checked to lie before the slot table.
+static const unsigned char* YacUnorderedMapViewFind_(YacUnorderedMapView* view, const void* key, size_t key_size);
+
 
 //
 // Implementation for the exported operations
@@ -242,6 +1616,35 @@ static void YacUnorderedMapReHash_(YacUnorderedMapData* data);
 
 YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInit(void)
 {
+    return YacUnorderedMapInitWithFlags(0);
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInitWithFlags(unsigned flags)
+{
+    return YacUnorderedMapInitWithCapacity(flags, 0);
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInitWithCapacity(unsigned flags, unsigned capacity)
+{
+    if (flags & YAC_UNORDERED_MAP_READ_MOSTLY)
+        flags &= ~(YAC_UNORDERED_MAP_FLAT | YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_CONCURRENT);
+    if (flags & YAC_UNORDERED_MAP_CONCURRENT) {
+        flags |= YAC_UNORDERED_MAP_POWER_OF_TWO;
+        flags &= ~(YAC_UNORDERED_MAP_FLAT | YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_NODE_POOL);
+    }
+    if (flags & (YAC_UNORDERED_MAP_CONCURRENT | YAC_UNORDERED_MAP_READ_MOSTLY))
+        flags &= ~YAC_UNORDERED_MAP_COMPACT;
+    if (flags & YAC_UNORDERED_MAP_COMPACT) {
+        flags |= YAC_UNORDERED_MAP_POWER_OF_TWO;
+        flags &= ~(YAC_UNORDERED_MAP_FLAT | YAC_UNORDERED_MAP_INCREMENTAL_REHASH | YAC_UNORDERED_MAP_CACHE_HASH |
+                   YAC_UNORDERED_MAP_NODE_POOL);
+    }
+    if (flags & (YAC_UNORDERED_MAP_FLAT | YAC_UNORDERED_MAP_COMPACT | YAC_UNORDERED_MAP_CONCURRENT |
+                 YAC_UNORDERED_MAP_READ_MOSTLY))
+        flags &= ~YAC_UNORDERED_MAP_TREEIFY;
+    if (flags & YAC_UNORDERED_MAP_TREEIFY)
+        flags &= ~YAC_UNORDERED_MAP_INCREMENTAL_REHASH;
+
     YacUnorderedMap* obj = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMap));
     if (!obj)
         return NULL;
@@ -252,34 +1655,132 @@ YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapInit(void)
         return NULL;
     }
 
-    YacUnorderedMapSlotNode** arr_slot = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapSlotNode*) * yac_unordered_map_magic_primes[0]);
-    if (!arr_slot) {
-        YAC_ORDERED_MAP_FREE(data);
-        YAC_ORDERED_MAP_FREE(obj);
-        return NULL;
-    }
-    unsigned i;
-    for (i = 0 ; i < yac_unordered_map_magic_primes[0] ; ++i)
-        arr_slot[i] = NULL;
-
+    data->flags_ = flags;
+    data->node_size_ = (flags & YAC_UNORDERED_MAP_CACHE_HASH)?
+        (unsigned)sizeof(YacUnorderedMapSlotNode) : (unsigned)offsetof(YacUnorderedMapSlotNode, hash_);
     data->size_ = 0;
-    data->idx_prime_ = 0;
-    data->num_slot_ = yac_unordered_map_magic_primes[0];
-    data->curr_limit_ = (unsigned)((double)yac_unordered_map_magic_primes[0] * yac_unordered_map_load_factor);
-    data->arr_slot_ = arr_slot;
+    data->arr_slot_ = NULL;
+    data->arr_slot_old_ = NULL;
+    data->num_slot_old_ = 0;
+    data->idx_migrate_ = 0;
+    data->pool_chunk_ = NULL;
+    data->pool_free_ = NULL;
+    data->pool_used_ = 0;
+    data->arr_stripe_ = NULL;
+    data->arr_bin_ = NULL;
+    data->num_bin_ = 0;
+    data->table_ = NULL;
+#ifdef YAC_UNORDERED_MAP_STATS
+    data->stat_num_get_ = 0;
+    data->stat_num_probe_ = 0;
+    data->stat_num_rehash_ = 0;
+    data->stat_time_rehash_ = 0;
+#endif
+    data->arr_reader_ = NULL;
+    data->epoch_ = 0;
+    data->limbo_[0] = NULL;
+    data->limbo_[1] = NULL;
+    data->limbo_[2] = NULL;
+    data->arr_ctrl_ = NULL;
+    data->arr_pair_ = NULL;
+    data->arr_index_ = NULL;
+    data->cap_entry_ = 0;
     data->func_hash_ = YacUnorderedMapHash_;
+    data->func_seeded_ = YacUnorderedMapHashSipInt;
+    data->seed_[0] = 0;
+    data->seed_[1] = 0;
+    if (flags & YAC_UNORDERED_MAP_SEEDED)
+        YacUnorderedMapSeed_(data);
     data->func_cmp_ = YacUnorderedMapCompare_;
     data->func_clean_key_ = NULL;
     data->func_clean_val_ = NULL;
 
+    unsigned num_slot = YacUnorderedMapFitSlot_(flags, capacity, &(data->idx_prime_));
+    if (flags & YAC_UNORDERED_MAP_FLAT) {
+        if (!YacUnorderedMapFlatAlloc_(data, num_slot)) {
+            YAC_ORDERED_MAP_FREE(data);
+            YAC_ORDERED_MAP_FREE(obj);
+            return NULL;
+        }
+    } else if (flags & YAC_UNORDERED_MAP_COMPACT) {
+        if (!YacUnorderedMapCompactReHash_(data, num_slot) || !YacUnorderedMapCompactGrow_(data, capacity)) {
+            YAC_ORDERED_MAP_FREE(data->arr_index_);
+            YAC_ORDERED_MAP_FREE(data);
+            YAC_ORDERED_MAP_FREE(obj);
+            return NULL;
+        }
+    } else {
+        YacUnorderedMapSlotNode** arr_slot = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapSlotNode*) * num_slot);
+        if (!arr_slot) {
+            YAC_ORDERED_MAP_FREE(data);
+            YAC_ORDERED_MAP_FREE(obj);
+            return NULL;
+        }
+        unsigned i;
+        for (i = 0 ; i < num_slot ; ++i)
+            arr_slot[i] = NULL;
+
+        data->num_slot_ = num_slot;
+        data->curr_limit_ = (unsigned)((double)num_slot * yac_unordered_map_load_factor);
+        data->arr_slot_ = arr_slot;
+    }
+
+    if (flags & YAC_UNORDERED_MAP_CONCURRENT) {
+        YacUnorderedMapStripe* arr_stripe = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapStripe) * YAC_UNORDERED_MAP_NUM_STRIPE);
+        if (!arr_stripe) {
+            YAC_ORDERED_MAP_FREE(data->arr_slot_);
+            YAC_ORDERED_MAP_FREE(data);
+            YAC_ORDERED_MAP_FREE(obj);
+            return NULL;
+        }
+        unsigned i;
+        for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i) {
+            YacUnorderedMapLockInit_(&(arr_stripe[i].s_.lock_));
+            arr_stripe[i].s_.size_ = 0;
+        }
+        data->arr_stripe_ = arr_stripe;
+    }
+
+    if (flags & YAC_UNORDERED_MAP_READ_MOSTLY) {
+        YacUnorderedMapTable* table = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapTable));
+        YacUnorderedMapReader* arr_reader = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapReader) * YAC_UNORDERED_MAP_NUM_READER);
+        if (!table || !arr_reader) {
+            YAC_ORDERED_MAP_FREE(table);
+            YAC_ORDERED_MAP_FREE(arr_reader);
+            YAC_ORDERED_MAP_FREE(data->arr_slot_);
+            YAC_ORDERED_MAP_FREE(data);
+            YAC_ORDERED_MAP_FREE(obj);
+            return NULL;
+        }
+        unsigned i;
+        for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_READER ; ++i) {
+            arr_reader[i].cnt_[0] = 0;
+            arr_reader[i].cnt_[1] = 0;
+            arr_reader[i].cnt_[2] = 0;
+        }
+        table->num_slot_ = data->num_slot_;
+        table->arr_slot_ = data->arr_slot_;
+        YacUnorderedMapLockInit_(&(data->lock_writer_));
+        data->table_ = table;
+        data->arr_reader_ = arr_reader;
+    }
+
     obj->data = data;
     obj->put = YacUnorderedMapPut;
     obj->get = YacUnorderedMapGet;
     obj->contain = YacUnorderedMapContain;
     obj->remove = YacUnorderedMapRemove;
+    if (flags & YAC_UNORDERED_MAP_FLAT) {
+        obj->first = YacUnorderedMapFlatFirst_;
+        obj->next = YacUnorderedMapFlatNext_;
+    } else if (flags & YAC_UNORDERED_MAP_COMPACT) {
+        obj->first = YacUnorderedMapCompactFirst_;
+        obj->next = YacUnorderedMapCompactNext_;
+    } else {
+        obj->first = YacUnorderedMapFirst;
+        obj->next = YacUnorderedMapNext;
+    }
     obj->size = YacUnorderedMapSize;
-    obj->first = YacUnorderedMapFirst;
-    obj->next = YacUnorderedMapNext;
     obj->set_hash = YacUnorderedMapSetHash;
     obj->set_compare = YacUnorderedMapSetCompare;
     obj->set_clean_key = YacUnorderedMapSetCleanKey;
@@ -300,18 +1801,73 @@ YAC_UNORDERED_MAP_API void YacUnorderedMapDeinit(YacUnorderedMap* obj)
 
     unsigned num_slot = data->num_slot_;
     unsigned i;
-    for (i = 0 ; i < num_slot ; ++i) {
-        YacUnorderedMapSlotNode* pred;
-        YacUnorderedMapSlotNode* curr = arr_slot[i];
-        while (curr) {
-            pred = curr;
-            curr = curr->next_;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        unsigned char* arr_ctrl = data->arr_ctrl_;
+        YacUnorderedMapPair* arr_pair = data->arr_pair_;
+        for (i = 0 ; i < num_slot ; ++i) {
+            if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[i]))
+                continue;
             if (func_clean_key)
-                func_clean_key(pred->pair_.key);
+                func_clean_key(arr_pair[i].key);
             if (func_clean_val)
-                func_clean_val(pred->pair_.value);
-            YAC_ORDERED_MAP_FREE(pred);
+                func_clean_val(arr_pair[i].value);
         }
+
+        YAC_UNORDERED_MAP_FREE(arr_ctrl);
+        YAC_ORDERED_MAP_FREE(arr_pair);
+        YAC_ORDERED_MAP_FREE(data);
+        YAC_ORDERED_MAP_FREE(obj);
+        return;
+    }
+
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        YacUnorderedMapPair* arr_pair = data->arr_pair_;
+        for (i = 0 ; i < (unsigned)data->size_ ; ++i) {
+            if (func_clean_key)
+                func_clean_key(arr_pair[i].key);
+            if (func_clean_val)
+                func_clean_val(arr_pair[i].value);
+        }
+
+        YAC_ORDERED_MAP_FREE(data->arr_index_);
+        YAC_ORDERED_MAP_FREE(arr_pair);
+        YAC_ORDERED_MAP_FREE(data);
+        YAC_ORDERED_MAP_FREE(obj);
+        return;
+    }
+
+    // Reclaim the retired objects regardless of their epoch, before the pool
+    // they return their nodes to is released.
+    if (data->table_) {
+        for (i = 0 ; i < 3 ; ++i) {
+            YacUnorderedMapRetired* curr = data->limbo_[i];
+            while (curr) {
+                YacUnorderedMapRetired* pred = curr;
+                curr = curr->next_;
+                YacUnorderedMapReclaim_(data, pred);
+                YAC_ORDERED_MAP_FREE(pred);
+            }
+        }
+        YacUnorderedMapLockDeinit_(&(data->lock_writer_));
+        YAC_ORDERED_MAP_FREE(data->table_);
+        YAC_ORDERED_MAP_FREE(data->arr_reader_);
+    }
+
+    YacUnorderedMapTreeRelease_(data);
+
+    // Drain the old slot array before the current one.
+    if (data->arr_slot_old_) {
+        YacUnorderedMapReleaseSlot_(data, data->arr_slot_old_, data->idx_migrate_, data->num_slot_old_);
+        YAC_ORDERED_MAP_FREE(data->arr_slot_old_);
+    }
+    YacUnorderedMapReleaseSlot_(data, arr_slot, 0, num_slot);
+    YacUnorderedMapPoolRelease_(data);
+
+    if (data->arr_stripe_) {
+        for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i)
+            YacUnorderedMapLockDeinit_(&(data->arr_stripe_[i].s_.lock_));
+        YAC_ORDERED_MAP_FREE(data->arr_stripe_);
     }
 
     YAC_ORDERED_MAP_FREE(arr_slot);
@@ -322,117 +1878,184 @@ YAC_UNORDERED_MAP_API void YacUnorderedMapDeinit(YacUnorderedMap* obj)
 
 YAC_UNORDERED_MAP_API bool YacUnorderedMapPut(YacUnorderedMap* self, void* key, void* value)
 {
+    return YacUnorderedMapPutWithHash(self, key, value, YacUnorderedMapHashOf_(self->data, key));
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapPutWithHash(YacUnorderedMap* self, void* key, void* value, unsigned hash)
+{
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatPut_(self, key, value, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactPut_(self, key, value, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_CONCURRENT)
+        return YacUnorderedMapConcurrentPut_(self, key, value, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_READ_MOSTLY)
+        return YacUnorderedMapReadMostlyPut_(self, key, value, hash);
+
     // Check the loading factor for rehashing.
     YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
     if ((unsigned)data->size_ >= data->curr_limit_)
         YacUnorderedMapReHash_(data);
 
-    // Calculate the slot index.
-    unsigned hash = data->func_hash_(key);
-    hash = hash % data->num_slot_;
+    return YacUnorderedMapChainPut_(data, key, value, hash, &(data->size_));
+}
+
+static bool YacUnorderedMapChainPut_(YacUnorderedMapData* data, void* key, void* value, unsigned hash, int* size)
+{
+    // Locate the slot list.
+    YacUnorderedMapSlotNode** slot = YacUnorderedMapSlot_(data, hash);
 
     // Check if the pair conflicts with a certain one stored in the map. If yes, replace that one.
-    YacUnorderedMapCompare func_cmp = data->func_cmp_;
-    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
-    YacUnorderedMapSlotNode* curr = arr_slot[hash];
-    while (curr) {
-        if (func_cmp(key, curr->pair_.key) == 0) {
-            if (data->func_clean_key_)
-                data->func_clean_key_(curr->pair_.key);
-            if (data->func_clean_val_)
-                data->func_clean_val_(curr->pair_.value);
-            curr->pair_.key = key;
-            curr->pair_.value = value;
-            return true;
-        }
-        curr = curr->next_;
+    unsigned length;
+    YacUnorderedMapSlotNode* curr = YacUnorderedMapChainFind_(data, slot, key, hash, &length);
+    if (curr) {
+        if (data->func_clean_key_)
+            data->func_clean_key_(curr->pair_.key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(curr->pair_.value);
+        curr->pair_.key = key;
+        curr->pair_.value = value;
+        return true;
     }
 
     // Insert the new pair into the slot list.
-    YacUnorderedMapSlotNode* node = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapSlotNode));
+    YacUnorderedMapSlotNode* node = YacUnorderedMapNodeAlloc_(data);
     if (!node)
         return false;
 
     node->pair_.key = key;
     node->pair_.value = value;
-    if (!(arr_slot[hash])) {
-        node->next_ = NULL;
-        arr_slot[hash] = node;
-    } else {
-        node->next_ = arr_slot[hash];
-        arr_slot[hash] = node;
+    if (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH)
+        node->hash_ = hash;
+    if (!YacUnorderedMapChainLink_(data, slot, node, hash, length)) {
+        YacUnorderedMapNodeFree_(data, node);
+        return false;
     }
-    ++(data->size_);
+    ++(*size);
 
     return true;
 }
 
 YAC_UNORDERED_MAP_API void* YacUnorderedMapGet(YacUnorderedMap* self, void* key)
 {
+    return YacUnorderedMapGetWithHash(self, key, YacUnorderedMapHashOf_(self->data, key));
+}
+
+YAC_UNORDERED_MAP_API void* YacUnorderedMapGetWithHash(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatGet_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactGet_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_CONCURRENT)
+        return YacUnorderedMapConcurrentGet_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_READ_MOSTLY)
+        return YacUnorderedMapReadMostlyGet_(self, key, hash);
+
     YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
 
-    // Calculate the slot index.
-    unsigned hash = data->func_hash_(key);
-    hash = hash % data->num_slot_;
+    // Locate the slot list.
+    YacUnorderedMapSlotNode** slot = YacUnorderedMapSlot_(data, hash);
 
     // Search the slot list to check if there is a pair having the same key with the designated one.
-    YacUnorderedMapCompare func_cmp = data->func_cmp_;
-    YacUnorderedMapSlotNode* curr = data->arr_slot_[hash];
-    while (curr) {
-        if (func_cmp(key, curr->pair_.key) == 0)
-            return curr->pair_.value;
-        curr = curr->next_;
-    }
-
-    return NULL;
+    unsigned length;
+    YacUnorderedMapSlotNode* curr = YacUnorderedMapChainFind_(data, slot, key, hash, &length);
+    YAC_UNORDERED_MAP_STAT_GET(data, length + (curr != NULL));
+    return (curr)? curr->pair_.value : NULL;
 }
 
 YAC_UNORDERED_MAP_API bool YacUnorderedMapContain(YacUnorderedMap* self, void* key)
 {
+    return YacUnorderedMapContainWithHash(self, key, YacUnorderedMapHashOf_(self->data, key));
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapContainWithHash(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatContain_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactContain_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_CONCURRENT)
+        return YacUnorderedMapConcurrentContain_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_READ_MOSTLY)
+        return YacUnorderedMapReadMostlyContain_(self, key, hash);
+
     YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
 
-    // Calculate the slot index.
-    unsigned hash = data->func_hash_(key);
-    hash = hash % data->num_slot_;
+    // Locate the slot list.
+    YacUnorderedMapSlotNode** slot = YacUnorderedMapSlot_(data, hash);
 
     // Search the slot list to check if there is a pair having the same key with the designated one.
-    YacUnorderedMapCompare func_cmp = data->func_cmp_;
-    YacUnorderedMapSlotNode* curr = data->arr_slot_[hash];
-    while (curr) {
-        if (func_cmp(key, curr->pair_.key) == 0)
-            return true;
-        curr = curr->next_;
-    }
-
-    return false;
+    unsigned length;
+    return YacUnorderedMapChainFind_(data, slot, key, hash, &length) != NULL;
 }
 
 YAC_UNORDERED_MAP_API bool YacUnorderedMapRemove(YacUnorderedMap* self, void* key)
 {
-    YacUnorderedMapData* data = self->data;
+    return YacUnorderedMapRemoveWithHash(self, key, YacUnorderedMapHashOf_(self->data, key));
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapRemoveWithHash(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatRemove_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactRemove_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_CONCURRENT)
+        return YacUnorderedMapConcurrentRemove_(self, key, hash);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_READ_MOSTLY)
+        return YacUnorderedMapReadMostlyRemove_(self, key, hash);
 
-    // Calculate the slot index.
-    unsigned hash = data->func_hash_(key);
-    hash = hash % data->num_slot_;
+    YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
+
+    // Locate the slot list.
+    YacUnorderedMapSlotNode** slot = YacUnorderedMapSlot_(data, hash);
+
+    // A treeified slot finds the deletion target in the tree, and the cleanup
+    // functions run after the tree stops comparing its key.
+    YacUnorderedMapBin* bin = YacUnorderedMapBin_(data, slot);
+    if (bin) {
+        unsigned length;
+        YacUnorderedMapTreeNode* tree = YacUnorderedMapTreeFind_(data, bin->root_, key, hash, &length);
+        if (!tree)
+            return false;
+
+        YacUnorderedMapSlotNode* node = YacUnorderedMapBinUnlink_(data, slot, tree);
+        if (data->func_clean_key_)
+            data->func_clean_key_(node->pair_.key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(node->pair_.value);
+        YacUnorderedMapNodeFree_(data, node);
+        --(data->size_);
+        return true;
+    }
 
     // Search the slot list for the deletion target.
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
     YacUnorderedMapCompare func_cmp = data->func_cmp_;
     YacUnorderedMapSlotNode* pred = NULL;
-    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
-    YacUnorderedMapSlotNode* curr = arr_slot[hash];
+    YacUnorderedMapSlotNode* curr = *slot;
     while (curr) {
-        if (func_cmp(key, curr->pair_.key) == 0) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0) {
             if (data->func_clean_key_)
                 data->func_clean_key_(curr->pair_.key);
             if (data->func_clean_val_)
                 data->func_clean_val_(curr->pair_.value);
 
             if (!pred)
-                arr_slot[hash] = curr->next_;
+                *slot = curr->next_;
             else
                 pred->next_ = curr->next_;
 
-            YAC_ORDERED_MAP_FREE(curr);
+            YacUnorderedMapNodeFree_(data, curr);
             --(data->size_);
             return true;
         }
@@ -443,14 +2066,395 @@ YAC_UNORDERED_MAP_API bool YacUnorderedMapRemove(YacUnorderedMap* self, void* ke
     return false;
 }
 
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashKey(YacUnorderedMap* self, void* key)
+{
+    return YacUnorderedMapHashOf_(self->data, key);
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapEntry(YacUnorderedMap* self, void* key, bool* inserted)
+{
+    return YacUnorderedMapEntryWithHash(self, key, YacUnorderedMapHashOf_(self->data, key), inserted);
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapEntryWithHash(YacUnorderedMap* self, void* key,
+                                                                        unsigned hash, bool* inserted)
+{
+    YacUnorderedMapData* data = self->data;
+    *inserted = false;
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatEntry_(data, key, YacUnorderedMapMix_(hash), inserted);
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactEntry_(data, key, YacUnorderedMapMix_(hash), inserted);
+
+    // With exclusive access, the concurrent and read-mostly maps are plain chained maps.
+    YacUnorderedMapGatherSize_(data);
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
+
+    unsigned length;
+    YacUnorderedMapSlotNode** slot = YacUnorderedMapSlot_(data, hash);
+    YacUnorderedMapSlotNode* curr = YacUnorderedMapChainFind_(data, slot, key, hash, &length);
+    if (curr)
+        return &(curr->pair_);
+
+    // Only an insertion checks the loading factor, and the slot list is
+    // located again if the slot array is replaced.
+    if ((unsigned)data->size_ >= data->curr_limit_) {
+        unsigned num_slot = data->num_slot_;
+        YacUnorderedMapReHash_(data);
+        if (data->num_slot_ != num_slot) {
+            slot = YacUnorderedMapSlot_(data, hash);
+            length = 0;
+        }
+    }
+
+    YacUnorderedMapSlotNode* node = YacUnorderedMapNodeAlloc_(data);
+    if (!node)
+        return NULL;
+
+    node->pair_.key = key;
+    node->pair_.value = NULL;
+    if (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH)
+        node->hash_ = hash;
+    if (!YacUnorderedMapChainLink_(data, slot, node, hash, length)) {
+        YacUnorderedMapNodeFree_(data, node);
+        return NULL;
+    }
+    ++(data->size_);
+
+    *inserted = true;
+    return &(node->pair_);
+}
+
 YAC_UNORDERED_MAP_API unsigned YacUnorderedMapSize(YacUnorderedMap* self)
 {
-    return self->data->size_;
+    YacUnorderedMapData* data = self->data;
+    if (data->table_) {
+        YacUnorderedMapLockAcquire_(&(data->lock_writer_));
+        int size = data->size_;
+        YacUnorderedMapLockRelease_(&(data->lock_writer_));
+        return (unsigned)size;
+    }
+    if (!data->arr_stripe_)
+        return data->size_;
+
+    // size_ only changes with exclusive access, and each stripe count is read
+    // under its lock.
+    int size = data->size_;
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i) {
+        YacUnorderedMapStripe* stripe = &(data->arr_stripe_[i]);
+        YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+        size += stripe->s_.size_;
+        YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+    }
+    return (unsigned)size;
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapReserve(YacUnorderedMap* self, unsigned capacity)
+{
+    YacUnorderedMapData* data = self->data;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        // Tombstones also consume the growth budget of the flat engine.
+        if (capacity <= (unsigned)data->size_ + data->growth_left_)
+            return true;
+        int idx_prime;
+        unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, capacity, &idx_prime);
+        if (num_slot_new < data->num_slot_)
+            num_slot_new = data->num_slot_;
+        return YacUnorderedMapFlatReHash_(data, num_slot_new);
+    }
+
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        if (capacity > (unsigned)data->size_ + data->growth_left_) {
+            int idx_prime;
+            unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, capacity, &idx_prime);
+            if (num_slot_new < data->num_slot_)
+                num_slot_new = data->num_slot_;
+            if (!YacUnorderedMapCompactReHash_(data, num_slot_new))
+                return false;
+        }
+        return YacUnorderedMapCompactGrow_(data, capacity);
+    }
+
+    // Finish the pending incremental rehashing so that the new slot array is
+    // the only one left when this function returns.
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+    if (capacity <= data->curr_limit_)
+        return true;
+
+    int idx_prime_old = data->idx_prime_;
+    unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, capacity, &(data->idx_prime_));
+    if (!YacUnorderedMapReHashTo_(data, num_slot_new)) {
+        data->idx_prime_ = idx_prime_old;
+        return false;
+    }
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+    return true;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapClear(YacUnorderedMap* self)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapCleanKey func_clean_key = data->func_clean_key_;
+    YacUnorderedMapCleanValue func_clean_val = data->func_clean_val_;
+    unsigned i;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        unsigned char* arr_ctrl = data->arr_ctrl_;
+        YacUnorderedMapPair* arr_pair = data->arr_pair_;
+        for (i = 0 ; i < data->num_slot_ ; ++i) {
+            if (YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[i])) {
+                if (func_clean_key)
+                    func_clean_key(arr_pair[i].key);
+                if (func_clean_val)
+                    func_clean_val(arr_pair[i].value);
+            }
+            arr_ctrl[i] = YAC_UNORDERED_MAP_CTRL_EMPTY;
+        }
+        data->size_ = 0;
+        data->growth_left_ = data->curr_limit_;
+        data->iter_slot_ = data->num_slot_;
+        return;
+    }
+
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        YacUnorderedMapPair* arr_pair = data->arr_pair_;
+        for (i = 0 ; i < (unsigned)data->size_ ; ++i) {
+            if (func_clean_key)
+                func_clean_key(arr_pair[i].key);
+            if (func_clean_val)
+                func_clean_val(arr_pair[i].value);
+        }
+        for (i = 0 ; i < data->num_slot_ ; ++i)
+            data->arr_index_[i] = YAC_UNORDERED_MAP_INDEX_EMPTY;
+        data->size_ = 0;
+        data->growth_left_ = data->curr_limit_;
+        data->iter_slot_ = 0;
+        return;
+    }
+
+    // With exclusive access, the concurrent and read-mostly maps are plain chained
+    // maps. The old slot array of an incremental rehashing is dropped rather than drained.
+    YacUnorderedMapGatherSize_(data);
+    YacUnorderedMapTreeRelease_(data);
+    if (data->arr_slot_old_) {
+        YacUnorderedMapClearSlot_(data, data->arr_slot_old_, data->idx_migrate_, data->num_slot_old_);
+        YAC_ORDERED_MAP_FREE(data->arr_slot_old_);
+        data->arr_slot_old_ = NULL;
+        data->num_slot_old_ = 0;
+        data->idx_migrate_ = 0;
+    }
+    YacUnorderedMapClearSlot_(data, data->arr_slot_, 0, data->num_slot_);
+    data->size_ = 0;
+    data->iter_slot_ = data->num_slot_;
+    data->iter_node_ = NULL;
+    return;
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapShrinkToFit(YacUnorderedMap* self)
+{
+    YacUnorderedMapData* data = self->data;
+    int idx_prime;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, (unsigned)data->size_, &idx_prime);
+        if (num_slot_new > data->num_slot_)
+            num_slot_new = data->num_slot_;
+        if (num_slot_new == data->num_slot_ && data->growth_left_ == data->curr_limit_ - (unsigned)data->size_)
+            return true;
+        return YacUnorderedMapFlatReHash_(data, num_slot_new);
+    }
+
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, (unsigned)data->size_, &idx_prime);
+        if (num_slot_new > data->num_slot_)
+            num_slot_new = data->num_slot_;
+        if ((num_slot_new != data->num_slot_ || data->growth_left_ != data->curr_limit_ - (unsigned)data->size_) &&
+            !YacUnorderedMapCompactReHash_(data, num_slot_new))
+            return false;
+
+        if (data->cap_entry_ > (unsigned)data->size_) {
+            YacUnorderedMapPair* arr_pair = NULL;
+            if (data->size_ > 0) {
+                arr_pair = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapPair) * (unsigned)data->size_);
+                if (!arr_pair)
+                    return false;
+                memcpy(arr_pair, data->arr_pair_, sizeof(YacUnorderedMapPair) * (unsigned)data->size_);
+            }
+            YAC_ORDERED_MAP_FREE(data->arr_pair_);
+            data->arr_pair_ = arr_pair;
+            data->cap_entry_ = (unsigned)data->size_;
+        }
+        return true;
+    }
+
+    YacUnorderedMapGatherSize_(data);
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+
+    int idx_prime_old = data->idx_prime_;
+    unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, (unsigned)data->size_, &idx_prime);
+    if (num_slot_new < data->num_slot_) {
+        data->idx_prime_ = idx_prime;
+        if (!YacUnorderedMapReHashTo_(data, num_slot_new)) {
+            data->idx_prime_ = idx_prime_old;
+            return false;
+        }
+        if (data->arr_slot_old_)
+            YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+    }
+
+    // All the pooled nodes are free once the map is empty, unless the read-mostly
+    // map still holds retired nodes to be returned to the pool.
+    bool retired = data->table_ && (data->limbo_[0] || data->limbo_[1] || data->limbo_[2]);
+    if (data->size_ == 0 && !retired)
+        YacUnorderedMapPoolRelease_(data);
+    return true;
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapPutMany(YacUnorderedMap* self, const YacUnorderedMapPair* pairs, unsigned num_pair)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapGatherSize_(data);
+
+    // Fall back to the checked insertion if the room cannot be reserved.
+    unsigned i;
+    if (!YacUnorderedMapReserve(self, (unsigned)data->size_ + num_pair)) {
+        for (i = 0 ; i < num_pair ; ++i) {
+            if (!YacUnorderedMapPut(self, pairs[i].key, pairs[i].value))
+                return false;
+        }
+        return true;
+    }
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        for (i = 0 ; i < num_pair ; ++i) {
+            if (!YacUnorderedMapFlatPut_(self, pairs[i].key, pairs[i].value, YacUnorderedMapHashOf_(data, pairs[i].key)))
+                return false;
+        }
+        return true;
+    }
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        for (i = 0 ; i < num_pair ; ++i) {
+            if (!YacUnorderedMapCompactPut_(self, pairs[i].key, pairs[i].value, YacUnorderedMapHashOf_(data, pairs[i].key)))
+                return false;
+        }
+        return true;
+    }
+
+    for (i = 0 ; i < num_pair ; ++i) {
+        if (!YacUnorderedMapChainPut_(data, pairs[i].key, pairs[i].value,
+                                      YacUnorderedMapHashOf_(data, pairs[i].key), &(data->size_)))
+            return false;
+    }
+    return true;
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapGetMany(YacUnorderedMap* self, void** keys, unsigned num_key, void** values)
+{
+    YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, YAC_UNORDERED_MAP_REHASH_STEP);
+
+    // The locking maps, the compact maps and the maps having treeified slots
+    // only share the hashing pass.
+    bool flat = (data->flags_ & YAC_UNORDERED_MAP_FLAT) != 0;
+    bool locking = (data->flags_ & (YAC_UNORDERED_MAP_CONCURRENT | YAC_UNORDERED_MAP_READ_MOSTLY |
+                                    YAC_UNORDERED_MAP_COMPACT)) != 0 || data->arr_bin_ != NULL;
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+
+    unsigned arr_hash[YAC_UNORDERED_MAP_PREFETCH_BATCH];
+    YacUnorderedMapSlotNode* arr_head[YAC_UNORDERED_MAP_PREFETCH_BATCH];
+    unsigned num_found = 0;
+    unsigned base;
+    for (base = 0 ; base < num_key ; base += YAC_UNORDERED_MAP_PREFETCH_BATCH) {
+        unsigned num_batch = num_key - base;
+        if (num_batch > YAC_UNORDERED_MAP_PREFETCH_BATCH)
+            num_batch = YAC_UNORDERED_MAP_PREFETCH_BATCH;
+        void** batch_key = keys + base;
+        void** batch_val = values + base;
+        unsigned i;
+
+        if (locking) {
+            for (i = 0 ; i < num_batch ; ++i)
+                arr_hash[i] = YacUnorderedMapHashOf_(data, batch_key[i]);
+            for (i = 0 ; i < num_batch ; ++i) {
+                batch_val[i] = YacUnorderedMapGetWithHash(self, batch_key[i], arr_hash[i]);
+                num_found += batch_val[i] != NULL;
+            }
+            continue;
+        }
+
+        if (flat) {
+            // Prefetch the first probed group of control bytes and its pairs.
+            unsigned mask_group = data->num_slot_ / YAC_UNORDERED_MAP_GROUP_WIDTH - 1;
+            for (i = 0 ; i < num_batch ; ++i) {
+                unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, batch_key[i]));
+                unsigned idx = ((hash >> 7) & mask_group) * YAC_UNORDERED_MAP_GROUP_WIDTH;
+                YAC_UNORDERED_MAP_PREFETCH(data->arr_ctrl_ + idx);
+                YAC_UNORDERED_MAP_PREFETCH(data->arr_pair_ + idx);
+                arr_hash[i] = hash;
+            }
+            for (i = 0 ; i < num_batch ; ++i) {
+                unsigned num_group;
+                unsigned idx = YacUnorderedMapFlatFind_(data, batch_key[i], arr_hash[i], &num_group);
+                YAC_UNORDERED_MAP_STAT_GET(data, num_group);
+                batch_val[i] = (idx != data->num_slot_)? data->arr_pair_[idx].value : NULL;
+                num_found += batch_val[i] != NULL;
+            }
+            continue;
+        }
+
+        // Prefetch the slots, then the head nodes they point to, and walk the
+        // slot lists last.
+        for (i = 0 ; i < num_batch ; ++i) {
+            arr_hash[i] = YacUnorderedMapHashOf_(data, batch_key[i]);
+            YAC_UNORDERED_MAP_PREFETCH(YacUnorderedMapSlot_(data, arr_hash[i]));
+        }
+        for (i = 0 ; i < num_batch ; ++i) {
+            arr_head[i] = *YacUnorderedMapSlot_(data, arr_hash[i]);
+            if (arr_head[i])
+                YAC_UNORDERED_MAP_PREFETCH(arr_head[i]);
+        }
+        for (i = 0 ; i < num_batch ; ++i) {
+            unsigned hash = arr_hash[i];
+            unsigned num_probe = 1;
+            YacUnorderedMapSlotNode* curr = arr_head[i];
+            while (curr) {
+                if ((!cache_hash || curr->hash_ == hash) && func_cmp(batch_key[i], curr->pair_.key) == 0)
+                    break;
+                ++num_probe;
+                curr = curr->next_;
+            }
+            YAC_UNORDERED_MAP_STAT_GET(data, num_probe - (curr == NULL));
+            batch_val[i] = (curr)? curr->pair_.value : NULL;
+            num_found += batch_val[i] != NULL;
+        }
+    }
+
+    return num_found;
 }
 
 YAC_UNORDERED_MAP_API void YacUnorderedMapFirst(YacUnorderedMap* self)
 {
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        YacUnorderedMapFlatFirst_(self);
+        return;
+    }
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        YacUnorderedMapCompactFirst_(self);
+        return;
+    }
+
     YacUnorderedMapData* data = self->data;
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+
     data->iter_slot_ = 0;
     data->iter_node_ = data->arr_slot_[0];
     return;
@@ -458,6 +2462,11 @@ YAC_UNORDERED_MAP_API void YacUnorderedMapFirst(YacUnorderedMap* self)
 
 YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapNext(YacUnorderedMap* self)
 {
+    if (self->data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatNext_(self);
+    if (self->data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactNext_(self);
+
     YacUnorderedMapData* data = self->data;
 
     YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
@@ -475,166 +2484,2721 @@ YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapNext(YacUnorderedMap*
     return NULL;
 }
 
-YAC_UNORDERED_MAP_API void YacUnorderedMapSetHash(YacUnorderedMap* self, YacUnorderedMapHash func)
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapBucketCount(YacUnorderedMap* self)
 {
-    self->data->func_hash_ = func;
+    YacUnorderedMapData* data = self->data;
+
+    // The old slot array comes first. Its migrated slots are empty.
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT)
+        return data->num_slot_;
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return (unsigned)data->size_;
+    return data->num_slot_old_ + data->num_slot_;
 }
 
-YAC_UNORDERED_MAP_API void YacUnorderedMapSetCompare(YacUnorderedMap* self, YacUnorderedMapCompare func)
+YAC_UNORDERED_MAP_API YacUnorderedMapIterator YacUnorderedMapBegin(YacUnorderedMap* self)
 {
-    self->data->func_cmp_ = func;
+    return YacUnorderedMapBeginRange(self, 0, YacUnorderedMapBucketCount(self));
 }
 
-YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanKey(YacUnorderedMap* self, YacUnorderedMapCleanKey func)
+YAC_UNORDERED_MAP_API YacUnorderedMapIterator YacUnorderedMapBeginRange(YacUnorderedMap* self, unsigned begin, unsigned end)
 {
-    self->data->func_clean_key_ = func;
+    unsigned num_bucket = YacUnorderedMapBucketCount(self);
+    if (end > num_bucket)
+        end = num_bucket;
+    if (begin > end)
+        begin = end;
+
+    YacUnorderedMapIterator iter;
+    iter.data_ = self->data;
+    iter.bucket_ = begin;
+    iter.end_ = end;
+    iter.node_ = NULL;
+    return iter;
 }
 
-YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanValue(YacUnorderedMap* self, YacUnorderedMapCleanValue func)
+YAC_UNORDERED_MAP_API YacUnorderedMapPair* YacUnorderedMapIteratorNext(YacUnorderedMapIterator* iter)
 {
-    self->data->func_clean_val_ = func;
+    YacUnorderedMapData* data = iter->data_;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        unsigned char* arr_ctrl = data->arr_ctrl_;
+        while (iter->bucket_ < iter->end_) {
+            unsigned idx = (iter->bucket_)++;
+            if (YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[idx]))
+                return &(data->arr_pair_[idx]);
+        }
+        return NULL;
+    }
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return (iter->bucket_ < iter->end_)? &(data->arr_pair_[(iter->bucket_)++]) : NULL;
+
+    // The cursor already points to the next node when a pair is returned.
+    YacUnorderedMapSlotNode* node = iter->node_;
+    while (!node) {
+        if (iter->bucket_ == iter->end_)
+            return NULL;
+        unsigned idx = (iter->bucket_)++;
+        if (idx < data->num_slot_old_)
+            node = data->arr_slot_old_[idx];
+        else
+            node = data->arr_slot_[idx - data->num_slot_old_];
+    }
+    iter->node_ = node->next_;
+    return &(node->pair_);
 }
 
-YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashMurMur32(void* key, size_t size)
+// The reader slot index of the calling thread plus one, or zero if not assigned yet.
+static YAC_UNORDERED_MAP_THREAD_LOCAL unsigned yac_unordered_map_reader_idx;
+static volatile long yac_unordered_map_num_reader_thread;
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapReadEnter(YacUnorderedMap* self)
 {
-    if (!key || size == 0)
+    YacUnorderedMapData* data = self->data;
+    if (!data->arr_reader_)
         return 0;
 
-    const unsigned c1 = 0xcc9e2d51;
-    const unsigned c2 = 0x1b873593;
-    const unsigned r1 = 15;
-    const unsigned r2 = 13;
-    const unsigned m = 5;
-    const unsigned n = 0xe6546b64;
+    if (yac_unordered_map_reader_idx == 0)
+        yac_unordered_map_reader_idx = (unsigned)YacUnorderedMapFetchAdd_(&yac_unordered_map_num_reader_thread, 1) + 1;
+    unsigned idx_reader = (yac_unordered_map_reader_idx - 1) % YAC_UNORDERED_MAP_NUM_READER;
+    volatile long* arr_cnt = data->arr_reader_[idx_reader].cnt_;
+
+    // The reader is registered in the epoch only if the epoch has not advanced
+    // meanwhile. Otherwise a writer may have missed the registration.
+    while (true) {
+        long epoch = YacUnorderedMapLoadSeq_(&(data->epoch_));
+        unsigned phase = (unsigned)((unsigned long)epoch % 3);
+        YacUnorderedMapFetchAdd_(&(arr_cnt[phase]), 1);
+        if (YacUnorderedMapLoadSeq_(&(data->epoch_)) == epoch)
+            return idx_reader * 3 + phase;
+        YacUnorderedMapFetchAdd_(&(arr_cnt[phase]), -1);
+    }
+}
 
-    unsigned hash = 0xdeadbeef;
+YAC_UNORDERED_MAP_API void YacUnorderedMapReadLeave(YacUnorderedMap* self, unsigned token)
+{
+    YacUnorderedMapData* data = self->data;
+    if (!data->arr_reader_)
+        return;
 
-    // TODO
-    const int nblocks = (const int)size / 4;
-    const unsigned *blocks = (const unsigned*)key;
-    int i;
-    for (i = 0; i < nblocks; i++) {
-        unsigned k = blocks[i];
-        k *= c1;
-        k = (k << r1) | (k >> (32 - r1));
-        k *= c2;
+    YacUnorderedMapFetchAdd_(&(data->arr_reader_[token / 3].cnt_[token % 3]), -1);
+    return;
+}
 
-        hash ^= k;
-        hash = ((hash << r2) | (hash >> (32 - r2))) * m + n;
-    }
+YAC_UNORDERED_MAP_API bool YacUnorderedMapForEach(YacUnorderedMap* self, YacUnorderedMapVisit func,
+                                                  void* arg, unsigned num_thread)
+{
+    YacUnorderedMapShard* arr_shard = YacUnorderedMapRunShards_(self->data, YAC_UNORDERED_MAP_SHARD_FOR_EACH,
+                                                                func, NULL, arg, &num_thread);
+    if (!arr_shard)
+        return false;
 
-    // TODO
-    const uint8_t *tail = (const uint8_t*) ((int*)key + nblocks * 4);
-    unsigned k1 = 0;
+    YAC_ORDERED_MAP_FREE(arr_shard);
+    return true;
+}
 
-    switch (size & 3) {
-        case 3:
-            k1 ^= tail[2] << 16;
-        case 2:
-            k1 ^= tail[1] << 8;
-        case 1:
-            k1 ^= tail[0];
+YAC_UNORDERED_MAP_API YacUnorderedMap* YacUnorderedMapFilter(YacUnorderedMap* self, YacUnorderedMapPredicate func,
+                                                             void* arg, unsigned num_thread)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapShard* arr_shard = YacUnorderedMapRunShards_(data, YAC_UNORDERED_MAP_SHARD_FILTER,
+                                                                NULL, func, arg, &num_thread);
+    if (!arr_shard)
+        return NULL;
 
-            k1 *= c1;
-            k1 = (k1 << r1) | (k1 >> (32 - r1));
-            k1 *= c2;
-            hash ^= k1;
+    bool fail = false;
+    unsigned num_pair = 0;
+    unsigned i;
+    for (i = 0 ; i < num_thread ; ++i) {
+        fail = fail || arr_shard[i].fail_;
+        num_pair += arr_shard[i].num_pair_;
     }
 
-    hash ^= size;
-    hash ^= (hash >> 16);
-    hash *= 0x85ebca6b;
-    hash ^= (hash >> 13);
-    hash *= 0xc2b2ae35;
-    hash ^= (hash >> 16);
+    // The matched keys are distinct, so the shards are merged by bulk insertion.
+    YacUnorderedMap* map = (fail)? NULL : YacUnorderedMapInitWithCapacity(data->flags_, num_pair);
+    if (map) {
+        map->data->func_hash_ = data->func_hash_;
+        map->data->func_seeded_ = data->func_seeded_;
+        map->data->func_cmp_ = data->func_cmp_;
+        for (i = 0 ; i < num_thread ; ++i) {
+            if (!YacUnorderedMapPutMany(map, arr_shard[i].arr_pair_, arr_shard[i].num_pair_)) {
+                YacUnorderedMapDeinit(map);
+                map = NULL;
+                break;
+            }
+        }
+    }
 
-    return hash;
+    for (i = 0 ; i < num_thread ; ++i)
+        YAC_ORDERED_MAP_FREE(arr_shard[i].arr_pair_);
+    YAC_ORDERED_MAP_FREE(arr_shard);
+    return map;
 }
 
-YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashDjb2(char* key)
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapRemoveIf(YacUnorderedMap* self, YacUnorderedMapPredicate func,
+                                                       void* arg, unsigned num_thread)
 {
-    unsigned hash = 5381;
-    int c;
+    YacUnorderedMapData* data = self->data;
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        return YacUnorderedMapCompactRemoveIf_(data, func, arg);
 
-    while ((c = *key++))
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    YacUnorderedMapGatherSize_(data);
 
-    return hash;
-}
+    // The shards unlink nodes from the current slot array only.
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
 
+    YacUnorderedMapShard* arr_shard = YacUnorderedMapRunShards_(data, YAC_UNORDERED_MAP_SHARD_REMOVE_IF,
+                                                                NULL, func, arg, &num_thread);
+    if (!arr_shard)
+        return (unsigned)-1;
 
-//
-// Implementation for internal operations
-//
+    // The node pool is not thread safe, so the nodes are released here.
+    unsigned num_removed = 0;
+    unsigned i;
+    for (i = 0 ; i < num_thread ; ++i) {
+        num_removed += arr_shard[i].num_removed_;
+        data->growth_left_ += arr_shard[i].num_emptied_;
+        YacUnorderedMapSlotNode* curr = arr_shard[i].removed_;
+        while (curr) {
+            YacUnorderedMapSlotNode* pred = curr;
+            curr = curr->next_;
+            YacUnorderedMapNodeFree_(data, pred);
+        }
+    }
+    data->size_ -= (int)num_removed;
 
-static unsigned YacUnorderedMapHash_(void* key)
-{
-    return (unsigned)(intptr_t)key;
+    // The shards unlinked nodes behind the trees.
+    YacUnorderedMapTreeRebuild_(data);
+
+    YAC_ORDERED_MAP_FREE(arr_shard);
+    return num_removed;
 }
 
-static int YacUnorderedMapCompare_(void* lhs, void* rhs)
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetHash(YacUnorderedMap* self, YacUnorderedMapHash func)
 {
-    if ((intptr_t)lhs == (intptr_t)rhs)
-        return 0;
-    return ((intptr_t)lhs > (intptr_t)rhs)? 1 : (-1);
+    self->data->func_hash_ = func;
 }
 
-static void YacUnorderedMapReHash_(YacUnorderedMapData* data)
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetCompare(YacUnorderedMap* self, YacUnorderedMapCompare func)
 {
-    unsigned num_slot_new;
-
+    self->data->func_cmp_ = func;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanKey(YacUnorderedMap* self, YacUnorderedMapCleanKey func)
+{
+    self->data->func_clean_key_ = func;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetCleanValue(YacUnorderedMap* self, YacUnorderedMapCleanValue func)
+{
+    self->data->func_clean_val_ = func;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapSetSeededHash(YacUnorderedMap* self, YacUnorderedMapSeededHash func)
+{
+    self->data->func_seeded_ = func;
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapSetSeed(YacUnorderedMap* self, uint64_t seed0, uint64_t seed1)
+{
+    if (YacUnorderedMapSize(self) != 0)
+        return false;
+
+    self->data->seed_[0] = seed0;
+    self->data->seed_[1] = seed1;
+    return true;
+}
+
+#ifdef YAC_UNORDERED_MAP_STATS
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapGetStats(YacUnorderedMap* self, YacUnorderedMapStats* stats)
+{
+    YacUnorderedMapData* data = self->data;
+
+    stats->size = YacUnorderedMapSize(self);
+    stats->num_slot = data->num_slot_;
+    stats->load_factor = (double)stats->size / (double)data->num_slot_;
+    stats->num_occupied = 0;
+    stats->max_chain = 0;
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_STATS_NUM_BUCKET ; ++i)
+        stats->histogram[i] = 0;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        // Replay the probe sequence of each pair until it reaches the group storing the pair.
+        unsigned mask_group = data->num_slot_ / YAC_UNORDERED_MAP_GROUP_WIDTH - 1;
+        for (i = 0 ; i < data->num_slot_ ; ++i) {
+            if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(data->arr_ctrl_[i]))
+                continue;
+            unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, data->arr_pair_[i].key));
+            unsigned idx_group = (hash >> 7) & mask_group;
+            unsigned step = 0;
+            while (idx_group != i / YAC_UNORDERED_MAP_GROUP_WIDTH && step <= mask_group) {
+                ++step;
+                idx_group = (idx_group + step) & mask_group;
+            }
+            YacUnorderedMapStatChain_(stats, step);
+            ++(stats->num_occupied);
+        }
+    } else if (data->flags_ & YAC_UNORDERED_MAP_COMPACT) {
+        unsigned mask = data->num_slot_ - 1;
+        for (i = 0 ; i < data->num_slot_ ; ++i) {
+            uint32_t slot = data->arr_index_[i];
+            if (slot == YAC_UNORDERED_MAP_INDEX_EMPTY || slot == YAC_UNORDERED_MAP_INDEX_DELETED)
+                continue;
+            void* key = data->arr_pair_[(slot & mask) - 1].key;
+            unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, key));
+            YacUnorderedMapStatChain_(stats, (i - hash) & mask);
+            ++(stats->num_occupied);
+        }
+    } else {
+        // The old slots not migrated yet hold pairs as well.
+        YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
+        unsigned begin = 0;
+        unsigned end = data->num_slot_;
+        while (true) {
+            for (i = begin ; i < end ; ++i) {
+                unsigned length = 0;
+                YacUnorderedMapSlotNode* curr = arr_slot[i];
+                while (curr) {
+                    ++length;
+                    curr = curr->next_;
+                }
+                YacUnorderedMapStatChain_(stats, length);
+                stats->num_occupied += length != 0;
+            }
+            if (arr_slot != data->arr_slot_ || !data->arr_slot_old_)
+                break;
+            arr_slot = data->arr_slot_old_;
+            begin = data->idx_migrate_;
+            end = data->num_slot_old_;
+        }
+    }
+
+    stats->num_get = (uint64_t)data->stat_num_get_;
+    stats->num_probe = (uint64_t)data->stat_num_probe_;
+    stats->avg_probe = (stats->num_get)? (double)stats->num_probe / (double)stats->num_get : 0.0;
+    stats->num_rehash = data->stat_num_rehash_;
+    stats->time_rehash = data->stat_time_rehash_;
+    return;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapResetStats(YacUnorderedMap* self)
+{
+    YacUnorderedMapData* data = self->data;
+    data->stat_num_get_ = 0;
+    data->stat_num_probe_ = 0;
+    data->stat_num_rehash_ = 0;
+    data->stat_time_rehash_ = 0;
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapDumpStats(YacUnorderedMap* self, YacUnorderedMapPrint func, void* arg)
+{
+    YacUnorderedMapStats stats;
+    YacUnorderedMapGetStats(self, &stats);
+
+    char line[128];
+    snprintf(line, sizeof(line), "size %u, slots %u, load factor %.3f",
+             stats.size, stats.num_slot, stats.load_factor);
+    func(line, arg);
+    snprintf(line, sizeof(line), "occupied %u, longest chain %u", stats.num_occupied, stats.max_chain);
+    func(line, arg);
+
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_STATS_NUM_BUCKET ; ++i) {
+        if (stats.histogram[i] == 0)
+            continue;
+        snprintf(line, sizeof(line), "chain %u%s: %u", i,
+                 (i == YAC_UNORDERED_MAP_STATS_NUM_BUCKET - 1)? "+" : "", stats.histogram[i]);
+        func(line, arg);
+    }
+
+    snprintf(line, sizeof(line), "gets %llu, probes %llu, probes per get %.3f",
+             (unsigned long long)stats.num_get, (unsigned long long)stats.num_probe, stats.avg_probe);
+    func(line, arg);
+    snprintf(line, sizeof(line), "rehashes %u, rehash time %.3f ms",
+             stats.num_rehash, (double)stats.time_rehash / 1e6);
+    func(line, arg);
+}
+
+#endif // YAC_UNORDERED_MAP_STATS
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapSave(YacUnorderedMap* self, const char* path, YacUnorderedMapEncode func_key,
+                                               YacUnorderedMapEncode func_value, void* arg)
+{
+    // The slot table keeps the load factor of the maps.
+    unsigned num_pair = YacUnorderedMapSize(self);
+    uint64_t num_slot = 8;
+    while (num_slot / 4 * 3 < num_pair)
+        num_slot <<= 1;
+    if (num_slot > SIZE_MAX / sizeof(uint64_t))
+        return false;
+
+    uint64_t* arr_slot = YAC_ORDERED_MAP_MALLOC((size_t)num_slot * sizeof(uint64_t));
+    if (!arr_slot)
+        return false;
+    memset(arr_slot, 0, (size_t)num_slot * sizeof(uint64_t));
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        YAC_ORDERED_MAP_FREE(arr_slot);
+        return false;
+    }
+
+    // The header is rewritten once the records are placed.
+    YacUnorderedMapSnapshot header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, YAC_UNORDERED_MAP_SNAPSHOT_MAGIC, sizeof(header.magic_));
+    header.version_ = YAC_UNORDERED_MAP_SNAPSHOT_VERSION;
+    header.order_ = YAC_UNORDERED_MAP_SNAPSHOT_ORDER;
+    header.num_slot_ = num_slot;
+    bool fail = fwrite(&header, sizeof(header), 1, file) != 1;
+
+    unsigned char* buf = NULL;
+    size_t cap_buf = 0;
+    uint64_t offset = sizeof(header);
+    uint64_t mask = num_slot - 1;
+
+    YacUnorderedMapIterator iter = YacUnorderedMapBegin(self);
+    YacUnorderedMapPair* pair;
+    while (!fail && (pair = YacUnorderedMapIteratorNext(&iter))) {
+        size_t key_size = func_key(pair->key, NULL, arg);
+        size_t value_size = func_value(pair->value, NULL, arg);
+        if (key_size > UINT32_MAX || value_size > UINT32_MAX || header.num_pair_ == num_pair ||
+            (offset >> 3) > YAC_UNORDERED_MAP_SNAPSHOT_OFFSET) {
+            fail = true;
+            break;
+        }
+
+        size_t key_pad = (key_size + 7) & ~(size_t)7;
+        size_t record_size = 8 + key_pad + ((value_size + 7) & ~(size_t)7);
+        if (record_size > cap_buf) {
+            YAC_ORDERED_MAP_FREE(buf);
+            cap_buf = (record_size > cap_buf * 2)? record_size : cap_buf * 2;
+            buf = YAC_ORDERED_MAP_MALLOC(cap_buf);
+            if (!buf) {
+                fail = true;
+                break;
+            }
+        }
+
+        // The padding is zeroed so that equal maps produce equal files.
+        memset(buf, 0, record_size);
+        uint32_t size32[2] = {(uint32_t)key_size, (uint32_t)value_size};
+        memcpy(buf, size32, sizeof(size32));
+        func_key(pair->key, buf + 8, arg);
+        func_value(pair->value, buf + 8 + key_pad, arg);
+
+        uint64_t hash = YacUnorderedMapHashWy64(buf + 8, key_size, 0);
+        uint64_t pos = hash & mask;
+        while (arr_slot[pos])
+            pos = (pos + 1) & mask;
+        arr_slot[pos] = (hash & ~YAC_UNORDERED_MAP_SNAPSHOT_OFFSET) | (offset >> 3);
+
+        fail = fwrite(buf, 1, record_size, file) != record_size;
+        offset += record_size;
+        ++(header.num_pair_);
+    }
+
+    header.off_slot_ = offset;
+    header.size_file_ = offset + num_slot * sizeof(uint64_t);
+    if (!fail)
+        fail = fwrite(arr_slot, sizeof(uint64_t), (size_t)num_slot, file) != num_slot;
+    if (!fail)
+        fail = fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+    if (fclose(file) != 0)
+        fail = true;
+    if (fail)
+        remove(path);
+
+    YAC_ORDERED_MAP_FREE(buf);
+    YAC_ORDERED_MAP_FREE(arr_slot);
+    return !fail;
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMapView* YacUnorderedMapViewInit(const char* path)
+{
+    void* base = NULL;
+    size_t size = 0;
+    int kind = YAC_UNORDERED_MAP_VIEW_MAPPED;
+
+#if defined(YAC_UNORDERED_MAP_MMAP_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    // The view keeps the mapping alive after the handles are closed.
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = (size_t)file_size.QuadPart;
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#elif defined(YAC_UNORDERED_MAP_MMAP_POSIX)
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return NULL;
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0 && (uint64_t)file_stat.st_size <= SIZE_MAX) {
+        size = (size_t)file_stat.st_size;
+        base = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+        if (base == MAP_FAILED)
+            base = NULL;
+    }
+    close(file);
+#else
+    kind = YAC_UNORDERED_MAP_VIEW_READ;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    long file_size;
+    if (fseek(file, 0, SEEK_END) == 0 && (file_size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        size = (size_t)file_size;
+        base = YAC_ORDERED_MAP_MALLOC(size);
+        if (base && fread(base, 1, size, file) != size) {
+            YAC_ORDERED_MAP_FREE(base);
+            base = NULL;
+        }
+    }
+    fclose(file);
+#endif
+
+    if (!base)
+        return NULL;
+
+    YacUnorderedMapView* obj = YacUnorderedMapViewCreate_(base, size, kind);
+    if (!obj)
+        YacUnorderedMapViewRelease_(base, size, kind);
+    return obj;
+}
+
+YAC_UNORDERED_MAP_API YacUnorderedMapView* YacUnorderedMapViewInitWithBuffer(const void* buf, size_t size)
+{
+    return YacUnorderedMapViewCreate_(buf, size, YAC_UNORDERED_MAP_VIEW_BUFFER);
+}
+
+YAC_UNORDERED_MAP_API void YacUnorderedMapViewDeinit(YacUnorderedMapView* obj)
+{
+    if (!obj)
+        return;
+
+    YacUnorderedMapViewRelease_(obj->base_, obj->size_, obj->kind_);
+    YAC_ORDERED_MAP_FREE(obj);
+    return;
+}
+
+YAC_UNORDERED_MAP_API const void* YacUnorderedMapViewGet(YacUnorderedMapView* self, const void* key, size_t key_size,
+                                                         size_t* value_size)
+{
+    const unsigned char* record = YacUnorderedMapViewFind_(self, key, key_size);
+    if (!record)
+        return NULL;
+
+    const uint32_t* size32 = (const uint32_t*)record;
+    if (value_size)
+        *value_size = size32[1];
+    return record + 8 + ((size32[0] + 7) & ~(size_t)7);
+}
+
+YAC_UNORDERED_MAP_API bool YacUnorderedMapViewContain(YacUnorderedMapView* self, const void* key, size_t key_size)
+{
+    return YacUnorderedMapViewFind_(self, key, key_size) != NULL;
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapViewSize(YacUnorderedMapView* self)
+{
+    return self->num_pair_;
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashMurMur32(void* key, size_t size)
+{
+    if (!key || size == 0)
+        return 0;
+
+    const unsigned c1 = 0xcc9e2d51;
+    const unsigned c2 = 0x1b873593;
+    const unsigned r1 = 15;
+    const unsigned r2 = 13;
+    const unsigned m = 5;
+    const unsigned n = 0xe6546b64;
+
+    unsigned hash = 0xdeadbeef;
+
+    // The blocks are copied out since the key may be unaligned.
+    const unsigned char* bytes = (const unsigned char*)key;
+    const size_t nblocks = size / 4;
+    size_t i;
+    for (i = 0; i < nblocks; i++) {
+        unsigned k = (unsigned)YacUnorderedMapRead4_(bytes + i * 4);
+        k *= c1;
+        k = (k << r1) | (k >> (32 - r1));
+        k *= c2;
+
+        hash ^= k;
+        hash = ((hash << r2) | (hash >> (32 - r2))) * m + n;
+    }
+
+    const uint8_t *tail = bytes + nblocks * 4;
+    unsigned k1 = 0;
+
+    switch (size & 3) {
+        case 3:
+            k1 ^= (unsigned)tail[2] << 16;
+            // fall through
+        case 2:
+            k1 ^= (unsigned)tail[1] << 8;
+            // fall through
+        case 1:
+            k1 ^= tail[0];
+
+            k1 *= c1;
+            k1 = (k1 << r1) | (k1 >> (32 - r1));
+            k1 *= c2;
+            hash ^= k1;
+    }
+
+    hash ^= (unsigned)size;
+    hash ^= (hash >> 16);
+    hash *= 0x85ebca6b;
+    hash ^= (hash >> 13);
+    hash *= 0xc2b2ae35;
+    hash ^= (hash >> 16);
+
+    return hash;
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashDjb2(char* key)
+{
+    unsigned hash = 5381;
+    int c;
+
+    while ((c = *key++))
+        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+
+    return hash;
+}
+
+// The default secret of wyhash.
+static const uint64_t yac_unordered_map_wy_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashWy64(void* key, size_t size, uint64_t seed)
+{
+    const uint64_t* secret = yac_unordered_map_wy_secret;
+    const unsigned char* ptr = (const unsigned char*)key;
+    seed ^= YacUnorderedMapWyMix_(seed ^ secret[0], secret[1]);
+
+    uint64_t lhs, rhs;
+    if (size <= 16) {
+        // The two halves overlap for the keys shorter than 8 bytes.
+        if (size >= 4) {
+            size_t shift = (size >> 3) << 2;
+            lhs = (YacUnorderedMapRead4_(ptr) << 32) | YacUnorderedMapRead4_(ptr + shift);
+            rhs = (YacUnorderedMapRead4_(ptr + size - 4) << 32) | YacUnorderedMapRead4_(ptr + size - 4 - shift);
+        } else if (size > 0) {
+            lhs = ((uint64_t)ptr[0] << 16) | ((uint64_t)ptr[size >> 1] << 8) | ptr[size - 1];
+            rhs = 0;
+        } else {
+            lhs = 0;
+            rhs = 0;
+        }
+    } else {
+        size_t left = size;
+        if (left >= 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed = YacUnorderedMapWyMix_(YacUnorderedMapRead8_(ptr) ^ secret[1], YacUnorderedMapRead8_(ptr + 8) ^ seed);
+                seed1 = YacUnorderedMapWyMix_(YacUnorderedMapRead8_(ptr + 16) ^ secret[2], YacUnorderedMapRead8_(ptr + 24) ^ seed1);
+                seed2 = YacUnorderedMapWyMix_(YacUnorderedMapRead8_(ptr + 32) ^ secret[3], YacUnorderedMapRead8_(ptr + 40) ^ seed2);
+                ptr += 48;
+                left -= 48;
+            } while (left >= 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (left > 16) {
+            seed = YacUnorderedMapWyMix_(YacUnorderedMapRead8_(ptr) ^ secret[1], YacUnorderedMapRead8_(ptr + 8) ^ seed);
+            ptr += 16;
+            left -= 16;
+        }
+
+        // The last 16 bytes of the key, overlapping the consumed ones.
+        lhs = YacUnorderedMapRead8_(ptr + left - 16);
+        rhs = YacUnorderedMapRead8_(ptr + left - 8);
+    }
+
+    lhs ^= secret[1];
+    rhs ^= seed;
+    YacUnorderedMapWyMum_(&lhs, &rhs);
+    return YacUnorderedMapWyMix_(lhs ^ secret[0] ^ (uint64_t)size, rhs ^ secret[1]);
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashWy32(void* key, size_t size)
+{
+    uint64_t hash = YacUnorderedMapHashWy64(key, size, 0);
+    return (unsigned)(hash ^ (hash >> 32));
+}
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSip13(void* key, size_t size, const uint64_t* seed)
+{
+    return YacUnorderedMapSip_((const unsigned char*)key, size, seed, 1, 3);
+}
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSip24(void* key, size_t size, const uint64_t* seed)
+{
+    return YacUnorderedMapSip_((const unsigned char*)key, size, seed, 2, 4);
+}
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSipInt(void* key, const uint64_t* seed)
+{
+    uint64_t value = (uint64_t)(uintptr_t)key;
+    return YacUnorderedMapSip_((const unsigned char*)&value, sizeof(value), seed, 1, 3);
+}
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashSipString(void* key, const uint64_t* seed)
+{
+    return YacUnorderedMapSip_((const unsigned char*)key, strlen((const char*)key), seed, 1, 3);
+}
+
+// The reflected CRC32C table of a nibble.
+static const uint32_t yac_unordered_map_crc32c_nibble[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+    0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9, 0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75,
+};
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashCrc32c(void* key, size_t size)
+{
+    const unsigned char* ptr = (const unsigned char*)key;
+    uint32_t crc = 0xffffffff;
+
+#if defined(YAC_UNORDERED_MAP_CRC32C_SSE42) && (defined(__x86_64__) || defined(_M_X64))
+    for ( ; size >= 8 ; size -= 8, ptr += 8)
+        crc = (uint32_t)_mm_crc32_u64(crc, YacUnorderedMapRead8_(ptr));
+    for ( ; size > 0 ; --size, ++ptr)
+        crc = _mm_crc32_u8(crc, *ptr);
+#elif defined(YAC_UNORDERED_MAP_CRC32C_SSE42)
+    for ( ; size >= 4 ; size -= 4, ptr += 4)
+        crc = _mm_crc32_u32(crc, (uint32_t)YacUnorderedMapRead4_(ptr));
+    for ( ; size > 0 ; --size, ++ptr)
+        crc = _mm_crc32_u8(crc, *ptr);
+#elif defined(YAC_UNORDERED_MAP_CRC32C_ARM)
+    for ( ; size >= 8 ; size -= 8, ptr += 8)
+        crc = __crc32cd(crc, YacUnorderedMapRead8_(ptr));
+    for ( ; size > 0 ; --size, ++ptr)
+        crc = __crc32cb(crc, *ptr);
+#else
+    for ( ; size > 0 ; --size, ++ptr) {
+        crc ^= *ptr;
+        crc = (crc >> 4) ^ yac_unordered_map_crc32c_nibble[crc & 0xf];
+        crc = (crc >> 4) ^ yac_unordered_map_crc32c_nibble[crc & 0xf];
+    }
+#endif
+
+    return (unsigned)~crc;
+}
+
+YAC_UNORDERED_MAP_API unsigned YacUnorderedMapHashString(void* key)
+{
+    return YacUnorderedMapHashWy32(key, strlen((const char*)key));
+}
+
+YAC_UNORDERED_MAP_API uint64_t YacUnorderedMapHashString64(void* key)
+{
+    return YacUnorderedMapHashWy64(key, strlen((const char*)key), 0);
+}
+
+
+//
+// Implementation for internal operations
+//
+
+static unsigned YacUnorderedMapHash_(void* key)
+{
+    return (unsigned)(intptr_t)key;
+}
+
+static unsigned YacUnorderedMapHashOf_(YacUnorderedMapData* data, void* key)
+{
+    if (!(data->flags_ & YAC_UNORDERED_MAP_SEEDED))
+        return data->func_hash_(key);
+
+    uint64_t hash = data->func_seeded_(key, data->seed_);
+    return (unsigned)(hash ^ (hash >> 32));
+}
+
+static void YacUnorderedMapSeed_(YacUnorderedMapData* data)
+{
+    static volatile long num_seed;
+
+    uint64_t entropy = (uint64_t)(uintptr_t)data ^ ((uint64_t)time(NULL) << 24) ^ (uint64_t)clock();
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    entropy ^= __rdtsc();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    entropy ^= __builtin_ia32_rdtsc();
+#endif
+    entropy ^= (uint64_t)YacUnorderedMapFetchAdd_(&num_seed, 1) * 0x9e3779b97f4a7c15ull;
+
+    const uint64_t* secret = yac_unordered_map_wy_secret;
+    data->seed_[0] = YacUnorderedMapWyMix_(entropy ^ secret[0], secret[1]);
+    data->seed_[1] = YacUnorderedMapWyMix_(entropy ^ secret[2], secret[3]);
+    return;
+}
+
+#define YAC_UNORDERED_MAP_ROTL(value, bit) (((value) << (bit)) | ((value) >> (64 - (bit))))
+
+#define YAC_UNORDERED_MAP_SIP_ROUND(v0, v1, v2, v3)                                                        \
+    do {                                                                                                   \
+        v0 += v1; v1 = YAC_UNORDERED_MAP_ROTL(v1, 13); v1 ^= v0; v0 = YAC_UNORDERED_MAP_ROTL(v0, 32);      \
+        v2 += v3; v3 = YAC_UNORDERED_MAP_ROTL(v3, 16); v3 ^= v2;                                           \
+        v0 += v3; v3 = YAC_UNORDERED_MAP_ROTL(v3, 21); v3 ^= v0;                                           \
+        v2 += v1; v1 = YAC_UNORDERED_MAP_ROTL(v1, 17); v1 ^= v2; v2 = YAC_UNORDERED_MAP_ROTL(v2, 32);      \
+    } while (0)
+
+static uint64_t YacUnorderedMapSip_(const unsigned char* ptr, size_t size, const uint64_t* seed,
+                                    int num_c_round, int num_d_round)
+{
+    uint64_t v0 = 0x736f6d6570736575ull ^ seed[0];
+    uint64_t v1 = 0x646f72616e646f6dull ^ seed[1];
+    uint64_t v2 = 0x6c7967656e657261ull ^ seed[0];
+    uint64_t v3 = 0x7465646279746573ull ^ seed[1];
+    int i;
+
+    // Compress the 8 byte words, and then the tail padded with the key length.
+    const unsigned char* end = ptr + (size & ~(size_t)7);
+    for ( ; ptr != end ; ptr += 8) {
+        uint64_t word = YacUnorderedMapRead8_(ptr);
+        v3 ^= word;
+        for (i = 0 ; i < num_c_round ; ++i)
+            YAC_UNORDERED_MAP_SIP_ROUND(v0, v1, v2, v3);
+        v0 ^= word;
+    }
+
+    uint64_t last = (uint64_t)size << 56;
+    switch (size & 7) {
+        case 7:
+            last |= (uint64_t)ptr[6] << 48;
+            // fall through
+        case 6:
+            last |= (uint64_t)ptr[5] << 40;
+            // fall through
+        case 5:
+            last |= (uint64_t)ptr[4] << 32;
+            // fall through
+        case 4:
+            last |= (uint64_t)ptr[3] << 24;
+            // fall through
+        case 3:
+            last |= (uint64_t)ptr[2] << 16;
+            // fall through
+        case 2:
+            last |= (uint64_t)ptr[1] << 8;
+            // fall through
+        case 1:
+            last |= (uint64_t)ptr[0];
+    }
+    v3 ^= last;
+    for (i = 0 ; i < num_c_round ; ++i)
+        YAC_UNORDERED_MAP_SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (i = 0 ; i < num_d_round ; ++i)
+        YAC_UNORDERED_MAP_SIP_ROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static void YacUnorderedMapWyMum_(uint64_t* lhs, uint64_t* rhs)
+{
+#if defined(__SIZEOF_INT128__) && !defined(YAC_UNORDERED_MAP_NO_INT128)
+    __uint128_t product = (__uint128_t)*lhs * *rhs;
+    *lhs = (uint64_t)product;
+    *rhs = (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64) && !defined(YAC_UNORDERED_MAP_NO_INT128)
+    *lhs = _umul128(*lhs, *rhs, rhs);
+#elif defined(_MSC_VER) && defined(_M_ARM64) && !defined(YAC_UNORDERED_MAP_NO_INT128)
+    uint64_t low = *lhs * *rhs;
+    *rhs = __umulh(*lhs, *rhs);
+    *lhs = low;
+#else
+    // Schoolbook multiplication of the 32 bit halves.
+    uint64_t lhs_hi = *lhs >> 32, lhs_lo = (uint32_t)*lhs;
+    uint64_t rhs_hi = *rhs >> 32, rhs_lo = (uint32_t)*rhs;
+    uint64_t hi = lhs_hi * rhs_hi;
+    uint64_t mid0 = lhs_hi * rhs_lo;
+    uint64_t mid1 = rhs_hi * lhs_lo;
+    uint64_t lo = lhs_lo * rhs_lo;
+    uint64_t sum = lo + (mid0 << 32);
+    uint64_t carry = sum < lo;
+    uint64_t low = sum + (mid1 << 32);
+    carry += low < sum;
+    *lhs = low;
+    *rhs = hi + (mid0 >> 32) + (mid1 >> 32) + carry;
+#endif
+    return;
+}
+
+static uint64_t YacUnorderedMapWyMix_(uint64_t lhs, uint64_t rhs)
+{
+    YacUnorderedMapWyMum_(&lhs, &rhs);
+    return lhs ^ rhs;
+}
+
+static uint64_t YacUnorderedMapRead8_(const unsigned char* ptr)
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static uint64_t YacUnorderedMapRead4_(const unsigned char* ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static int YacUnorderedMapCompare_(void* lhs, void* rhs)
+{
+    if ((intptr_t)lhs == (intptr_t)rhs)
+        return 0;
+    return ((intptr_t)lhs > (intptr_t)rhs)? 1 : (-1);
+}
+
+static void YacUnorderedMapReHash_(YacUnorderedMapData* data)
+{
+    unsigned num_slot_new;
+
+    // Finish the previous incremental rehashing first.
+    if (data->arr_slot_old_)
+        YacUnorderedMapReHashStep_(data, data->num_slot_old_);
+
+    // Double the slot array for the power of two sizing, which stops at 2^31
+    // slots like YacUnorderedMapFitSlot_ since the count wraps beyond.
+    if (data->flags_ & YAC_UNORDERED_MAP_POWER_OF_TWO) {
+        if (data->num_slot_ >= (1u << 31))
+            return;
+        num_slot_new = data->num_slot_ * 2;
+    }
     // Consume the next prime for slot array extension.
-    if (data->idx_prime_ < (yac_unordered_map_num_prime - 1)) {
+    else if (data->idx_prime_ < (yac_unordered_map_num_prime - 1)) {
         ++(data->idx_prime_);
         num_slot_new = yac_unordered_map_magic_primes[data->idx_prime_];
     }
-    // If the prime list is completely consumed, we simply extend the slot array with treble capacity.
-    else {
-        data->idx_prime_ = yac_unordered_map_num_prime;
-        num_slot_new = data->num_slot_ * 3;
+    // If the prime list is completely consumed, we simply extend the slot array with treble capacity.
+    else {
+        data->idx_prime_ = yac_unordered_map_num_prime;
+        num_slot_new = data->num_slot_ * 3;
+    }
+
+    // The rehashing should be canceled due to insufficient memory space.
+    if (!YacUnorderedMapReHashTo_(data, num_slot_new)) {
+        if (!(data->flags_ & YAC_UNORDERED_MAP_POWER_OF_TWO) && data->idx_prime_ < yac_unordered_map_num_prime)
+            --(data->idx_prime_);
+    }
+    return;
+}
+
+static bool YacUnorderedMapReHashTo_(YacUnorderedMapData* data, unsigned num_slot_new)
+{
+    YAC_UNORDERED_MAP_STAT_CLOCK(start);
+
+    // Try to allocate the new slot array.
+    YacUnorderedMapSlotNode** arr_slot_new = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapSlotNode*) * num_slot_new);
+    if (!arr_slot_new)
+        return false;
+
+    unsigned i;
+    for (i = 0 ; i < num_slot_new ; ++i)
+        arr_slot_new[i] = NULL;
+
+    // Keep the current slot array for the following operations to drain.
+    if (data->flags_ & YAC_UNORDERED_MAP_INCREMENTAL_REHASH) {
+        data->arr_slot_old_ = data->arr_slot_;
+        data->num_slot_old_ = data->num_slot_;
+        data->idx_migrate_ = 0;
+        data->arr_slot_ = arr_slot_new;
+        data->num_slot_ = num_slot_new;
+        data->curr_limit_ = (unsigned)((double)num_slot_new * yac_unordered_map_load_factor);
+        YAC_UNORDERED_MAP_STAT_REHASH(data, start, 1);
+        return true;
+    }
+
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
+    unsigned num_slot = data->num_slot_;
+    for (i = 0 ; i < num_slot ; ++i) {
+        YacUnorderedMapSlotNode* pred;
+        YacUnorderedMapSlotNode* curr = arr_slot[i];
+        while (curr) {
+            pred = curr;
+            curr = curr->next_;
+
+            // Migrate each key value pair to the new slot.
+            unsigned hash = (cache_hash)? pred->hash_ : YacUnorderedMapHashOf_(data, pred->pair_.key);
+            hash = YacUnorderedMapIndex_(data, hash, num_slot_new);
+            if (!arr_slot_new[hash]) {
+                pred->next_ = NULL;
+                arr_slot_new[hash] = pred;
+            } else {
+                pred->next_ = arr_slot_new[hash];
+                arr_slot_new[hash] = pred;
+            }
+        }
+    }
+
+    YAC_ORDERED_MAP_FREE(arr_slot);
+    data->arr_slot_ = arr_slot_new;
+    data->num_slot_ = num_slot_new;
+    data->curr_limit_ = (unsigned)((double)num_slot_new * yac_unordered_map_load_factor);
+
+    // Reached with exclusive access only, so the readers need no protection.
+    if (data->table_) {
+        data->table_->arr_slot_ = arr_slot_new;
+        data->table_->num_slot_ = num_slot_new;
+    }
+
+    YacUnorderedMapTreeRebuild_(data);
+    YAC_UNORDERED_MAP_STAT_REHASH(data, start, 1);
+    return true;
+}
+
+#ifdef YAC_UNORDERED_MAP_STATS
+
+static void YacUnorderedMapStatGet_(YacUnorderedMapData* data, unsigned num_probe)
+{
+    // Gets may run in parallel on every map without incremental rehashing.
+#if defined(_MSC_VER)
+    _InterlockedExchangeAdd64(&(data->stat_num_get_), 1);
+    _InterlockedExchangeAdd64(&(data->stat_num_probe_), num_probe);
+#else
+    __atomic_fetch_add(&(data->stat_num_get_), 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(data->stat_num_probe_), num_probe, __ATOMIC_RELAXED);
+#endif
+}
+
+static void YacUnorderedMapStatReHash_(YacUnorderedMapData* data, uint64_t start, unsigned num_rehash)
+{
+    data->stat_num_rehash_ += num_rehash;
+    data->stat_time_rehash_ += YacUnorderedMapStatClock_() - start;
+}
+
+static uint64_t YacUnorderedMapStatClock_(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void YacUnorderedMapStatChain_(YacUnorderedMapStats* stats, unsigned length)
+{
+    unsigned bucket = (length < YAC_UNORDERED_MAP_STATS_NUM_BUCKET)? length : YAC_UNORDERED_MAP_STATS_NUM_BUCKET - 1;
+    ++(stats->histogram[bucket]);
+    if (length > stats->max_chain)
+        stats->max_chain = length;
+}
+
+#endif // YAC_UNORDERED_MAP_STATS
+
+static YacUnorderedMapBin* YacUnorderedMapBin_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot)
+{
+    // Treeified maps never have an old slot array.
+    if (!data->arr_bin_)
+        return NULL;
+    return data->arr_bin_[slot - data->arr_slot_];
+}
+
+static YacUnorderedMapSlotNode* YacUnorderedMapChainFind_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                                          void* key, unsigned hash, unsigned* length)
+{
+    *length = 0;
+    YacUnorderedMapBin* bin = YacUnorderedMapBin_(data, slot);
+    if (bin) {
+        YacUnorderedMapTreeNode* tree = YacUnorderedMapTreeFind_(data, bin->root_, key, hash, length);
+        return (tree)? tree->node_ : NULL;
+    }
+
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    YacUnorderedMapSlotNode* curr = *slot;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0)
+            return curr;
+        ++(*length);
+        curr = curr->next_;
+    }
+    return NULL;
+}
+
+static bool YacUnorderedMapChainLink_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                      YacUnorderedMapSlotNode* node, unsigned hash, unsigned length)
+{
+    YacUnorderedMapBin* bin = YacUnorderedMapBin_(data, slot);
+    if (bin) {
+        YacUnorderedMapTreeNode* tree = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapTreeNode));
+        if (!tree)
+            return false;
+        tree->left_ = NULL;
+        tree->right_ = NULL;
+        tree->prev_ = NULL;
+        tree->next_ = bin->head_;
+        tree->node_ = node;
+        tree->hash_ = hash;
+        tree->height_ = 1;
+        if (bin->head_)
+            bin->head_->prev_ = tree;
+        bin->head_ = tree;
+        bin->root_ = YacUnorderedMapTreeInsert_(data, bin->root_, tree);
+    }
+
+    node->next_ = *slot;
+    *slot = node;
+
+    if (!bin && (data->flags_ & YAC_UNORDERED_MAP_TREEIFY) && length + 1 >= YAC_UNORDERED_MAP_TREEIFY_THRESHOLD)
+        YacUnorderedMapTreeify_(data, slot);
+    return true;
+}
+
+static YacUnorderedMapSlotNode* YacUnorderedMapBinUnlink_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot,
+                                                          YacUnorderedMapTreeNode* tree)
+{
+    YacUnorderedMapBin* bin = YacUnorderedMapBin_(data, slot);
+    YacUnorderedMapSlotNode* node = tree->node_;
+    if (tree->prev_) {
+        tree->prev_->node_->next_ = node->next_;
+        tree->prev_->next_ = tree->next_;
+    } else {
+        *slot = node->next_;
+        bin->head_ = tree->next_;
+    }
+    if (tree->next_)
+        tree->next_->prev_ = tree->prev_;
+
+    bin->root_ = YacUnorderedMapTreeErase_(data, bin->root_, tree);
+    YAC_ORDERED_MAP_FREE(tree);
+
+    // An emptied slot turns back into a plain list.
+    if (!bin->root_) {
+        data->arr_bin_[slot - data->arr_slot_] = NULL;
+        YAC_ORDERED_MAP_FREE(bin);
+    }
+    return node;
+}
+
+static void YacUnorderedMapTreeify_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** slot)
+{
+    if (!data->arr_bin_) {
+        YacUnorderedMapBin** arr_bin = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapBin*) * data->num_slot_);
+        if (!arr_bin)
+            return;
+        unsigned i;
+        for (i = 0 ; i < data->num_slot_ ; ++i)
+            arr_bin[i] = NULL;
+        data->arr_bin_ = arr_bin;
+        data->num_bin_ = data->num_slot_;
+    }
+
+    YacUnorderedMapBin* bin = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapBin));
+    if (!bin)
+        return;
+    bin->root_ = NULL;
+    bin->head_ = NULL;
+
+    // Index the nodes in the order of the slot list.
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapTreeNode* tail = NULL;
+    YacUnorderedMapSlotNode* curr = *slot;
+    while (curr) {
+        YacUnorderedMapTreeNode* tree = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapTreeNode));
+        if (!tree) {
+            while (tail) {
+                YacUnorderedMapTreeNode* pred = tail;
+                tail = tail->prev_;
+                YAC_ORDERED_MAP_FREE(pred);
+            }
+            YAC_ORDERED_MAP_FREE(bin);
+            return;
+        }
+        tree->left_ = NULL;
+        tree->right_ = NULL;
+        tree->prev_ = tail;
+        tree->next_ = NULL;
+        tree->node_ = curr;
+        tree->hash_ = (cache_hash)? curr->hash_ : YacUnorderedMapHashOf_(data, curr->pair_.key);
+        tree->height_ = 1;
+        if (tail)
+            tail->next_ = tree;
+        else
+            bin->head_ = tree;
+        tail = tree;
+        bin->root_ = YacUnorderedMapTreeInsert_(data, bin->root_, tree);
+        curr = curr->next_;
+    }
+
+    data->arr_bin_[slot - data->arr_slot_] = bin;
+    return;
+}
+
+static void YacUnorderedMapTreeRelease_(YacUnorderedMapData* data)
+{
+    if (!data->arr_bin_)
+        return;
+
+    // The slot array may be replaced already.
+    unsigned i;
+    for (i = 0 ; i < data->num_bin_ ; ++i) {
+        YacUnorderedMapBin* bin = data->arr_bin_[i];
+        if (!bin)
+            continue;
+        YacUnorderedMapTreeNode* curr = bin->head_;
+        while (curr) {
+            YacUnorderedMapTreeNode* pred = curr;
+            curr = curr->next_;
+            YAC_ORDERED_MAP_FREE(pred);
+        }
+        YAC_ORDERED_MAP_FREE(bin);
+    }
+    YAC_ORDERED_MAP_FREE(data->arr_bin_);
+    data->arr_bin_ = NULL;
+    data->num_bin_ = 0;
+    return;
+}
+
+static void YacUnorderedMapTreeRebuild_(YacUnorderedMapData* data)
+{
+    if (!(data->flags_ & YAC_UNORDERED_MAP_TREEIFY))
+        return;
+
+    YacUnorderedMapTreeRelease_(data);
+
+    unsigned i;
+    for (i = 0 ; i < data->num_slot_ ; ++i) {
+        unsigned length = 0;
+        YacUnorderedMapSlotNode* curr = data->arr_slot_[i];
+        while (curr && length < YAC_UNORDERED_MAP_TREEIFY_THRESHOLD) {
+            ++length;
+            curr = curr->next_;
+        }
+        if (length >= YAC_UNORDERED_MAP_TREEIFY_THRESHOLD)
+            YacUnorderedMapTreeify_(data, &(data->arr_slot_[i]));
+    }
+    return;
+}
+
+static int YacUnorderedMapTreeOrder_(YacUnorderedMapData* data, unsigned hash, void* key, YacUnorderedMapTreeNode* tree)
+{
+    if (hash != tree->hash_)
+        return (hash < tree->hash_)? (-1) : 1;
+    return data->func_cmp_(key, tree->node_->pair_.key);
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeFind_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* tree,
+                                                         void* key, unsigned hash, unsigned* length)
+{
+    *length = 0;
+    while (tree) {
+        int order = YacUnorderedMapTreeOrder_(data, hash, key, tree);
+        if (order == 0)
+            return tree;
+        ++(*length);
+        tree = (order < 0)? tree->left_ : tree->right_;
+    }
+    return NULL;
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeInsert_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* root,
+                                                           YacUnorderedMapTreeNode* tree)
+{
+    if (!root)
+        return tree;
+
+    if (YacUnorderedMapTreeOrder_(data, tree->hash_, tree->node_->pair_.key, root) < 0)
+        root->left_ = YacUnorderedMapTreeInsert_(data, root->left_, tree);
+    else
+        root->right_ = YacUnorderedMapTreeInsert_(data, root->right_, tree);
+    return YacUnorderedMapTreeBalance_(root);
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeErase_(YacUnorderedMapData* data, YacUnorderedMapTreeNode* root,
+                                                          YacUnorderedMapTreeNode* tree)
+{
+    // The erased node is replaced by the minimum of its right subtree.
+    if (root == tree) {
+        if (!tree->left_)
+            return tree->right_;
+        if (!tree->right_)
+            return tree->left_;
+        YacUnorderedMapTreeNode* min;
+        YacUnorderedMapTreeNode* right = YacUnorderedMapTreeRemoveMin_(tree->right_, &min);
+        min->left_ = tree->left_;
+        min->right_ = right;
+        return YacUnorderedMapTreeBalance_(min);
+    }
+
+    if (YacUnorderedMapTreeOrder_(data, tree->hash_, tree->node_->pair_.key, root) < 0)
+        root->left_ = YacUnorderedMapTreeErase_(data, root->left_, tree);
+    else
+        root->right_ = YacUnorderedMapTreeErase_(data, root->right_, tree);
+    return YacUnorderedMapTreeBalance_(root);
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeRemoveMin_(YacUnorderedMapTreeNode* root, YacUnorderedMapTreeNode** min)
+{
+    if (!root->left_) {
+        *min = root;
+        return root->right_;
+    }
+    root->left_ = YacUnorderedMapTreeRemoveMin_(root->left_, min);
+    return YacUnorderedMapTreeBalance_(root);
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeBalance_(YacUnorderedMapTreeNode* tree)
+{
+    int height_left = YacUnorderedMapTreeHeight_(tree->left_);
+    int height_right = YacUnorderedMapTreeHeight_(tree->right_);
+
+    if (height_left > height_right + 1) {
+        YacUnorderedMapTreeNode* child = tree->left_;
+        if (YacUnorderedMapTreeHeight_(child->left_) < YacUnorderedMapTreeHeight_(child->right_))
+            tree->left_ = YacUnorderedMapTreeRotate_(child, true);
+        return YacUnorderedMapTreeRotate_(tree, false);
+    }
+    if (height_right > height_left + 1) {
+        YacUnorderedMapTreeNode* child = tree->right_;
+        if (YacUnorderedMapTreeHeight_(child->right_) < YacUnorderedMapTreeHeight_(child->left_))
+            tree->right_ = YacUnorderedMapTreeRotate_(child, false);
+        return YacUnorderedMapTreeRotate_(tree, true);
+    }
+
+    tree->height_ = ((height_left > height_right)? height_left : height_right) + 1;
+    return tree;
+}
+
+static YacUnorderedMapTreeNode* YacUnorderedMapTreeRotate_(YacUnorderedMapTreeNode* tree, bool left)
+{
+    YacUnorderedMapTreeNode* pivot;
+    if (left) {
+        pivot = tree->right_;
+        tree->right_ = pivot->left_;
+        pivot->left_ = tree;
+    } else {
+        pivot = tree->left_;
+        tree->left_ = pivot->right_;
+        pivot->right_ = tree;
+    }
+
+    // The demoted node is updated before its new parent.
+    int height_left = YacUnorderedMapTreeHeight_(tree->left_);
+    int height_right = YacUnorderedMapTreeHeight_(tree->right_);
+    tree->height_ = ((height_left > height_right)? height_left : height_right) + 1;
+    height_left = YacUnorderedMapTreeHeight_(pivot->left_);
+    height_right = YacUnorderedMapTreeHeight_(pivot->right_);
+    pivot->height_ = ((height_left > height_right)? height_left : height_right) + 1;
+    return pivot;
+}
+
+static int YacUnorderedMapTreeHeight_(YacUnorderedMapTreeNode* tree)
+{
+    return (tree)? tree->height_ : 0;
+}
+
+static YacUnorderedMapSlotNode* YacUnorderedMapNodeAlloc_(YacUnorderedMapData* data)
+{
+    if (!(data->flags_ & YAC_UNORDERED_MAP_NODE_POOL))
+        return YAC_ORDERED_MAP_MALLOC(data->node_size_);
+
+    // Reuse a recycled node first.
+    if (data->pool_free_) {
+        void* node = data->pool_free_;
+        data->pool_free_ = *(void**)node;
+        return node;
+    }
+
+    // Carve the node out of the newest chunk, and append a chunk when it is used up.
+    if (!data->pool_chunk_ || data->pool_used_ == YAC_UNORDERED_MAP_POOL_CHUNK) {
+        void** chunk = YAC_ORDERED_MAP_MALLOC(sizeof(void*) + (size_t)data->node_size_ * YAC_UNORDERED_MAP_POOL_CHUNK);
+        if (!chunk)
+            return NULL;
+        *chunk = data->pool_chunk_;
+        data->pool_chunk_ = chunk;
+        data->pool_used_ = 0;
+    }
+
+    char* base = (char*)data->pool_chunk_ + sizeof(void*);
+    return (YacUnorderedMapSlotNode*)(base + (size_t)data->node_size_ * (data->pool_used_)++);
+}
+
+static void YacUnorderedMapNodeFree_(YacUnorderedMapData* data, YacUnorderedMapSlotNode* node)
+{
+    if (!(data->flags_ & YAC_UNORDERED_MAP_NODE_POOL)) {
+        YAC_ORDERED_MAP_FREE(node);
+        return;
+    }
+
+    *(void**)node = data->pool_free_;
+    data->pool_free_ = node;
+    return;
+}
+
+static void YacUnorderedMapReleaseSlot_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** arr_slot,
+                                        unsigned begin, unsigned end)
+{
+    YacUnorderedMapCleanKey func_clean_key = data->func_clean_key_;
+    YacUnorderedMapCleanValue func_clean_val = data->func_clean_val_;
+    bool pool = (data->flags_ & YAC_UNORDERED_MAP_NODE_POOL) != 0;
+
+    // Pooled nodes are released together with their chunks, so the slot lists
+    // are only walked if there are cleanup functions to call.
+    if (pool && !func_clean_key && !func_clean_val)
+        return;
+
+    unsigned i;
+    for (i = begin ; i < end ; ++i) {
+        YacUnorderedMapSlotNode* pred;
+        YacUnorderedMapSlotNode* curr = arr_slot[i];
+        while (curr) {
+            pred = curr;
+            curr = curr->next_;
+            if (func_clean_key)
+                func_clean_key(pred->pair_.key);
+            if (func_clean_val)
+                func_clean_val(pred->pair_.value);
+            if (!pool)
+                YAC_ORDERED_MAP_FREE(pred);
+        }
+    }
+    return;
+}
+
+static void YacUnorderedMapClearSlot_(YacUnorderedMapData* data, YacUnorderedMapSlotNode** arr_slot,
+                                      unsigned begin, unsigned end)
+{
+    YacUnorderedMapCleanKey func_clean_key = data->func_clean_key_;
+    YacUnorderedMapCleanValue func_clean_val = data->func_clean_val_;
+
+    unsigned i;
+    for (i = begin ; i < end ; ++i) {
+        YacUnorderedMapSlotNode* pred;
+        YacUnorderedMapSlotNode* curr = arr_slot[i];
+        while (curr) {
+            pred = curr;
+            curr = curr->next_;
+            if (func_clean_key)
+                func_clean_key(pred->pair_.key);
+            if (func_clean_val)
+                func_clean_val(pred->pair_.value);
+            YacUnorderedMapNodeFree_(data, pred);
+        }
+        arr_slot[i] = NULL;
+    }
+    return;
+}
+
+static void YacUnorderedMapPoolRelease_(YacUnorderedMapData* data)
+{
+    void* chunk = data->pool_chunk_;
+    while (chunk) {
+        void* prev = *(void**)chunk;
+        YAC_ORDERED_MAP_FREE(chunk);
+        chunk = prev;
+    }
+
+    data->pool_chunk_ = NULL;
+    data->pool_free_ = NULL;
+    data->pool_used_ = 0;
+    return;
+}
+
+static unsigned YacUnorderedMapFitSlot_(unsigned flags, unsigned capacity, int* idx_prime)
+{
+    unsigned num_slot;
+    *idx_prime = 0;
+
+    if (flags & YAC_UNORDERED_MAP_FLAT)
+        return YacUnorderedMapFlatFitSlot_(capacity);
+
+    if (flags & YAC_UNORDERED_MAP_POWER_OF_TWO) {
+        num_slot = YAC_UNORDERED_MAP_POW2_INIT_SLOT;
+        while ((double)num_slot * yac_unordered_map_load_factor < (double)capacity && num_slot < (1u << 31))
+            num_slot *= 2;
+        return num_slot;
+    }
+
+    // Walk the prime table, and extend the last prime with treble capacity like rehashing does.
+    while (*idx_prime < (yac_unordered_map_num_prime - 1) &&
+            (double)yac_unordered_map_magic_primes[*idx_prime] * yac_unordered_map_load_factor < (double)capacity)
+        ++(*idx_prime);
+    num_slot = yac_unordered_map_magic_primes[*idx_prime];
+    while ((double)num_slot * yac_unordered_map_load_factor < (double)capacity && num_slot < (1u << 30)) {
+        *idx_prime = yac_unordered_map_num_prime;
+        num_slot *= 3;
+    }
+    return num_slot;
+}
+
+static void YacUnorderedMapReHashStep_(YacUnorderedMapData* data, unsigned num_step)
+{
+    YAC_UNORDERED_MAP_STAT_CLOCK(start);
+
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapSlotNode** arr_slot_old = data->arr_slot_old_;
+    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
+    unsigned num_slot = data->num_slot_;
+    unsigned num_slot_old = data->num_slot_old_;
+
+    while (num_step > 0 && data->idx_migrate_ < num_slot_old) {
+        YacUnorderedMapSlotNode* pred;
+        YacUnorderedMapSlotNode* curr = arr_slot_old[data->idx_migrate_];
+        while (curr) {
+            pred = curr;
+            curr = curr->next_;
+
+            // Migrate each key value pair to the new slot.
+            unsigned hash = (cache_hash)? pred->hash_ : YacUnorderedMapHashOf_(data, pred->pair_.key);
+            hash = YacUnorderedMapIndex_(data, hash, num_slot);
+            pred->next_ = arr_slot[hash];
+            arr_slot[hash] = pred;
+        }
+        arr_slot_old[data->idx_migrate_] = NULL;
+        ++(data->idx_migrate_);
+        --num_step;
+    }
+
+    // Release the old slot array once it is completely drained.
+    if (data->idx_migrate_ == num_slot_old) {
+        YAC_ORDERED_MAP_FREE(arr_slot_old);
+        data->arr_slot_old_ = NULL;
+        data->num_slot_old_ = 0;
+        data->idx_migrate_ = 0;
+    }
+
+    YAC_UNORDERED_MAP_STAT_REHASH(data, start, 0);
+    return;
+}
+
+static YacUnorderedMapSlotNode** YacUnorderedMapSlot_(YacUnorderedMapData* data, unsigned hash)
+{
+    // The old slot is searched until it is migrated.
+    if (data->arr_slot_old_) {
+        unsigned idx_old = YacUnorderedMapIndex_(data, hash, data->num_slot_old_);
+        if (idx_old >= data->idx_migrate_)
+            return &(data->arr_slot_old_[idx_old]);
+    }
+    return &(data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)]);
+}
+
+static unsigned YacUnorderedMapIndex_(YacUnorderedMapData* data, unsigned hash, unsigned num_slot)
+{
+    if (data->flags_ & YAC_UNORDERED_MAP_POWER_OF_TWO)
+        return YacUnorderedMapMix_(hash) & (num_slot - 1);
+    return hash % num_slot;
+}
+
+static bool YacUnorderedMapFlatAlloc_(YacUnorderedMapData* data, unsigned num_slot)
+{
+    unsigned char* arr_ctrl = YacUnorderedMapFlatAllocCtrl_(num_slot);
+    if (!arr_ctrl)
+        return false;
+
+    YacUnorderedMapPair* arr_pair = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapPair) * num_slot);
+    if (!arr_pair) {
+        YAC_UNORDERED_MAP_FREE(arr_ctrl);
+        return false;
+    }
+
+    data->arr_ctrl_ = arr_ctrl;
+    data->arr_pair_ = arr_pair;
+    data->num_slot_ = num_slot;
+    data->curr_limit_ = num_slot - num_slot / 8;
+    data->growth_left_ = data->curr_limit_ - (unsigned)data->size_;
+    return true;
+}
+
+static unsigned YacUnorderedMapFlatFind_(YacUnorderedMapData* data, void* key, unsigned hash, unsigned* num_group)
+{
+    unsigned char tag = (unsigned char)(hash & 0x7f);
+    unsigned mask_group = data->num_slot_ / YAC_UNORDERED_MAP_GROUP_WIDTH - 1;
+    unsigned idx_group = (hash >> 7) & mask_group;
+    unsigned step = 0;
+
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    unsigned char* arr_ctrl = data->arr_ctrl_;
+    YacUnorderedMapPair* arr_pair = data->arr_pair_;
+    while (true) {
+        // Only the slots carrying the same tag are compared with the key.
+        unsigned base = idx_group * YAC_UNORDERED_MAP_GROUP_WIDTH;
+        unsigned match = YacUnorderedMapGroupMatch_(arr_ctrl + base, tag);
+        while (match) {
+            unsigned idx = base + YacUnorderedMapCtz_(match);
+            if (func_cmp(key, arr_pair[idx].key) == 0) {
+                *num_group = step + 1;
+                return idx;
+            }
+            match &= match - 1;
+        }
+
+        // A group having an empty slot terminates the probe sequence.
+        *num_group = step + 1;
+        if (YacUnorderedMapGroupMatchEmpty_(arr_ctrl + base))
+            return data->num_slot_;
+
+        // Triangular probing visits every group once for power of two group counts.
+        ++step;
+        if (step > mask_group)
+            return data->num_slot_;
+        idx_group = (idx_group + step) & mask_group;
+    }
+}
+
+static bool YacUnorderedMapFlatReHash_(YacUnorderedMapData* data, unsigned num_slot_new)
+{
+    YAC_UNORDERED_MAP_STAT_CLOCK(start);
+
+    unsigned char* arr_ctrl = data->arr_ctrl_;
+    YacUnorderedMapPair* arr_pair = data->arr_pair_;
+    unsigned num_slot = data->num_slot_;
+
+    // The old arrays are kept if the new ones cannot be allocated.
+    if (!YacUnorderedMapFlatAlloc_(data, num_slot_new))
+        return false;
+
+    // Migrate each key value pair to the new slot.
+    unsigned i;
+    for (i = 0 ; i < num_slot ; ++i) {
+        if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[i]))
+            continue;
+        unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, arr_pair[i].key));
+        unsigned idx = YacUnorderedMapFlatFindFree_(data->arr_ctrl_, data->num_slot_, hash);
+        data->arr_ctrl_[idx] = (unsigned char)(hash & 0x7f);
+        data->arr_pair_[idx] = arr_pair[i];
+    }
+
+    YAC_UNORDERED_MAP_FREE(arr_ctrl);
+    YAC_ORDERED_MAP_FREE(arr_pair);
+    YAC_UNORDERED_MAP_STAT_REHASH(data, start, 1);
+    return true;
+}
+
+static bool YacUnorderedMapFlatPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    hash = YacUnorderedMapMix_(hash);
+
+    // Check if the pair conflicts with a certain one stored in the map. If yes, replace that one.
+    unsigned num_group;
+    unsigned idx = YacUnorderedMapFlatFind_(data, key, hash, &num_group);
+    if (idx != data->num_slot_) {
+        YacUnorderedMapPair* pair = &(data->arr_pair_[idx]);
+        if (data->func_clean_key_)
+            data->func_clean_key_(pair->key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(pair->value);
+        pair->key = key;
+        pair->value = value;
+        return true;
+    }
+
+    // Rebuild the arrays if no empty slot can be consumed.
+    if (data->growth_left_ == 0) {
+        unsigned num_slot_new = YacUnorderedMapFlatGrowSlot_((unsigned)data->size_, data->num_slot_, data->curr_limit_);
+        if (num_slot_new == 0 || !YacUnorderedMapFlatReHash_(data, num_slot_new))
+            return false;
+    }
+
+    idx = YacUnorderedMapFlatFindFree_(data->arr_ctrl_, data->num_slot_, hash);
+    if (data->arr_ctrl_[idx] == YAC_UNORDERED_MAP_CTRL_EMPTY)
+        --(data->growth_left_);
+    data->arr_ctrl_[idx] = (unsigned char)(hash & 0x7f);
+    data->arr_pair_[idx].key = key;
+    data->arr_pair_[idx].value = value;
+    ++(data->size_);
+
+    return true;
+}
+
+static void* YacUnorderedMapFlatGet_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    hash = YacUnorderedMapMix_(hash);
+    unsigned num_group;
+    unsigned idx = YacUnorderedMapFlatFind_(data, key, hash, &num_group);
+    YAC_UNORDERED_MAP_STAT_GET(data, num_group);
+    if (idx != data->num_slot_)
+        return data->arr_pair_[idx].value;
+    return NULL;
+}
+
+static bool YacUnorderedMapFlatContain_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    hash = YacUnorderedMapMix_(hash);
+    unsigned num_group;
+    return YacUnorderedMapFlatFind_(data, key, hash, &num_group) != data->num_slot_;
+}
+
+static bool YacUnorderedMapFlatRemove_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    hash = YacUnorderedMapMix_(hash);
+    unsigned num_group;
+    unsigned idx = YacUnorderedMapFlatFind_(data, key, hash, &num_group);
+    if (idx == data->num_slot_)
+        return false;
+
+    YacUnorderedMapPair* pair = &(data->arr_pair_[idx]);
+    if (data->func_clean_key_)
+        data->func_clean_key_(pair->key);
+    if (data->func_clean_val_)
+        data->func_clean_val_(pair->value);
+
+    if (YacUnorderedMapFlatErase_(data->arr_ctrl_, idx))
+        ++(data->growth_left_);
+
+    --(data->size_);
+    return true;
+}
+
+static YacUnorderedMapPair* YacUnorderedMapFlatEntry_(YacUnorderedMapData* data, void* key,
+                                                      unsigned hash, bool* inserted)
+{
+    unsigned num_group;
+    unsigned idx = YacUnorderedMapFlatFind_(data, key, hash, &num_group);
+    if (idx != data->num_slot_)
+        return &(data->arr_pair_[idx]);
+
+    if (data->growth_left_ == 0) {
+        unsigned num_slot_new = YacUnorderedMapFlatGrowSlot_((unsigned)data->size_, data->num_slot_, data->curr_limit_);
+        if (num_slot_new == 0 || !YacUnorderedMapFlatReHash_(data, num_slot_new))
+            return NULL;
+    }
+
+    idx = YacUnorderedMapFlatFindFree_(data->arr_ctrl_, data->num_slot_, hash);
+    if (data->arr_ctrl_[idx] == YAC_UNORDERED_MAP_CTRL_EMPTY)
+        --(data->growth_left_);
+    data->arr_ctrl_[idx] = (unsigned char)(hash & 0x7f);
+    data->arr_pair_[idx].key = key;
+    data->arr_pair_[idx].value = NULL;
+    ++(data->size_);
+
+    *inserted = true;
+    return &(data->arr_pair_[idx]);
+}
+
+static void YacUnorderedMapLockInit_(YacUnorderedMapLock* lock)
+{
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+    InitializeSRWLock(lock);
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+    pthread_mutex_init(lock, NULL);
+#else
+    *lock = 0;
+#endif
+}
+
+static void YacUnorderedMapLockDeinit_(YacUnorderedMapLock* lock)
+{
+#if defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+    pthread_mutex_destroy(lock);
+#else
+    (void)lock;
+#endif
+}
+
+static void YacUnorderedMapLockAcquire_(YacUnorderedMapLock* lock)
+{
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+    AcquireSRWLockExclusive(lock);
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+    pthread_mutex_lock(lock);
+#else
+    (void)lock;
+#endif
+}
+
+static void YacUnorderedMapLockRelease_(YacUnorderedMapLock* lock)
+{
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+    ReleaseSRWLockExclusive(lock);
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+    pthread_mutex_unlock(lock);
+#else
+    (void)lock;
+#endif
+}
+
+static YacUnorderedMapStripe* YacUnorderedMapStripe_(YacUnorderedMapData* data, unsigned hash)
+{
+    // The slot count is a multiple of the stripe count, so all the pairs of a
+    // slot map to the same stripe at every size.
+    return &(data->arr_stripe_[YacUnorderedMapMix_(hash) & (YAC_UNORDERED_MAP_NUM_STRIPE - 1)]);
+}
+
+static void YacUnorderedMapGatherSize_(YacUnorderedMapData* data)
+{
+    if (!data->arr_stripe_)
+        return;
+
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i) {
+        data->size_ += data->arr_stripe_[i].s_.size_;
+        data->arr_stripe_[i].s_.size_ = 0;
+    }
+    return;
+}
+
+static void YacUnorderedMapConcurrentReHash_(YacUnorderedMapData* data, unsigned num_slot)
+{
+    // The stripes are always taken in the same order.
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i)
+        YacUnorderedMapLockAcquire_(&(data->arr_stripe_[i].s_.lock_));
+
+    if (data->num_slot_ == num_slot)
+        YacUnorderedMapReHash_(data);
+
+    for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_STRIPE ; ++i)
+        YacUnorderedMapLockRelease_(&(data->arr_stripe_[i].s_.lock_));
+    return;
+}
+
+static bool YacUnorderedMapConcurrentPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapStripe* stripe = YacUnorderedMapStripe_(data, hash);
+
+    // Each stripe checks its share of the loading limit, so no global counter
+    // is touched by the insertion.
+    YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+    while (data->size_ / YAC_UNORDERED_MAP_NUM_STRIPE + stripe->s_.size_ >=
+            (int)(data->curr_limit_ / YAC_UNORDERED_MAP_NUM_STRIPE)) {
+        unsigned num_slot = data->num_slot_;
+        YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+        YacUnorderedMapConcurrentReHash_(data, num_slot);
+        YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+
+        // Keep inserting into the full slot array if it cannot be extended.
+        if (data->num_slot_ == num_slot)
+            break;
+    }
+
+    bool success = YacUnorderedMapChainPut_(data, key, value, hash, &(stripe->s_.size_));
+
+    YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+    return success;
+}
+
+static void* YacUnorderedMapConcurrentGet_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapStripe* stripe = YacUnorderedMapStripe_(data, hash);
+
+    YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+    YacUnorderedMapSlotNode* curr = data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)];
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    void* value = NULL;
+    unsigned num_probe = 0;
+    while (curr) {
+        ++num_probe;
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0) {
+            value = curr->pair_.value;
+            break;
+        }
+        curr = curr->next_;
+    }
+    YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+
+    YAC_UNORDERED_MAP_STAT_GET(data, num_probe);
+    return value;
+}
+
+static bool YacUnorderedMapConcurrentContain_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapStripe* stripe = YacUnorderedMapStripe_(data, hash);
+
+    YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+    YacUnorderedMapSlotNode* curr = data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)];
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0)
+            break;
+        curr = curr->next_;
+    }
+    YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+
+    return curr != NULL;
+}
+
+static bool YacUnorderedMapConcurrentRemove_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    YacUnorderedMapStripe* stripe = YacUnorderedMapStripe_(data, hash);
+
+    YacUnorderedMapLockAcquire_(&(stripe->s_.lock_));
+    YacUnorderedMapSlotNode** link = &(data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)]);
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    YacUnorderedMapSlotNode* curr = *link;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0) {
+            if (data->func_clean_key_)
+                data->func_clean_key_(curr->pair_.key);
+            if (data->func_clean_val_)
+                data->func_clean_val_(curr->pair_.value);
+            *link = curr->next_;
+            YacUnorderedMapNodeFree_(data, curr);
+            --(stripe->s_.size_);
+            break;
+        }
+        link = &(curr->next_);
+        curr = curr->next_;
+    }
+    YacUnorderedMapLockRelease_(&(stripe->s_.lock_));
+
+    return curr != NULL;
+}
+
+static void* YacUnorderedMapLoadAcquire_(void* volatile* ptr)
+{
+#if defined(_MSC_VER)
+    // Volatile loads have acquire semantics on x86 and x64.
+    void* value = *ptr;
+#if defined(_M_ARM64)
+    __dmb(0xB);
+#endif
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void YacUnorderedMapStoreRelease_(void* volatile* ptr, void* value)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+#if defined(_M_ARM64)
+    __dmb(0xB);
+#endif
+    *ptr = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static long YacUnorderedMapLoadSeq_(volatile long* ptr)
+{
+#if defined(_MSC_VER)
+    return _InterlockedOr(ptr, 0);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void YacUnorderedMapStoreSeq_(volatile long* ptr, long value)
+{
+#if defined(_MSC_VER)
+    _InterlockedExchange(ptr, value);
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static long YacUnorderedMapFetchAdd_(volatile long* ptr, long value)
+{
+#if defined(_MSC_VER)
+    return _InterlockedExchangeAdd(ptr, value);
+#else
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static YacUnorderedMapSlotNode* YacUnorderedMapReadMostlyFind_(YacUnorderedMapData* data, void* key, unsigned hash,
+                                                               unsigned* length)
+{
+    YacUnorderedMapTable* table = YacUnorderedMapLoadAcquire_((void* volatile*)&(data->table_));
+    unsigned idx = YacUnorderedMapIndex_(data, hash, table->num_slot_);
+
+    // The nodes are immutable once published, so only the links need acquire loads.
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    YacUnorderedMapSlotNode* curr = YacUnorderedMapLoadAcquire_((void* volatile*)&(table->arr_slot_[idx]));
+    *length = 0;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0)
+            return curr;
+        ++(*length);
+        curr = YacUnorderedMapLoadAcquire_((void* volatile*)&(curr->next_));
     }
+    return NULL;
+}
+
+static bool YacUnorderedMapReadMostlyGrow_(YacUnorderedMapData* data)
+{
+    YAC_UNORDERED_MAP_STAT_CLOCK(start);
+
+    int idx_prime;
+    unsigned num_slot_new = YacUnorderedMapFitSlot_(data->flags_, data->curr_limit_ + 1, &idx_prime);
 
-    // Try to allocate the new slot array. The rehashing should be canceled due to insufficient memory space.
+    YacUnorderedMapTable* table = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapTable));
+    if (!table)
+        return false;
     YacUnorderedMapSlotNode** arr_slot_new = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapSlotNode*) * num_slot_new);
     if (!arr_slot_new) {
-        if (data->idx_prime_ < yac_unordered_map_num_prime)
-            --(data->idx_prime_);
-        return;
+        YAC_ORDERED_MAP_FREE(table);
+        return false;
     }
 
     unsigned i;
     for (i = 0 ; i < num_slot_new ; ++i)
         arr_slot_new[i] = NULL;
+    table->num_slot_ = num_slot_new;
+    table->arr_slot_ = arr_slot_new;
 
-    YacUnorderedMapHash func_hash = data->func_hash_;
-    YacUnorderedMapSlotNode** arr_slot = data->arr_slot_;
-    unsigned num_slot = data->num_slot_;
-    for (i = 0 ; i < num_slot ; ++i) {
-        YacUnorderedMapSlotNode* pred;
-        YacUnorderedMapSlotNode* curr = arr_slot[i];
+    // Link a copy of each node into the new slot array.
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    for (i = 0 ; i < data->num_slot_ ; ++i) {
+        YacUnorderedMapSlotNode* curr = data->arr_slot_[i];
         while (curr) {
-            pred = curr;
+            YacUnorderedMapSlotNode* node = YacUnorderedMapNodeAlloc_(data);
+            if (!node) {
+                // Drop the copies made so far and keep the current slot array.
+                YacUnorderedMapRetired retired = {NULL, NULL, table};
+                YacUnorderedMapReclaim_(data, &retired);
+                return false;
+            }
+            node->pair_ = curr->pair_;
+            unsigned hash = (cache_hash)? curr->hash_ : YacUnorderedMapHashOf_(data, curr->pair_.key);
+            if (cache_hash)
+                node->hash_ = hash;
+            hash = YacUnorderedMapIndex_(data, hash, num_slot_new);
+            node->next_ = arr_slot_new[hash];
+            arr_slot_new[hash] = node;
             curr = curr->next_;
+        }
+    }
 
-            // Migrate each key value pair to the new slot.
-            unsigned hash = func_hash(pred->pair_.key);
-            hash = hash % num_slot_new;
-            if (!arr_slot_new[hash]) {
-                pred->next_ = NULL;
-                arr_slot_new[hash] = pred;
-            } else {
-                pred->next_ = arr_slot_new[hash];
-                arr_slot_new[hash] = pred;
+    YacUnorderedMapTable* table_old = data->table_;
+    YacUnorderedMapStoreRelease_((void* volatile*)&(data->table_), table);
+    data->arr_slot_ = arr_slot_new;
+    data->num_slot_ = num_slot_new;
+    data->idx_prime_ = idx_prime;
+    data->curr_limit_ = (unsigned)((double)num_slot_new * yac_unordered_map_load_factor);
+
+    YacUnorderedMapRetire_(data, NULL, table_old);
+    YAC_UNORDERED_MAP_STAT_REHASH(data, start, 1);
+    return true;
+}
+
+static void YacUnorderedMapRetire_(YacUnorderedMapData* data, YacUnorderedMapSlotNode* node, YacUnorderedMapTable* table)
+{
+    YacUnorderedMapRetired* retired = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapRetired));
+
+    // Without the memory to defer the reclamation, wait until the epoch has
+    // advanced twice and reclaim the object right away.
+    if (!retired) {
+        YacUnorderedMapRetired local = {NULL, node, table};
+        long epoch = data->epoch_;
+        while ((unsigned long)data->epoch_ - (unsigned long)epoch < 2)
+            YacUnorderedMapTryAdvance_(data);
+        YacUnorderedMapReclaim_(data, &local);
+        return;
+    }
+
+    unsigned phase = (unsigned)((unsigned long)data->epoch_ % 3);
+    retired->node_ = node;
+    retired->table_ = table;
+    retired->next_ = data->limbo_[phase];
+    data->limbo_[phase] = retired;
+
+    YacUnorderedMapTryAdvance_(data);
+    return;
+}
+
+static void YacUnorderedMapTryAdvance_(YacUnorderedMapData* data)
+{
+    // Only the writers modify the epoch.
+    unsigned long epoch = (unsigned long)data->epoch_;
+    unsigned phase_prev = (unsigned)((epoch + 2) % 3);
+
+    unsigned i;
+    for (i = 0 ; i < YAC_UNORDERED_MAP_NUM_READER ; ++i) {
+        if (YacUnorderedMapLoadSeq_(&(data->arr_reader_[i].cnt_[phase_prev])) != 0)
+            return;
+    }
+    YacUnorderedMapStoreSeq_(&(data->epoch_), (long)(epoch + 1));
+
+    // The readers of the new epoch started after the objects retired in the
+    // previous epoch were unlinked, and the readers of that epoch are gone.
+    YacUnorderedMapRetired* curr = data->limbo_[phase_prev];
+    data->limbo_[phase_prev] = NULL;
+    while (curr) {
+        YacUnorderedMapRetired* pred = curr;
+        curr = curr->next_;
+        YacUnorderedMapReclaim_(data, pred);
+        YAC_ORDERED_MAP_FREE(pred);
+    }
+    return;
+}
+
+static void YacUnorderedMapReclaim_(YacUnorderedMapData* data, YacUnorderedMapRetired* retired)
+{
+    if (retired->node_) {
+        if (data->func_clean_key_)
+            data->func_clean_key_(retired->node_->pair_.key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(retired->node_->pair_.value);
+        YacUnorderedMapNodeFree_(data, retired->node_);
+    }
+
+    // The pairs of a replaced slot array live on in their copies.
+    YacUnorderedMapTable* table = retired->table_;
+    if (table) {
+        unsigned i;
+        for (i = 0 ; i < table->num_slot_ ; ++i) {
+            YacUnorderedMapSlotNode* curr = table->arr_slot_[i];
+            while (curr) {
+                YacUnorderedMapSlotNode* pred = curr;
+                curr = curr->next_;
+                YacUnorderedMapNodeFree_(data, pred);
             }
         }
+        YAC_ORDERED_MAP_FREE(table->arr_slot_);
+        YAC_ORDERED_MAP_FREE(table);
     }
+    return;
+}
 
-    YAC_ORDERED_MAP_FREE(arr_slot);
-    data->arr_slot_ = arr_slot_new;
+static bool YacUnorderedMapReadMostlyPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+
+    YacUnorderedMapLockAcquire_(&(data->lock_writer_));
+    if ((unsigned)data->size_ >= data->curr_limit_)
+        YacUnorderedMapReadMostlyGrow_(data);
+
+    YacUnorderedMapSlotNode* node = YacUnorderedMapNodeAlloc_(data);
+    if (!node) {
+        YacUnorderedMapLockRelease_(&(data->lock_writer_));
+        return false;
+    }
+    node->pair_.key = key;
+    node->pair_.value = value;
+    if (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH)
+        node->hash_ = hash;
+
+    // A conflicting pair is replaced by publishing the new node in its place.
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    YacUnorderedMapSlotNode** slot = &(data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)]);
+    YacUnorderedMapSlotNode** link = slot;
+    YacUnorderedMapSlotNode* curr = *link;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0) {
+            node->next_ = curr->next_;
+            YacUnorderedMapStoreRelease_((void* volatile*)link, node);
+            YacUnorderedMapRetire_(data, curr, NULL);
+            YacUnorderedMapLockRelease_(&(data->lock_writer_));
+            return true;
+        }
+        link = &(curr->next_);
+        curr = curr->next_;
+    }
+
+    node->next_ = *slot;
+    YacUnorderedMapStoreRelease_((void* volatile*)slot, node);
+    ++(data->size_);
+
+    YacUnorderedMapLockRelease_(&(data->lock_writer_));
+    return true;
+}
+
+static void* YacUnorderedMapReadMostlyGet_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    unsigned token = YacUnorderedMapReadEnter(self);
+    unsigned length;
+    YacUnorderedMapSlotNode* node = YacUnorderedMapReadMostlyFind_(self->data, key, hash, &length);
+    void* value = (node)? node->pair_.value : NULL;
+    YacUnorderedMapReadLeave(self, token);
+
+    YAC_UNORDERED_MAP_STAT_GET(self->data, length + (node != NULL));
+    return value;
+}
+
+static bool YacUnorderedMapReadMostlyContain_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    unsigned token = YacUnorderedMapReadEnter(self);
+    unsigned length;
+    bool found = YacUnorderedMapReadMostlyFind_(self->data, key, hash, &length) != NULL;
+    YacUnorderedMapReadLeave(self, token);
+    return found;
+}
+
+static bool YacUnorderedMapReadMostlyRemove_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+
+    YacUnorderedMapLockAcquire_(&(data->lock_writer_));
+    bool cache_hash = (data->flags_ & YAC_UNORDERED_MAP_CACHE_HASH) != 0;
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    YacUnorderedMapSlotNode** link = &(data->arr_slot_[YacUnorderedMapIndex_(data, hash, data->num_slot_)]);
+    YacUnorderedMapSlotNode* curr = *link;
+    while (curr) {
+        if ((!cache_hash || curr->hash_ == hash) && func_cmp(key, curr->pair_.key) == 0) {
+            // The readers standing on the node can still follow its link.
+            YacUnorderedMapStoreRelease_((void* volatile*)link, curr->next_);
+            YacUnorderedMapRetire_(data, curr, NULL);
+            --(data->size_);
+            break;
+        }
+        link = &(curr->next_);
+        curr = curr->next_;
+    }
+    YacUnorderedMapLockRelease_(&(data->lock_writer_));
+
+    return curr != NULL;
+}
+
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+static unsigned __stdcall YacUnorderedMapShardMain_(void* arg)
+{
+    YacUnorderedMapShardRun_(arg);
+    return 0;
+}
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+static void* YacUnorderedMapShardMain_(void* arg)
+{
+    YacUnorderedMapShardRun_(arg);
+    return NULL;
+}
+#endif
+
+static YacUnorderedMapShard* YacUnorderedMapRunShards_(YacUnorderedMapData* data, int op, YacUnorderedMapVisit func_visit,
+                                                       YacUnorderedMapPredicate func_pred, void* arg,
+                                                       unsigned* num_thread)
+{
+    // The flat ranges are aligned to the groups, because removal reads the
+    // control bytes of the whole group.
+    unsigned num_bucket = (data->flags_ & YAC_UNORDERED_MAP_FLAT)?
+        data->num_slot_ : data->num_slot_old_ + data->num_slot_;
+    if (data->flags_ & YAC_UNORDERED_MAP_COMPACT)
+        num_bucket = (unsigned)data->size_;
+    unsigned align = (data->flags_ & YAC_UNORDERED_MAP_FLAT)? YAC_UNORDERED_MAP_GROUP_WIDTH : 1;
+    unsigned num_unit = num_bucket / align;
+
+    unsigned num_shard = *num_thread;
+    if (num_shard > YAC_UNORDERED_MAP_MAX_SHARD)
+        num_shard = YAC_UNORDERED_MAP_MAX_SHARD;
+    if (num_shard > num_unit)
+        num_shard = num_unit;
+    if (num_shard == 0)
+        num_shard = 1;
+
+    YacUnorderedMapShard* arr_shard = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapShard) * num_shard);
+    if (!arr_shard)
+        return NULL;
+
+    unsigned i;
+    for (i = 0 ; i < num_shard ; ++i) {
+        YacUnorderedMapShard* shard = &(arr_shard[i]);
+        shard->data_ = data;
+        shard->op_ = op;
+        shard->idx_ = i;
+        shard->begin_ = (unsigned)((unsigned long long)num_unit * i / num_shard) * align;
+        shard->end_ = (unsigned)((unsigned long long)num_unit * (i + 1) / num_shard) * align;
+        shard->func_visit_ = func_visit;
+        shard->func_pred_ = func_pred;
+        shard->arg_ = arg;
+        shard->fail_ = false;
+        shard->num_pair_ = 0;
+        shard->cap_pair_ = 0;
+        shard->arr_pair_ = NULL;
+        shard->num_removed_ = 0;
+        shard->num_emptied_ = 0;
+        shard->removed_ = NULL;
+        shard->spawned_ = false;
+    }
+    arr_shard[num_shard - 1].end_ = num_bucket;
+
+    // A shard whose thread cannot be created is run by the calling thread.
+    for (i = 1 ; i < num_shard ; ++i) {
+        YacUnorderedMapShard* shard = &(arr_shard[i]);
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+        shard->thread_ = (HANDLE)_beginthreadex(NULL, 0, YacUnorderedMapShardMain_, shard, 0, NULL);
+        shard->spawned_ = shard->thread_ != 0;
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+        shard->spawned_ = pthread_create(&(shard->thread_), NULL, YacUnorderedMapShardMain_, shard) == 0;
+#endif
+        if (!shard->spawned_)
+            YacUnorderedMapShardRun_(shard);
+    }
+    YacUnorderedMapShardRun_(&(arr_shard[0]));
+
+    for (i = 1 ; i < num_shard ; ++i) {
+        if (!arr_shard[i].spawned_)
+            continue;
+#if defined(YAC_UNORDERED_MAP_THREADS_WIN32)
+        WaitForSingleObject(arr_shard[i].thread_, INFINITE);
+        CloseHandle(arr_shard[i].thread_);
+#elif defined(YAC_UNORDERED_MAP_THREADS_PTHREAD)
+        pthread_join(arr_shard[i].thread_, NULL);
+#endif
+    }
+
+    *num_thread = num_shard;
+    return arr_shard;
+}
+
+static void YacUnorderedMapShardRun_(YacUnorderedMapShard* shard)
+{
+    YacUnorderedMapData* data = shard->data_;
+
+    if (shard->op_ != YAC_UNORDERED_MAP_SHARD_REMOVE_IF) {
+        YacUnorderedMapIterator iter;
+        iter.data_ = data;
+        iter.bucket_ = shard->begin_;
+        iter.end_ = shard->end_;
+        iter.node_ = NULL;
+
+        YacUnorderedMapPair* pair;
+        while ((pair = YacUnorderedMapIteratorNext(&iter)) != NULL) {
+            if (shard->op_ == YAC_UNORDERED_MAP_SHARD_FOR_EACH)
+                shard->func_visit_(pair, shard->idx_, shard->arg_);
+            else if (shard->func_pred_(pair, shard->idx_, shard->arg_))
+                YacUnorderedMapShardAppend_(shard, pair);
+        }
+        return;
+    }
+
+    YacUnorderedMapPredicate func_pred = shard->func_pred_;
+    YacUnorderedMapCleanKey func_clean_key = data->func_clean_key_;
+    YacUnorderedMapCleanValue func_clean_val = data->func_clean_val_;
+    unsigned idx;
+
+    if (data->flags_ & YAC_UNORDERED_MAP_FLAT) {
+        unsigned char* arr_ctrl = data->arr_ctrl_;
+        for (idx = shard->begin_ ; idx < shard->end_ ; ++idx) {
+            if (!YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[idx]))
+                continue;
+            YacUnorderedMapPair* pair = &(data->arr_pair_[idx]);
+            if (!func_pred(pair, shard->idx_, shard->arg_))
+                continue;
+            if (func_clean_key)
+                func_clean_key(pair->key);
+            if (func_clean_val)
+                func_clean_val(pair->value);
+            if (YacUnorderedMapFlatErase_(arr_ctrl, idx))
+                ++(shard->num_emptied_);
+            ++(shard->num_removed_);
+        }
+        return;
+    }
+
+    for (idx = shard->begin_ ; idx < shard->end_ ; ++idx) {
+        YacUnorderedMapSlotNode** link = &(data->arr_slot_[idx]);
+        while (*link) {
+            YacUnorderedMapSlotNode* curr = *link;
+            if (!func_pred(&(curr->pair_), shard->idx_, shard->arg_)) {
+                link = &(curr->next_);
+                continue;
+            }
+            if (func_clean_key)
+                func_clean_key(curr->pair_.key);
+            if (func_clean_val)
+                func_clean_val(curr->pair_.value);
+            *link = curr->next_;
+            curr->next_ = shard->removed_;
+            shard->removed_ = curr;
+            ++(shard->num_removed_);
+        }
+    }
+    return;
+}
+
+static void YacUnorderedMapShardAppend_(YacUnorderedMapShard* shard, YacUnorderedMapPair* pair)
+{
+    if (shard->fail_)
+        return;
+
+    if (shard->num_pair_ == shard->cap_pair_) {
+        unsigned cap_pair = (shard->cap_pair_ == 0)? 64 : shard->cap_pair_ * 2;
+        YacUnorderedMapPair* arr_pair = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapPair) * cap_pair);
+        if (!arr_pair) {
+            shard->fail_ = true;
+            return;
+        }
+        unsigned i;
+        for (i = 0 ; i < shard->num_pair_ ; ++i)
+            arr_pair[i] = shard->arr_pair_[i];
+        YAC_ORDERED_MAP_FREE(shard->arr_pair_);
+        shard->arr_pair_ = arr_pair;
+        shard->cap_pair_ = cap_pair;
+    }
+    shard->arr_pair_[(shard->num_pair_)++] = *pair;
+    return;
+}
+
+static void YacUnorderedMapFlatFirst_(YacUnorderedMap* self)
+{
+    self->data->iter_slot_ = 0;
+    return;
+}
+
+static YacUnorderedMapPair* YacUnorderedMapFlatNext_(YacUnorderedMap* self)
+{
+    YacUnorderedMapData* data = self->data;
+
+    unsigned char* arr_ctrl = data->arr_ctrl_;
+    while (data->iter_slot_ < data->num_slot_) {
+        unsigned idx = (data->iter_slot_)++;
+        if (YAC_UNORDERED_MAP_CTRL_IS_FULL(arr_ctrl[idx]))
+            return &(data->arr_pair_[idx]);
+    }
+    return NULL;
+}
+
+static bool YacUnorderedMapCompactReHash_(YacUnorderedMapData* data, unsigned num_slot_new)
+{
+    YAC_UNORDERED_MAP_STAT_CLOCK(start);
+
+    uint32_t* arr_index = YAC_ORDERED_MAP_MALLOC(sizeof(uint32_t) * num_slot_new);
+    if (!arr_index)
+        return false;
+
+    unsigned i;
+    for (i = 0 ; i < num_slot_new ; ++i)
+        arr_index[i] = YAC_UNORDERED_MAP_INDEX_EMPTY;
+
+    // Index the pairs again, leaving the tombstones behind.
+    unsigned mask = num_slot_new - 1;
+    for (i = 0 ; i < (unsigned)data->size_ ; ++i) {
+        unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, data->arr_pair_[i].key));
+        unsigned pos = hash & mask;
+        while (arr_index[pos] != YAC_UNORDERED_MAP_INDEX_EMPTY)
+            pos = (pos + 1) & mask;
+        arr_index[pos] = (hash & ~mask) | (i + 1);
+    }
+
+    YAC_ORDERED_MAP_FREE(data->arr_index_);
+    data->arr_index_ = arr_index;
     data->num_slot_ = num_slot_new;
     data->curr_limit_ = (unsigned)((double)num_slot_new * yac_unordered_map_load_factor);
+    data->growth_left_ = data->curr_limit_ - (unsigned)data->size_;
+    YAC_UNORDERED_MAP_STAT_REHASH(data, start, 1);
+    return true;
+}
+
+static bool YacUnorderedMapCompactGrow_(YacUnorderedMapData* data, unsigned capacity)
+{
+    if (capacity <= data->cap_entry_)
+        return true;
+
+    YacUnorderedMapPair* arr_pair = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapPair) * capacity);
+    if (!arr_pair)
+        return false;
+
+    if (data->size_ > 0)
+        memcpy(arr_pair, data->arr_pair_, sizeof(YacUnorderedMapPair) * (unsigned)data->size_);
+    YAC_ORDERED_MAP_FREE(data->arr_pair_);
+    data->arr_pair_ = arr_pair;
+    data->cap_entry_ = capacity;
+    return true;
+}
+
+static unsigned YacUnorderedMapCompactFind_(YacUnorderedMapData* data, void* key, unsigned hash, unsigned* num_probe)
+{
+    unsigned mask = data->num_slot_ - 1;
+    unsigned tag = hash & ~mask;
+    unsigned pos = hash & mask;
+
+    // The load limit keeps an empty slot on every probe sequence.
+    YacUnorderedMapCompare func_cmp = data->func_cmp_;
+    uint32_t* arr_index = data->arr_index_;
+    YacUnorderedMapPair* arr_pair = data->arr_pair_;
+    *num_probe = 1;
+    while (true) {
+        uint32_t slot = arr_index[pos];
+        if (slot == YAC_UNORDERED_MAP_INDEX_EMPTY)
+            return data->num_slot_;
+        if (slot != YAC_UNORDERED_MAP_INDEX_DELETED && (slot & ~mask) == tag &&
+                func_cmp(key, arr_pair[(slot & mask) - 1].key) == 0)
+            return pos;
+        pos = (pos + 1) & mask;
+        ++(*num_probe);
+    }
+}
+
+static YacUnorderedMapPair* YacUnorderedMapCompactInsert_(YacUnorderedMapData* data, void* key, void* value,
+                                                          unsigned hash)
+{
+    // Rebuild the index table if no empty slot can be consumed. The table stops
+    // doubling at 2^31 slots like YacUnorderedMapFitSlot_, and the insert fails
+    // once a rebuild at that size would reclaim no tombstone.
+    if (data->growth_left_ == 0) {
+        unsigned num_slot_new = data->num_slot_;
+        if ((unsigned)data->size_ > data->curr_limit_ / 2) {
+            if (data->num_slot_ < (1u << 31))
+                num_slot_new = data->num_slot_ * 2;
+            else if ((unsigned)data->size_ >= data->curr_limit_)
+                return NULL;
+        }
+        if (!YacUnorderedMapCompactReHash_(data, num_slot_new))
+            return NULL;
+    }
+
+    // The pair array grows by half, but never beyond the load limit.
+    if ((unsigned)data->size_ == data->cap_entry_) {
+        unsigned capacity = data->cap_entry_ + data->cap_entry_ / 2;
+        if (capacity < 16)
+            capacity = 16;
+        if (capacity > data->curr_limit_)
+            capacity = data->curr_limit_;
+        if (!YacUnorderedMapCompactGrow_(data, capacity))
+            return NULL;
+    }
+
+    unsigned mask = data->num_slot_ - 1;
+    unsigned pos = hash & mask;
+    while (data->arr_index_[pos] != YAC_UNORDERED_MAP_INDEX_EMPTY &&
+           data->arr_index_[pos] != YAC_UNORDERED_MAP_INDEX_DELETED)
+        pos = (pos + 1) & mask;
+    if (data->arr_index_[pos] == YAC_UNORDERED_MAP_INDEX_EMPTY)
+        --(data->growth_left_);
+
+    unsigned idx = (unsigned)(data->size_)++;
+    data->arr_index_[pos] = (hash & ~mask) | (idx + 1);
+    YacUnorderedMapPair* pair = &(data->arr_pair_[idx]);
+    pair->key = key;
+    pair->value = value;
+    return pair;
+}
+
+static bool YacUnorderedMapCompactPut_(YacUnorderedMap* self, void* key, void* value, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    hash = YacUnorderedMapMix_(hash);
+
+    // Check if the pair conflicts with a certain one stored in the map. If yes, replace that one.
+    unsigned num_probe;
+    unsigned pos = YacUnorderedMapCompactFind_(data, key, hash, &num_probe);
+    if (pos != data->num_slot_) {
+        YacUnorderedMapPair* pair = &(data->arr_pair_[(data->arr_index_[pos] & (data->num_slot_ - 1)) - 1]);
+        if (data->func_clean_key_)
+            data->func_clean_key_(pair->key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(pair->value);
+        pair->key = key;
+        pair->value = value;
+        return true;
+    }
+
+    return YacUnorderedMapCompactInsert_(data, key, value, hash) != NULL;
+}
+
+static void* YacUnorderedMapCompactGet_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    unsigned num_probe;
+    unsigned pos = YacUnorderedMapCompactFind_(data, key, YacUnorderedMapMix_(hash), &num_probe);
+    YAC_UNORDERED_MAP_STAT_GET(data, num_probe);
+    if (pos != data->num_slot_)
+        return data->arr_pair_[(data->arr_index_[pos] & (data->num_slot_ - 1)) - 1].value;
+    return NULL;
+}
+
+static bool YacUnorderedMapCompactContain_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    unsigned num_probe;
+    return YacUnorderedMapCompactFind_(data, key, YacUnorderedMapMix_(hash), &num_probe) != data->num_slot_;
+}
+
+static bool YacUnorderedMapCompactRemove_(YacUnorderedMap* self, void* key, unsigned hash)
+{
+    YacUnorderedMapData* data = self->data;
+    unsigned num_probe;
+    unsigned pos = YacUnorderedMapCompactFind_(data, key, YacUnorderedMapMix_(hash), &num_probe);
+    if (pos == data->num_slot_)
+        return false;
+
+    unsigned mask = data->num_slot_ - 1;
+    unsigned idx = (data->arr_index_[pos] & mask) - 1;
+    YacUnorderedMapPair* arr_pair = data->arr_pair_;
+    if (data->func_clean_key_)
+        data->func_clean_key_(arr_pair[idx].key);
+    if (data->func_clean_val_)
+        data->func_clean_val_(arr_pair[idx].value);
+
+    // A slot followed by an empty one ends no other probe sequence, so it can
+    // be emptied directly. Otherwise leave a tombstone.
+    if (data->arr_index_[(pos + 1) & mask] == YAC_UNORDERED_MAP_INDEX_EMPTY) {
+        data->arr_index_[pos] = YAC_UNORDERED_MAP_INDEX_EMPTY;
+        ++(data->growth_left_);
+    } else
+        data->arr_index_[pos] = YAC_UNORDERED_MAP_INDEX_DELETED;
+
+    // Move the last pair into the vacated entry and redirect its index slot.
+    unsigned last = (unsigned)(--(data->size_));
+    if (idx != last) {
+        arr_pair[idx] = arr_pair[last];
+        unsigned hash_last = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, arr_pair[idx].key));
+        pos = hash_last & mask;
+        while (data->arr_index_[pos] == YAC_UNORDERED_MAP_INDEX_DELETED ||
+               (data->arr_index_[pos] & mask) != last + 1)
+            pos = (pos + 1) & mask;
+        data->arr_index_[pos] = (hash_last & ~mask) | (idx + 1);
+    }
+    return true;
+}
+
+static YacUnorderedMapPair* YacUnorderedMapCompactEntry_(YacUnorderedMapData* data, void* key,
+                                                         unsigned hash, bool* inserted)
+{
+    unsigned num_probe;
+    unsigned pos = YacUnorderedMapCompactFind_(data, key, hash, &num_probe);
+    if (pos != data->num_slot_)
+        return &(data->arr_pair_[(data->arr_index_[pos] & (data->num_slot_ - 1)) - 1]);
+
+    YacUnorderedMapPair* pair = YacUnorderedMapCompactInsert_(data, key, NULL, hash);
+    *inserted = pair != NULL;
+    return pair;
+}
+
+static unsigned YacUnorderedMapCompactRemoveIf_(YacUnorderedMapData* data, YacUnorderedMapPredicate func, void* arg)
+{
+    // The kept pairs slide to the front in their order, so the predicate is
+    // evaluated on the calling thread as a single shard.
+    YacUnorderedMapPair* arr_pair = data->arr_pair_;
+    unsigned num_pair = (unsigned)data->size_;
+    unsigned num_kept = 0;
+    unsigned i;
+    for (i = 0 ; i < num_pair ; ++i) {
+        if (!func(&(arr_pair[i]), 0, arg)) {
+            arr_pair[num_kept++] = arr_pair[i];
+            continue;
+        }
+        if (data->func_clean_key_)
+            data->func_clean_key_(arr_pair[i].key);
+        if (data->func_clean_val_)
+            data->func_clean_val_(arr_pair[i].value);
+    }
+    if (num_kept == num_pair)
+        return 0;
+
+    // The index table is rebuilt in place if a new one cannot be allocated.
+    data->size_ = (int)num_kept;
+    if (!YacUnorderedMapCompactReHash_(data, data->num_slot_)) {
+        unsigned mask = data->num_slot_ - 1;
+        for (i = 0 ; i < data->num_slot_ ; ++i)
+            data->arr_index_[i] = YAC_UNORDERED_MAP_INDEX_EMPTY;
+        for (i = 0 ; i < num_kept ; ++i) {
+            unsigned hash = YacUnorderedMapMix_(YacUnorderedMapHashOf_(data, arr_pair[i].key));
+            unsigned pos = hash & mask;
+            while (data->arr_index_[pos] != YAC_UNORDERED_MAP_INDEX_EMPTY)
+                pos = (pos + 1) & mask;
+            data->arr_index_[pos] = (hash & ~mask) | (i + 1);
+        }
+        data->growth_left_ = data->curr_limit_ - num_kept;
+    }
+    return num_pair - num_kept;
+}
+
+static YacUnorderedMapView* YacUnorderedMapViewCreate_(const void* base, size_t size, int kind)
+{
+    YacUnorderedMapSnapshot header;
+    if (((uintptr_t)base & 7) || size < sizeof(header))
+        return NULL;
+
+    // The sizes are checked so that every probe stays inside the memory.
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic_, YAC_UNORDERED_MAP_SNAPSHOT_MAGIC, sizeof(header.magic_)) != 0 ||
+        header.version_ != YAC_UNORDERED_MAP_SNAPSHOT_VERSION || header.order_ != YAC_UNORDERED_MAP_SNAPSHOT_ORDER)
+        return NULL;
+    if (header.size_file_ != size || header.num_slot_ == 0 || (header.num_slot_ & (header.num_slot_ - 1)) ||
+        header.num_pair_ >= header.num_slot_ || header.num_pair_ > UINT_MAX || (header.off_slot_ & 7) ||
+        header.off_slot_ < sizeof(header) || header.off_slot_ > size ||
+        header.num_slot_ != (size - header.off_slot_) / sizeof(uint64_t))
+        return NULL;
+
+    YacUnorderedMapView* obj = YAC_ORDERED_MAP_MALLOC(sizeof(YacUnorderedMapView));
+    if (!obj)
+        return NULL;
+
+    obj->base_ = base;
+    obj->size_ = size;
+    obj->kind_ = kind;
+    obj->num_pair_ = (unsigned)header.num_pair_;
+    obj->num_slot_ = header.num_slot_;
+    obj->off_slot_ = header.off_slot_;
+    obj->arr_slot_ = (const uint64_t*)(obj->base_ + header.off_slot_);
+    return obj;
+}
+
+static void YacUnorderedMapViewRelease_(const void* base, size_t size, int kind)
+{
+    if (kind == YAC_UNORDERED_MAP_VIEW_READ)
+        YAC_ORDERED_MAP_FREE((void*)base);
+#if defined(YAC_UNORDERED_MAP_MMAP_WIN32)
+    if (kind == YAC_UNORDERED_MAP_VIEW_MAPPED)
+        UnmapViewOfFile(base);
+#elif defined(YAC_UNORDERED_MAP_MMAP_POSIX)
+    if (kind == YAC_UNORDERED_MAP_VIEW_MAPPED)
+        munmap((void*)base, size);
+#endif
+    (void)size;
     return;
 }
 
+static const unsigned char* YacUnorderedMapViewFind_(YacUnorderedMapView* view, const void* key, size_t key_size)
+{
+    uint64_t hash = YacUnorderedMapHashWy64((void*)key, key_size, 0);
+    uint64_t tag = hash & ~YAC_UNORDERED_MAP_SNAPSHOT_OFFSET;
+    uint64_t mask = view->num_slot_ - 1;
+    uint64_t pos = hash & mask;
+
+    // A corrupted file may have no empty slot, so the probes are bounded.
+    uint64_t i;
+    for (i = 0 ; i < view->num_slot_ ; ++i) {
+        uint64_t slot = view->arr_slot_[pos];
+        if (!slot)
+            return NULL;
+        if ((slot & ~YAC_UNORDERED_MAP_SNAPSHOT_OFFSET) == tag) {
+            uint64_t offset = (slot & YAC_UNORDERED_MAP_SNAPSHOT_OFFSET) << 3;
+            if (offset + 8 <= view->off_slot_) {
+                const unsigned char* record = view->base_ + offset;
+                const uint32_t* size32 = (const uint32_t*)record;
+                uint64_t end = offset + 8 + ((size32[0] + UINT64_C(7)) & ~UINT64_C(7)) + size32[1];
+                if (size32[0] == key_size && end <= view->off_slot_ && memcmp(record + 8, key, key_size) == 0)
+                    return record;
+            }
+        }
+        pos = (pos + 1) & mask;
+    }
+    return NULL;
+}
+
+static void YacUnorderedMapCompactFirst_(YacUnorderedMap* self)
+{
+    self->data->iter_slot_ = 0;
+    return;
+}
+
+static YacUnorderedMapPair* YacUnorderedMapCompactNext_(YacUnorderedMap* self)
+{
+    YacUnorderedMapData* data = self->data;
+    if (data->iter_slot_ < (unsigned)data->size_)
+        return &(data->arr_pair_[(data->iter_slot_)++]);
+    return NULL;
+}
+
 
 #endif // YCC_UNORDERED_MAP_IMPLEMENTATION